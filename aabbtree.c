@@ -0,0 +1,342 @@
+#include "aabbtree.h"
+#include <stdlib.h>
+
+const int aabbTreeStartMax = 16;
+
+bounds_t GetBoundsUnion(bounds_t bounds1, bounds_t bounds2)
+{
+    return (bounds_t){bounds1.minX < bounds2.minX ? bounds1.minX : bounds2.minX,
+                      bounds1.minY < bounds2.minY ? bounds1.minY : bounds2.minY,
+                      bounds1.maxX > bounds2.maxX ? bounds1.maxX : bounds2.maxX,
+                      bounds1.maxY > bounds2.maxY ? bounds1.maxY : bounds2.maxY};
+}
+
+// the insertion cost, perimeter instead of area so thin boxes still cost something
+real_t GetBoundsPerimeter(bounds_t bounds)
+{
+    return 2 * ((bounds.maxX - bounds.minX) + (bounds.maxY - bounds.minY));
+}
+
+// one slab of the slab test, narrows [*enter, *exit] to where the ray is between low and high on this axis
+bool ClipRaySlab(real_t origin, real_t direction, real_t low, real_t high, int axis, real_t *enter, real_t *exit, int *enterAxis)
+{
+    if (direction == 0)
+    {
+        return origin >= low && origin <= high;
+    }
+    real_t near = ((direction > 0 ? low : high) - origin) / direction;
+    real_t far = ((direction > 0 ? high : low) - origin) / direction;
+    if (near > *enter)
+    {
+        *enter = near;
+        *enterAxis = axis;
+    }
+    *exit = far < *exit ? far : *exit;
+    return *enter <= *exit;
+}
+
+bool GetRayBoundsFraction(bounds_t bounds, real_t originX, real_t originY, real_t directionX, real_t directionY, real_t maxFraction,
+                          real_t *fraction, int *axis)
+{
+    real_t enter = 0;
+    real_t exit = maxFraction;
+    int enterAxis = -1;
+    if (!ClipRaySlab(originX, directionX, bounds.minX, bounds.maxX, 0, &enter, &exit, &enterAxis) ||
+        !ClipRaySlab(originY, directionY, bounds.minY, bounds.maxY, 1, &enter, &exit, &enterAxis))
+    {
+        return false;
+    }
+    *fraction = enter;
+    *axis = enterAxis;
+    return true;
+}
+
+void InitAabbTree(aabb_tree_t *tree)
+{
+    *tree = (aabb_tree_t){0};
+    tree->root = AABB_TREE_NULL;
+    tree->freeNode = AABB_TREE_NULL;
+}
+
+void FreeAabbTree(aabb_tree_t *tree)
+{
+    free(tree->nodes);
+    InitAabbTree(tree);
+}
+
+void ClearAabbTree(aabb_tree_t *tree)
+{
+    // every node goes back on the free list, in index order
+    for (int i = 0; i < tree->max; i++)
+    {
+        tree->nodes[i].parent = i + 1 < tree->max ? i + 1 : AABB_TREE_NULL;
+        tree->nodes[i].height = -1;
+    }
+    tree->root = AABB_TREE_NULL;
+    tree->freeNode = tree->max > 0 ? 0 : AABB_TREE_NULL;
+    tree->count = 0;
+}
+
+int AllocateAabbTreeNode(aabb_tree_t *tree)
+{
+    if (tree->freeNode == AABB_TREE_NULL)
+    {
+        int oldMax = tree->max;
+        tree->max = tree->max > 0 ? tree->max * 2 : aabbTreeStartMax;
+        tree->nodes = realloc(tree->nodes, sizeof(aabb_tree_node_t) * tree->max);
+        for (int i = oldMax; i < tree->max; i++)
+        {
+            tree->nodes[i].parent = i + 1 < tree->max ? i + 1 : AABB_TREE_NULL;
+            tree->nodes[i].height = -1;
+        }
+        tree->freeNode = oldMax;
+    }
+    int node = tree->freeNode;
+    tree->freeNode = tree->nodes[node].parent;
+    tree->nodes[node] = (aabb_tree_node_t){{0}, AABB_TREE_NULL, AABB_TREE_NULL, AABB_TREE_NULL, 0, -1};
+    tree->count++;
+    return node;
+}
+
+void FreeAabbTreeNode(aabb_tree_t *tree, int node)
+{
+    tree->nodes[node].parent = tree->freeNode;
+    tree->nodes[node].height = -1;
+    tree->freeNode = node;
+    tree->count--;
+}
+
+void UpdateAabbTreeNode(aabb_tree_t *tree, int node)
+{
+    aabb_tree_node_t *nodes = tree->nodes;
+    int child1 = nodes[node].child1;
+    int child2 = nodes[node].child2;
+    nodes[node].bounds = GetBoundsUnion(nodes[child1].bounds, nodes[child2].bounds);
+    nodes[node].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+}
+
+void ReplaceAabbTreeChild(aabb_tree_t *tree, int parent, int oldChild, int newChild)
+{
+    if (parent == AABB_TREE_NULL)
+    {
+        tree->root = newChild;
+    }
+    else if (tree->nodes[parent].child1 == oldChild)
+    {
+        tree->nodes[parent].child1 = newChild;
+    }
+    else
+    {
+        tree->nodes[parent].child2 = newChild;
+    }
+}
+
+// if one child of node is more than one level deeper than the other, that child is rotated up into node's place
+// returns the node now at node's place
+int BalanceAabbTree(aabb_tree_t *tree, int node)
+{
+    aabb_tree_node_t *nodes = tree->nodes;
+    if (nodes[node].height < 2)
+    {
+        return node;
+    }
+    int child1 = nodes[node].child1;
+    int child2 = nodes[node].child2;
+    int balance = nodes[child2].height - nodes[child1].height;
+    if (balance >= -1 && balance <= 1)
+    {
+        return node;
+    }
+    // up is the deeper child, it takes node's place and node keeps the other child plus up's shallower child
+    int up = balance > 1 ? child2 : child1;
+    int upChild1 = nodes[up].child1;
+    int upChild2 = nodes[up].child2;
+    int deeper = nodes[upChild1].height > nodes[upChild2].height ? upChild1 : upChild2;
+    int shallower = deeper == upChild1 ? upChild2 : upChild1;
+
+    nodes[up].parent = nodes[node].parent;
+    ReplaceAabbTreeChild(tree, nodes[up].parent, node, up);
+    nodes[node].parent = up;
+    nodes[up].child1 = node;
+    nodes[up].child2 = deeper;
+    if (up == child2)
+    {
+        nodes[node].child2 = shallower;
+    }
+    else
+    {
+        nodes[node].child1 = shallower;
+    }
+    nodes[shallower].parent = node;
+    UpdateAabbTreeNode(tree, node);
+    UpdateAabbTreeNode(tree, up);
+    return up;
+}
+
+// refits the boxes and heights from node to the root, balancing on the way
+void RefitAabbTree(aabb_tree_t *tree, int node)
+{
+    while (node != AABB_TREE_NULL)
+    {
+        node = BalanceAabbTree(tree, node);
+        UpdateAabbTreeNode(tree, node);
+        node = tree->nodes[node].parent;
+    }
+}
+
+// walks down to the sibling that grows the total perimeter of the tree least, then pairs the leaf with it
+void InsertAabbTreeLeaf(aabb_tree_t *tree, int leaf)
+{
+    aabb_tree_node_t *nodes = tree->nodes;
+    if (tree->root == AABB_TREE_NULL)
+    {
+        tree->root = leaf;
+        nodes[leaf].parent = AABB_TREE_NULL;
+        return;
+    }
+    bounds_t bounds = nodes[leaf].bounds;
+    int sibling = tree->root;
+    while (nodes[sibling].height > 0)
+    {
+        real_t perimeter = GetBoundsPerimeter(nodes[sibling].bounds);
+        real_t combinedPerimeter = GetBoundsPerimeter(GetBoundsUnion(nodes[sibling].bounds, bounds));
+        // making a new parent for the leaf and this node
+        real_t cost = 2 * combinedPerimeter;
+        // every ancestor of a child grows with the leaf too
+        real_t inheritedCost = 2 * (combinedPerimeter - perimeter);
+        real_t childCosts[2];
+        int children[2] = {nodes[sibling].child1, nodes[sibling].child2};
+        for (int i = 0; i < 2; i++)
+        {
+            real_t childPerimeter = GetBoundsPerimeter(GetBoundsUnion(nodes[children[i]].bounds, bounds));
+            childCosts[i] = nodes[children[i]].height == 0 ? childPerimeter + inheritedCost
+                                                           : childPerimeter - GetBoundsPerimeter(nodes[children[i]].bounds) + inheritedCost;
+        }
+        if (cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+        sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateAabbTreeNode(tree);
+    nodes = tree->nodes;
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    ReplaceAabbTreeChild(tree, oldParent, sibling, newParent);
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    RefitAabbTree(tree, newParent);
+}
+
+// the leaf stays allocated, its parent goes and the sibling takes the parent's place
+void RemoveAabbTreeLeaf(aabb_tree_t *tree, int leaf)
+{
+    aabb_tree_node_t *nodes = tree->nodes;
+    if (leaf == tree->root)
+    {
+        tree->root = AABB_TREE_NULL;
+        return;
+    }
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+    ReplaceAabbTreeChild(tree, grandParent, parent, sibling);
+    nodes[sibling].parent = grandParent;
+    FreeAabbTreeNode(tree, parent);
+    RefitAabbTree(tree, grandParent);
+}
+
+int AabbTreeInsert(aabb_tree_t *tree, bounds_t bounds, int item)
+{
+    int leaf = AllocateAabbTreeNode(tree);
+    tree->nodes[leaf].bounds = bounds;
+    tree->nodes[leaf].item = item;
+    InsertAabbTreeLeaf(tree, leaf);
+    return leaf;
+}
+
+void AabbTreeRemove(aabb_tree_t *tree, int leaf)
+{
+    RemoveAabbTreeLeaf(tree, leaf);
+    FreeAabbTreeNode(tree, leaf);
+}
+
+void AabbTreeMove(aabb_tree_t *tree, int leaf, bounds_t bounds)
+{
+    RemoveAabbTreeLeaf(tree, leaf);
+    tree->nodes[leaf].bounds = bounds;
+    InsertAabbTreeLeaf(tree, leaf);
+}
+
+void AabbTreeQuery(const aabb_tree_t *tree, bounds_t bounds, aabb_tree_query_t callback, void *context)
+{
+    int stack[AABB_TREE_STACK];
+    int stackCount = 0;
+    if (tree->root != AABB_TREE_NULL)
+    {
+        stack[stackCount++] = tree->root;
+    }
+    while (stackCount > 0)
+    {
+        const aabb_tree_node_t *node = &tree->nodes[stack[--stackCount]];
+        if (!CheckBoundsOverlap(node->bounds, bounds))
+        {
+            continue;
+        }
+        if (node->height == 0)
+        {
+            if (!callback(context, node->item))
+            {
+                return;
+            }
+        }
+        else
+        {
+            stack[stackCount++] = node->child1;
+            stack[stackCount++] = node->child2;
+        }
+    }
+}
+
+void AabbTreeRaycast(const aabb_tree_t *tree, real_t originX, real_t originY, real_t directionX, real_t directionY, real_t maxFraction,
+                     aabb_tree_raycast_t callback, void *context)
+{
+    int stack[AABB_TREE_STACK];
+    int stackCount = 0;
+    if (tree->root != AABB_TREE_NULL)
+    {
+        stack[stackCount++] = tree->root;
+    }
+    while (stackCount > 0)
+    {
+        const aabb_tree_node_t *node = &tree->nodes[stack[--stackCount]];
+        real_t fraction;
+        int axis;
+        // maxFraction shrinks with every hit, so boxes past the nearest hit so far are skipped
+        if (!GetRayBoundsFraction(node->bounds, originX, originY, directionX, directionY, maxFraction, &fraction, &axis))
+        {
+            continue;
+        }
+        if (node->height == 0)
+        {
+            maxFraction = callback(context, node->item, maxFraction);
+            if (maxFraction <= 0)
+            {
+                return;
+            }
+        }
+        else
+        {
+            stack[stackCount++] = node->child1;
+            stack[stackCount++] = node->child2;
+        }
+    }
+}
+
+int GetAabbTreeHeight(const aabb_tree_t *tree)
+{
+    return tree->root != AABB_TREE_NULL ? tree->nodes[tree->root].height : 0;
+}
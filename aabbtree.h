@@ -0,0 +1,79 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include <stdbool.h>
+#include "real.h"
+
+// dynamic bounding volume tree: leaves hold an item and a box around it, inner nodes the union of their children
+// kept balanced with rotations like an avl tree, so inserting, removing and querying are all O(log n)
+// leaves are meant to be fattened by the caller, an item only has to move in the tree once it leaves its fat box
+
+#define AABB_TREE_NULL -1
+#define AABB_TREE_STACK 256 // traversal stack, a balanced tree of POOL_MAX_ITEMS leaves is less than 40 deep
+
+typedef struct bounds_t
+{
+    real_t minX;
+    real_t minY;
+    real_t maxX;
+    real_t maxY;
+} bounds_t;
+
+typedef struct aabb_tree_node_t
+{
+    bounds_t bounds;
+    int parent; // next free node while the node is free
+    int child1; // AABB_TREE_NULL for leaves
+    int child2;
+    int height; // 0 for leaves, -1 while free
+    int item;   // leaves only
+} aabb_tree_node_t;
+
+typedef struct aabb_tree_t
+{
+    aabb_tree_node_t *nodes;
+    int root;
+    int freeNode;
+    int count; // nodes in use, inner ones included
+    int max;
+} aabb_tree_t;
+
+// return false to stop the query
+typedef bool (*aabb_tree_query_t)(void *context, int item);
+// the ray is origin + t * direction for t in [0, maxFraction], return the new max fraction to clip the ray
+// (the hit's fraction for a closest hit search), maxFraction to go on unchanged, or 0 to stop
+typedef real_t (*aabb_tree_raycast_t)(void *context, int item, real_t maxFraction);
+
+void InitAabbTree(aabb_tree_t *tree);
+void FreeAabbTree(aabb_tree_t *tree);
+// drops every leaf but keeps the memory
+void ClearAabbTree(aabb_tree_t *tree);
+// returns the leaf, it names the item until it is removed
+int AabbTreeInsert(aabb_tree_t *tree, bounds_t bounds, int item);
+void AabbTreeRemove(aabb_tree_t *tree, int leaf);
+// new bounds for the leaf, it's reinserted where they fit best and keeps its index
+void AabbTreeMove(aabb_tree_t *tree, int leaf, bounds_t bounds);
+
+// inline, the broad phase runs this in its innermost loop
+static inline bool CheckBoundsOverlap(bounds_t bounds1, bounds_t bounds2)
+{
+    return bounds1.minX <= bounds2.maxX && bounds2.minX <= bounds1.maxX && bounds1.minY <= bounds2.maxY && bounds2.minY <= bounds1.maxY;
+}
+
+static inline bool CheckBoundsContain(bounds_t outer, bounds_t inner)
+{
+    return outer.minX <= inner.minX && outer.minY <= inner.minY && inner.maxX <= outer.maxX && inner.maxY <= outer.maxY;
+}
+
+// fraction of the direction where the ray enters bounds, 0 when it starts inside, false if it misses them up to maxFraction
+// axis is 0 or 1 for the x or y side it came through, -1 when it starts inside
+bool GetRayBoundsFraction(bounds_t bounds, real_t originX, real_t originY, real_t directionX, real_t directionY, real_t maxFraction,
+                          real_t *fraction, int *axis);
+// calls back every leaf whose box overlaps bounds
+void AabbTreeQuery(const aabb_tree_t *tree, bounds_t bounds, aabb_tree_query_t callback, void *context);
+// calls back the leaves whose box the ray passes through, nearest boxes are not guaranteed to come first
+void AabbTreeRaycast(const aabb_tree_t *tree, real_t originX, real_t originY, real_t directionX, real_t directionY, real_t maxFraction,
+                     aabb_tree_raycast_t callback, void *context);
+int GetAabbTreeHeight(const aabb_tree_t *tree);
+
+#endif
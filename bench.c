@@ -0,0 +1,357 @@
+#include "physics.h"
+#include "scenarios.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// runs every scenario for a fixed number of steps and reports throughput as json or csv
+// usage: bench [--scenario NAME|particles|all] [--bodies N[,N...]] [--particles N[,N...]] [--steps N] [--warmup N] [--seed N] [--threads N] [--format json|csv] [--output FILE]
+// particle counts are stepped as the scenario "particles" after the others, --scenario particles runs only them
+
+#define BENCH_MAX_SIZES 16
+
+typedef struct bench_options_t
+{
+    int scenarios[SCENARIO_COUNT];
+    int scenariosCount;
+    int sizes[BENCH_MAX_SIZES];
+    int sizesCount;
+    int particleSizes[BENCH_MAX_SIZES];
+    int particleSizesCount;
+    int steps;
+    int warmupSteps;
+    unsigned int seed;
+    int threads;
+    bool csv;
+    const char *outputPath;
+} bench_options_t;
+
+typedef struct bench_result_t
+{
+    int bodies;
+    int steps;
+    double seconds;
+    long long candidatePairs;
+    long long collisions;
+    long peakRssKb;
+    bool failed;
+} bench_result_t;
+
+const double benchDeltaTime = 1 / 360.0;
+const double benchParticleDeltaTime = 1 / 60.0; // particles substep on their own, they're stepped once a frame
+const int benchParticleSizes[] = {10000, 100000};
+
+typedef bench_result_t (*bench_run_t)(scenario_kind_t kind, int bodies, bench_options_t options);
+
+double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+long GetPeakRssKb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+bool ParseSizes(const char *text, int *sizes, int *sizesCount)
+{
+    *sizesCount = 0;
+    while (*text != '\0' && *sizesCount < BENCH_MAX_SIZES)
+    {
+        char *end;
+        long size = strtol(text, &end, 10);
+        if (end == text || size <= 0)
+        {
+            return false;
+        }
+        sizes[(*sizesCount)++] = (int)size;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return *sizesCount > 0;
+}
+
+bool ParseBenchOptions(int argc, char **argv, bench_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (strcmp(argv[i], "--scenario") == 0)
+        {
+            const char *name = argv[++i];
+            scenario_kind_t kind;
+            if (strcmp(name, "all") == 0)
+            {
+                continue;
+            }
+            if (strcmp(name, "particles") == 0)
+            {
+                options->scenariosCount = 0;
+                if (options->particleSizesCount == 0)
+                {
+                    memcpy(options->particleSizes, benchParticleSizes, sizeof(benchParticleSizes));
+                    options->particleSizesCount = sizeof(benchParticleSizes) / sizeof(benchParticleSizes[0]);
+                }
+                continue;
+            }
+            if (!GetScenarioFromName(name, &kind))
+            {
+                return false;
+            }
+            options->scenarios[0] = kind;
+            options->scenariosCount = 1;
+        }
+        else if (strcmp(argv[i], "--bodies") == 0)
+        {
+            if (!ParseSizes(argv[++i], options->sizes, &options->sizesCount))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--particles") == 0)
+        {
+            if (!ParseSizes(argv[++i], options->particleSizes, &options->particleSizesCount))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--steps") == 0)
+        {
+            options->steps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0)
+        {
+            options->warmupSteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            options->seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            options->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--format") == 0)
+        {
+            const char *format = argv[++i];
+            if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0)
+            {
+                return false;
+            }
+            options->csv = strcmp(format, "csv") == 0;
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            options->outputPath = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options->steps > 0 && options->warmupSteps >= 0 && options->threads > 0;
+}
+
+bench_result_t RunScenario(scenario_kind_t kind, int bodies, bench_options_t options)
+{
+    world_t *world = WorldCreate();
+    GenerateScenario(world, kind, bodies, options.seed);
+    WorldSetThreads(world, options.threads);
+    for (int i = 0; i < options.warmupSteps; i++)
+    {
+        WorldStep(world, benchDeltaTime);
+    }
+    world->stats = (world_stats_t){0};
+
+    double start = GetSeconds();
+    for (int i = 0; i < options.steps; i++)
+    {
+        WorldStep(world, benchDeltaTime);
+    }
+    bench_result_t result = {0};
+    result.seconds = GetSeconds() - start;
+    result.bodies = world->balls.pointer + world->rects.pointer;
+    result.steps = options.steps;
+    result.candidatePairs = world->stats.candidatePairs;
+    result.collisions = world->stats.collisions;
+    result.peakRssKb = GetPeakRssKb();
+    WorldDestroy(world);
+    return result;
+}
+
+// candidate pairs are the pairs in the neighbor lists and collisions the overlapping ones
+bench_result_t RunParticles(scenario_kind_t kind, int count, bench_options_t options)
+{
+    (void)kind;
+    bench_result_t result = {0};
+    result.bodies = count;
+    result.steps = options.steps;
+    particles_t *particles = CreateParticleScenario(count, options.seed);
+    if (particles == NULL)
+    {
+        result.failed = true;
+        return result;
+    }
+    ParticlesSetThreads(particles, options.threads);
+    for (int i = 0; i < options.warmupSteps; i++)
+    {
+        ParticlesStep(particles, benchParticleDeltaTime);
+    }
+    particles->stats = (particles_stats_t){0};
+
+    double start = GetSeconds();
+    for (int i = 0; i < options.steps; i++)
+    {
+        ParticlesStep(particles, benchParticleDeltaTime);
+    }
+    result.seconds = GetSeconds() - start;
+    result.candidatePairs = particles->stats.neighbors;
+    result.collisions = particles->stats.contacts;
+    result.peakRssKb = GetPeakRssKb();
+    ParticlesDestroy(particles);
+    return result;
+}
+
+// every run gets a fresh process so peak rss belongs to that scenario alone and earlier runs can't warm the heap
+bench_result_t RunScenarioInChild(bench_run_t run, scenario_kind_t kind, int bodies, bench_options_t options)
+{
+    bench_result_t result = {0};
+    result.bodies = bodies;
+    result.steps = options.steps;
+    result.failed = true;
+    int pipeEnds[2];
+    if (pipe(pipeEnds) != 0)
+    {
+        return result;
+    }
+    fflush(NULL);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(pipeEnds[0]);
+        // keep anything the simulation prints away from the results
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+        {
+            dup2(devNull, STDOUT_FILENO);
+        }
+        bench_result_t childResult = run(kind, bodies, options);
+        ssize_t written = write(pipeEnds[1], &childResult, sizeof(childResult));
+        _exit(written == sizeof(childResult) ? 0 : 1);
+    }
+    close(pipeEnds[1]);
+    if (child > 0)
+    {
+        bench_result_t childResult;
+        if (read(pipeEnds[0], &childResult, sizeof(childResult)) == sizeof(childResult))
+        {
+            result = childResult;
+        }
+        waitpid(child, NULL, 0);
+    }
+    close(pipeEnds[0]);
+    return result;
+}
+
+void WriteResult(FILE *output, bench_options_t options, const char *scenario, bench_result_t result, bool first)
+{
+    double stepsPerSecond = result.seconds > 0 ? result.steps / result.seconds : 0;
+    double nsPerBodyStep = result.bodies > 0 && result.steps > 0 ? result.seconds * 1e9 / ((double)result.bodies * result.steps) : 0;
+    double candidatesPerStep = result.steps > 0 ? (double)result.candidatePairs / result.steps : 0;
+    double collisionsPerStep = result.steps > 0 ? (double)result.collisions / result.steps : 0;
+    if (options.csv)
+    {
+        fprintf(output, "%s,%s,%d,%d,%u,%d,%s,%.6f,%.2f,%.3f,%lld,%lld,%.2f,%.2f,%ld,%s\n",
+                scenario, REAL_NAME, result.bodies, result.steps, options.seed, options.threads, result.failed ? "failed" : "ok",
+                result.seconds, stepsPerSecond, nsPerBodyStep,
+                result.candidatePairs, result.collisions, candidatesPerStep, collisionsPerStep, result.peakRssKb, GetPhysicsKernelsName());
+        return;
+    }
+    fprintf(output, "%s    {\"scenario\": \"%s\", \"precision\": \"%s\", \"bodies\": %d, \"steps\": %d, \"seed\": %u, \"threads\": %d, \"status\": \"%s\", "
+                    "\"seconds\": %.6f, \"steps_per_sec\": %.2f, \"ns_per_body_step\": %.3f, "
+                    "\"candidate_pairs\": %lld, \"collisions\": %lld, "
+                    "\"candidate_pairs_per_step\": %.2f, \"collisions_per_step\": %.2f, \"peak_rss_kb\": %ld, \"kernels\": \"%s\"}",
+            first ? "" : ",\n", scenario, REAL_NAME, result.bodies, result.steps, options.seed, options.threads, result.failed ? "failed" : "ok",
+            result.seconds, stepsPerSecond, nsPerBodyStep,
+            result.candidatePairs, result.collisions, candidatesPerStep, collisionsPerStep, result.peakRssKb, GetPhysicsKernelsName());
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options = {0};
+    for (int i = 0; i < SCENARIO_COUNT; i++)
+    {
+        options.scenarios[i] = i;
+    }
+    options.scenariosCount = SCENARIO_COUNT;
+    options.sizes[0] = 1000;
+    options.sizes[1] = 10000;
+    options.sizesCount = 2;
+    options.steps = 200;
+    options.warmupSteps = 10;
+    options.seed = 1;
+    options.threads = 1;
+    if (!ParseBenchOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "usage: %s [--scenario NAME|particles|all] [--bodies N[,N...]] [--particles N[,N...]] [--steps N] [--warmup N] [--seed N] [--threads N] [--format json|csv] [--output FILE]\n", argv[0]);
+        return 1;
+    }
+    FILE *output = options.outputPath != NULL ? fopen(options.outputPath, "w") : stdout;
+    if (output == NULL)
+    {
+        perror(options.outputPath);
+        return 1;
+    }
+
+    if (options.csv)
+    {
+        fprintf(output, "scenario,precision,bodies,steps,seed,threads,status,seconds,steps_per_sec,ns_per_body_step,"
+                        "candidate_pairs,collisions,candidate_pairs_per_step,collisions_per_step,peak_rss_kb,kernels\n");
+    }
+    else
+    {
+        fprintf(output, "{\"bench\": [\n");
+    }
+    bool failed = false;
+    for (int i = 0; i < options.scenariosCount; i++)
+    {
+        for (int j = 0; j < options.sizesCount; j++)
+        {
+            bench_result_t result = RunScenarioInChild(RunScenario, options.scenarios[i], options.sizes[j], options);
+            WriteResult(output, options, GetScenarioName(options.scenarios[i]), result, i == 0 && j == 0);
+            fflush(output);
+            failed = failed || result.failed;
+        }
+    }
+    for (int i = 0; i < options.particleSizesCount; i++)
+    {
+        bench_result_t result = RunScenarioInChild(RunParticles, 0, options.particleSizes[i], options);
+        WriteResult(output, options, "particles", result, options.scenariosCount == 0 && i == 0);
+        fflush(output);
+        failed = failed || result.failed;
+    }
+    if (!options.csv)
+    {
+        fprintf(output, "\n]}\n");
+    }
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# runs bench and bench_f32 with the same arguments and puts their throughput and memory side by side
+# usage: ./benchprecision.sh [bench options except --format and --output]
+# the programs come from build/release, BUILD_DIR picks another build
+set -e
+dir=${BUILD_DIR:-build/release}
+f64=$(mktemp)
+f32=$(mktemp)
+trap 'rm -f "$f64" "$f32"' EXIT
+"$dir/bench" --format csv "$@" > "$f64"
+"$dir/bench_f32" --format csv "$@" > "$f32"
+# columns: 1 scenario, 3 bodies, 8 seconds, 9 steps_per_sec, 10 ns_per_body_step, 15 peak_rss_kb
+awk -F, '
+    FNR == 1 { next }
+    NR == FNR { steps[$1 "," $3] = $9; ns[$1 "," $3] = $10; rss[$1 "," $3] = $15; next }
+    {
+        key = $1 "," $3
+        if (!(key in steps)) next
+        speedup = steps[key] > 0 ? $9 / steps[key] : 0
+        printf "%-12s %8d %12.1f %12.1f %8.2fx %12.1f %12.1f %11d %11d\n", $1, $3, steps[key], $9, speedup, ns[key], $10, rss[key], $15
+    }
+    BEGIN { printf "%-12s %8s %12s %12s %9s %12s %12s %11s %11s\n", "scenario", "bodies", "f64 steps/s", "f32 steps/s", "speedup", "f64 ns/body", "f32 ns/body", "f64 rss kb", "f32 rss kb" }
+' "$f64" "$f32"
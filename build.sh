@@ -1,2 +1,17 @@
 #!/bin/sh
-cc main.c `pkg-config --libs --cflags raylib` -o game
\ No newline at end of file
+# builds every program with one of the presets in CMakePresets.json, they end up in build/PRESET
+# usage: ./build.sh [release|debug|lto|pgo], release by default
+# pgo builds instrumented programs, trains them on the scenario generator and builds everything again with the profile
+set -e
+preset=${1:-release}
+if [ "$preset" = pgo ]; then
+    rm -rf build/pgo/pgo
+    cmake --preset pgo -DPHYSICS_PGO=GENERATE
+    cmake --build --preset pgo
+    cmake --build --preset pgo --target pgo-train
+    cmake --preset pgo -DPHYSICS_PGO=USE
+    cmake --build --preset pgo
+else
+    cmake --preset "$preset"
+    cmake --build --preset "$preset"
+fi
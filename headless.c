@@ -0,0 +1,254 @@
+#include "physics.h"
+#include "scheduler.h"
+#include "scenarios.h"
+#include "trace.h"
+#include "scene.h"
+#include "replay.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// steps a world as fast as the cpu allows, no window and no frame rate cap
+// usage: headless [--scenario NAME] [--bodies N] [--steps N] [--dt SECONDS] [--seed N] [--threads N] [--iterations N] [--max-substeps N] [--map-width N] [--map-height N] [--load FILE] [--save FILE] [--record FILE] [--keyframe-interval N] [--trace FILE] [--trace-mask NAMES] [--profile FILE] [--profile-format csv|json]
+
+typedef struct headless_options_t
+{
+    scenario_kind_t scenario;
+    int bodies;
+    int steps;
+    double deltaTime;
+    unsigned int seed;
+    int threads;
+    int velocityIterations;
+    int maxSubsteps; // 1 steps every --dt in one go, more lets fast or crowded steps split
+    double mapWidth;
+    double mapHeight;
+    const char *loadPath; // replaces the scenario
+    const char *savePath; // the world after the last step
+    const char *recordPath;
+    int keyframeInterval;
+    const char *tracePath;
+    unsigned int traceMask;
+    const char *profilePath;
+    bool profileCsv;
+} headless_options_t;
+
+double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool ParseHeadlessOptions(int argc, char **argv, headless_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (strcmp(argv[i], "--scenario") == 0)
+        {
+            if (!GetScenarioFromName(argv[++i], &options->scenario))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--bodies") == 0)
+        {
+            options->bodies = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--steps") == 0)
+        {
+            options->steps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dt") == 0)
+        {
+            options->deltaTime = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            options->seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            options->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0)
+        {
+            options->velocityIterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-substeps") == 0)
+        {
+            options->maxSubsteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--map-width") == 0)
+        {
+            options->mapWidth = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--map-height") == 0)
+        {
+            options->mapHeight = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--load") == 0)
+        {
+            options->loadPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save") == 0)
+        {
+            options->savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0)
+        {
+            options->recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--keyframe-interval") == 0)
+        {
+            options->keyframeInterval = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            options->tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            options->profilePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile-format") == 0)
+        {
+            const char *format = argv[++i];
+            if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0)
+            {
+                return false;
+            }
+            options->profileCsv = strcmp(format, "csv") == 0;
+        }
+        else if (strcmp(argv[i], "--trace-mask") == 0)
+        {
+            if (!GetTraceMaskFromNames(argv[++i], &options->traceMask))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options->bodies >= 0 && options->steps >= 0 && options->deltaTime > 0 && options->threads > 0 && options->velocityIterations > 0 && options->maxSubsteps > 0 && options->mapWidth > 0 && options->mapHeight > 0 && options->keyframeInterval > 0;
+}
+
+int main(int argc, char **argv)
+{
+    world_t *world = WorldCreate();
+    headless_options_t options = {SCENARIO_MIXED, 1000, 1000, 1 / 360.0, 1, 1, world->velocityIterations, 1, screenWidth, screenHeight, NULL, NULL, NULL, 360, NULL, TRACE_STEP | TRACE_SLEEP, NULL, true};
+    if (!ParseHeadlessOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "usage: %s [--scenario NAME] [--bodies N] [--steps N] [--dt SECONDS] [--seed N] [--threads N] [--iterations N] [--max-substeps N] [--map-width N] [--map-height N] [--load FILE] [--save FILE] [--record FILE] [--keyframe-interval N] [--trace FILE] [--trace-mask NAMES] [--profile FILE] [--profile-format csv|json]\n", argv[0]);
+        WorldDestroy(world);
+        return 1;
+    }
+
+    double loadStart = GetSeconds();
+    if (options.loadPath == NULL)
+    {
+        world->mapBounds = (bounds_t){0, 0, options.mapWidth, options.mapHeight};
+        GenerateScenario(world, options.scenario, options.bodies, options.seed);
+    }
+    else if (!WorldLoad(world, options.loadPath))
+    {
+        fprintf(stderr, "%s: can't load scene\n", options.loadPath);
+        WorldDestroy(world);
+        return 1;
+    }
+    double loadSeconds = GetSeconds() - loadStart;
+    WorldSetThreads(world, options.threads);
+    world->velocityIterations = options.velocityIterations;
+
+    if (options.tracePath != NULL && !TraceStart(options.tracePath, options.traceMask))
+    {
+        perror(options.tracePath);
+        WorldDestroy(world);
+        return 1;
+    }
+
+    replay_recorder_t *recorder = NULL;
+    if (options.recordPath != NULL && (recorder = ReplayRecorderStart(options.recordPath, options.keyframeInterval)) == NULL)
+    {
+        perror(options.recordPath);
+        WorldDestroy(world);
+        return 1;
+    }
+
+    scheduler_t scheduler;
+    InitScheduler(&scheduler, options.deltaTime);
+    scheduler.maxSubsteps = options.maxSubsteps;
+    long long substeps = 0;
+    double start = GetSeconds();
+    for (int i = 0; i < options.steps; i++)
+    {
+        substeps += SchedulerStep(&scheduler, world, NULL, NULL);
+        if (recorder != NULL)
+        {
+            ReplayRecord(recorder, world);
+        }
+    }
+    double elapsed = GetSeconds() - start;
+    FreeScheduler(&scheduler);
+    TraceStop();
+    if (recorder != NULL)
+    {
+        long long recordedBytes = 0;
+        if (!ReplayRecorderStop(recorder, &recordedBytes))
+        {
+            perror(options.recordPath);
+        }
+        printf("recorded bytes: %lld\n", recordedBytes);
+    }
+    if (options.savePath != NULL && !WorldSave(world, options.savePath))
+    {
+        perror(options.savePath);
+    }
+
+    int bodies = world->balls.pointer + world->rects.pointer;
+    printf("scenario: %s\n"
+           "precision: %s\n"
+           "kernels: %s\n"
+           "load seconds: %.4f\n"
+           "threads: %d\n"
+           "steps: %d\n"
+           "substeps: %lld\n"
+           "bodies: %d\n"
+           "seconds: %.3f\n"
+           "steps/sec: %.1f\n"
+           "candidate pairs: %lld\n"
+           "collisions: %lld\n"
+           "warm started contacts: %lld\n"
+           "swept bodies: %lld\n"
+           "time of impact hits: %lld\n"
+           "awake bodies: %d\n"
+           "checksum: %016llx\n",
+           options.loadPath != NULL ? options.loadPath : GetScenarioName(options.scenario), REAL_NAME, GetPhysicsKernelsName(), loadSeconds, options.threads, options.steps, substeps, bodies, elapsed, elapsed > 0 ? options.steps / elapsed : 0,
+           world->stats.candidatePairs, world->stats.collisions, world->stats.warmStarts,
+           world->stats.sweptBodies, world->stats.impacts, world->stats.awakeBodies, GetWorldChecksum(world));
+    // "-" writes the profile after the summary on stdout
+    FILE *profileOutput = options.profilePath == NULL || strcmp(options.profilePath, "-") == 0 ? stdout : fopen(options.profilePath, "w");
+    if (options.profilePath != NULL && profileOutput == NULL)
+    {
+        perror(options.profilePath);
+        WorldDestroy(world);
+        return 1;
+    }
+    if (options.profilePath != NULL)
+    {
+        WriteProfile(profileOutput, &world->profile, options.profileCsv);
+    }
+    if (profileOutput != stdout)
+    {
+        fclose(profileOutput);
+    }
+    WorldDestroy(world);
+    return 0;
+}
@@ -0,0 +1,152 @@
+// built once per variant, simd.h follows the instruction set: KERNELS_AVX2 along with -mavx2 makes the AVX2 one,
+// KERNELS_SCALAR turns SIMD off for the scalar one
+#if defined(KERNELS_AVX2)
+#define KERNELS_TABLE physicsKernelsAvx2
+#define KERNELS_NAME "avx2"
+#elif defined(KERNELS_SCALAR)
+#define SIMD_DISABLED
+#define KERNELS_TABLE physicsKernelsScalar
+#define KERNELS_NAME "scalar"
+#else
+#define KERNELS_TABLE physicsKernelsBaseline
+#define KERNELS_NAME SIMD_NAME
+#endif
+
+#include "kernels.h"
+#include <tgmath.h>
+#include "simd.h"
+
+static void AddScaledToArray(real_t *values, real_t amount, const real_t *scales, int count)
+{
+    int i = 0;
+#if SIMD_WIDTH > 1
+    simd_t amountVector = SimdSet(amount);
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdStore(&values[i], SimdAdd(SimdLoad(&values[i]), SimdMul(amountVector, SimdLoad(&scales[i]))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        values[i] += amount * scales[i];
+    }
+}
+
+static void ClampToWalls(real_t *position, real_t *velocity, const real_t *extent, real_t lowExtentScale, real_t low, real_t high, real_t bounce, int count)
+{
+    int i = 0;
+#if SIMD_WIDTH > 1
+    simd_t lowVector = SimdSet(low);
+    simd_t highVector = SimdSet(high);
+    simd_t lowExtentScaleVector = SimdSet(lowExtentScale);
+    simd_t bounceVector = SimdSet(-bounce);
+    simd_t overshootVector = SimdSet(bounce);
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        simd_t positionVector = SimdLoad(&position[i]);
+        simd_t extentVector = SimdLoad(&extent[i]);
+        simd_t minPosition = SimdAdd(lowVector, SimdMul(lowExtentScaleVector, extentVector));
+        simd_t maxPosition = SimdSub(highVector, extentVector);
+        simd_t belowMask = SimdLess(positionVector, minPosition);
+        simd_t aboveMask = SimdAndNot(belowMask, SimdLess(maxPosition, positionVector));
+        simd_t hitMask = SimdOr(belowMask, aboveMask);
+        if (!SimdAny(hitMask))
+        {
+            continue;
+        }
+        simd_t velocityVector = SimdLoad(&velocity[i]);
+        SimdStore(&velocity[i], SimdSelect(hitMask, velocityVector, SimdMul(velocityVector, bounceVector)));
+        simd_t reflectedLow = SimdAdd(minPosition, SimdMul(SimdSub(minPosition, positionVector), overshootVector));
+        simd_t reflectedHigh = SimdAdd(maxPosition, SimdMul(SimdSub(maxPosition, positionVector), overshootVector));
+        positionVector = SimdSelect(belowMask, positionVector, reflectedLow);
+        positionVector = SimdSelect(aboveMask, positionVector, reflectedHigh);
+        // an overshoot longer than the map would carry it past the other wall
+        SimdStore(&position[i], SimdMax(SimdMin(positionVector, maxPosition), minPosition));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        real_t minPosition = low + lowExtentScale * extent[i];
+        real_t maxPosition = high - extent[i];
+        if (position[i] < minPosition)
+        {
+            velocity[i] *= -bounce;
+            position[i] = fmax(fmin(minPosition + (minPosition - position[i]) * bounce, maxPosition), minPosition);
+        }
+        else if (position[i] > maxPosition)
+        {
+            velocity[i] *= -bounce;
+            position[i] = fmax(fmin(maxPosition + (maxPosition - position[i]) * bounce, maxPosition), minPosition);
+        }
+    }
+}
+
+// contacts inside a batch share no bodies so SIMD_WIDTH of them are solved side by side
+// the points of one contact share both bodies, so they go one after the other
+// the accumulated impulse may only push, so a correction can take back at most what was applied so far
+static void SolveContacts(solver_bodies_t *bodies, contacts_list_t *contacts, int begin, int end)
+{
+    int i = begin;
+#if SIMD_WIDTH > 1
+    simd_t zero = SimdSet(0);
+    for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH)
+    {
+        simd_t normalX = SimdLoad(&contacts->normalX[i]);
+        simd_t normalY = SimdLoad(&contacts->normalY[i]);
+        int pointsCount = 0;
+        for (int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            pointsCount = contacts->pointsCount[i + lane] > pointsCount ? contacts->pointsCount[i + lane] : pointsCount;
+        }
+        for (int point = 0; point < pointsCount; point++)
+        {
+            real_t relativeX[SIMD_WIDTH];
+            real_t relativeY[SIMD_WIDTH];
+            real_t spinningVelocity1[SIMD_WIDTH];
+            real_t spinningVelocity2[SIMD_WIDTH];
+            for (int lane = 0; lane < SIMD_WIDTH; lane++)
+            {
+                int body1 = contacts->body1[i + lane];
+                int body2 = contacts->body2[i + lane];
+                relativeX[lane] = bodies->velocityX[body1] - bodies->velocityX[body2];
+                relativeY[lane] = bodies->velocityY[body1] - bodies->velocityY[body2];
+                spinningVelocity1[lane] = bodies->spinningVelocity[body1];
+                spinningVelocity2[lane] = bodies->spinningVelocity[body2];
+            }
+            simd_t normalVelocity = SimdAdd(SimdMul(SimdLoad(relativeX), normalX), SimdMul(SimdLoad(relativeY), normalY));
+            normalVelocity = SimdAdd(normalVelocity, SimdMul(SimdLoad(spinningVelocity1), SimdLoad(&contacts->armCross1[point][i])));
+            normalVelocity = SimdSub(normalVelocity, SimdMul(SimdLoad(spinningVelocity2), SimdLoad(&contacts->armCross2[point][i])));
+            simd_t impulse = SimdMul(SimdSub(SimdLoad(&contacts->bounceVelocity[point][i]), normalVelocity), SimdLoad(&contacts->normalMass[point][i]));
+            simd_t oldNormalImpulse = SimdLoad(&contacts->normalImpulse[point][i]);
+            simd_t normalImpulse = SimdMax(SimdAdd(oldNormalImpulse, impulse), zero);
+            SimdStore(&contacts->normalImpulse[point][i], normalImpulse);
+
+            real_t impulses[SIMD_WIDTH];
+            SimdStore(impulses, SimdSub(normalImpulse, oldNormalImpulse));
+            for (int lane = 0; lane < SIMD_WIDTH; lane++)
+            {
+                ApplyContactImpulse(bodies, contacts, i + lane, point, impulses[lane]);
+            }
+        }
+    }
+#endif
+    for (; i < end; i++)
+    {
+        int body1 = contacts->body1[i];
+        int body2 = contacts->body2[i];
+        for (int point = 0; point < contacts->pointsCount[i]; point++)
+        {
+            real_t normalVelocity = (bodies->velocityX[body1] - bodies->velocityX[body2]) * contacts->normalX[i] +
+                                    (bodies->velocityY[body1] - bodies->velocityY[body2]) * contacts->normalY[i];
+            normalVelocity = normalVelocity + bodies->spinningVelocity[body1] * contacts->armCross1[point][i];
+            normalVelocity = normalVelocity - bodies->spinningVelocity[body2] * contacts->armCross2[point][i];
+            real_t impulse = (contacts->bounceVelocity[point][i] - normalVelocity) * contacts->normalMass[point][i];
+            real_t normalImpulse = fmax(contacts->normalImpulse[point][i] + impulse, (real_t)0);
+            impulse = normalImpulse - contacts->normalImpulse[point][i];
+            contacts->normalImpulse[point][i] = normalImpulse;
+            ApplyContactImpulse(bodies, contacts, i, point, impulse);
+        }
+    }
+}
+
+const physics_kernels_t KERNELS_TABLE = {KERNELS_NAME, AddScaledToArray, ClampToWalls, SolveContacts};
@@ -0,0 +1,45 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "physics.h"
+
+// the loops over whole arrays, which is where SIMD pays, are built once per instruction set and picked at startup
+// every build has the baseline its compiler targets and a scalar one, x86 builds add an AVX2 variant, see CMakeLists.txt
+// the variants do the same operations in the same order on every element, so a world steps to the same bits on any of them
+
+typedef struct physics_kernels_t
+{
+    const char *name;
+    // values[i] += amount * scales[i]
+    void (*addScaledToArray)(real_t *values, real_t amount, const real_t *scales, int count);
+    // keeps position[i] inside [low + lowExtentScale * extent[i], high - extent[i]], bouncing the velocity of anything that hit a wall
+    // whatever moved past a wall is mirrored back by bounce times the overshoot, which is where it would be had it bounced at its time of impact
+    void (*clampToWalls)(real_t *position, real_t *velocity, const real_t *extent, real_t lowExtentScale, real_t low, real_t high, real_t bounce, int count);
+    // one sequential impulse pass over the contacts from begin to end, which share no bodies
+    void (*solveContacts)(solver_bodies_t *bodies, contacts_list_t *contacts, int begin, int end);
+} physics_kernels_t;
+
+extern const physics_kernels_t physicsKernelsBaseline;
+extern const physics_kernels_t physicsKernelsScalar;
+#ifdef PHYSICS_KERNELS_AVX2
+extern const physics_kernels_t physicsKernelsAvx2;
+#endif
+
+// the fastest variant the processor runs, PHYSICS_KERNELS=baseline or scalar in the environment forces one of those
+const physics_kernels_t *SelectPhysicsKernels(void);
+
+static inline void ApplyContactImpulse(solver_bodies_t *bodies, const contacts_list_t *contacts, int index, int point, real_t impulse)
+{
+    int body1 = contacts->body1[index];
+    int body2 = contacts->body2[index];
+    real_t impulseX = impulse * contacts->normalX[index];
+    real_t impulseY = impulse * contacts->normalY[index];
+    bodies->velocityX[body1] += impulseX * bodies->inverseMass[body1];
+    bodies->velocityY[body1] += impulseY * bodies->inverseMass[body1];
+    bodies->spinningVelocity[body1] += impulse * contacts->armCross1[point][index] * bodies->inverseInertia[body1];
+    bodies->velocityX[body2] -= impulseX * bodies->inverseMass[body2];
+    bodies->velocityY[body2] -= impulseY * bodies->inverseMass[body2];
+    bodies->spinningVelocity[body2] -= impulse * contacts->armCross2[point][index] * bodies->inverseInertia[body2];
+}
+
+#endif
@@ -1,614 +1,483 @@
 #include "raylib.h"
+#include "physics.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "scene.h"
+#include "replay.h"
+#include "scenarios.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
 
 #define DEV_MODE // comment out to remove dev UI
 
-typedef struct V64F_t
-{
-    double x;
-    double y;
-} V64F_t;
-typedef struct shape_t
-{
-    V64F_t position; // center in circle, upper left corner for rects
-    double mass;
-    double radian;
-    V64F_t velocity;
-    double spinningVelocity; // the speed the shape is spinning in radians/frame
-    bool isGrabbed;
-} shape_t;
-
-typedef struct ball_t
-{
-    shape_t base;
-    double radius;
-} ball_t;
-
-typedef struct rect_t
-{
-    shape_t base;
-    V64F_t size;
-} rect_t;
+const int targetFPS = 360;
+// the physics runs at its own rate, frames in between are drawn interpolated
+const real_t physicsStepTime = 1 / (real_t)60;
+const int physicsMaxSubsteps = 8;
+const float minZoom = 0.02f;
+const float maxZoom = 8;
+const float zoomPerWheelStep = 1.1f;
+// level of detail: circles below this radius on screen are a single quad, bigger ones get a segment per few pixels of outline
+const float pointRadiusPixels = 1.5f;
+const float circleSegmentPixels = 6;
+const int minCircleSegments = 6;
+const int maxCircleSegments = 36;
 
-typedef struct balls_list_t
+Vector2 GetVector2FromVReal_t(VReal_t vector)
 {
-    ball_t *balls;
-    int max;
-    int pointer;
-} balls_list_t;
+    return (Vector2){(float)vector.x, (float)vector.y};
+}
 
-typedef struct rects_list_t
+void SetMouseShapeOffset(VReal_t *mouseShapeOffset, Vector2 mousePos, VReal_t shapePos)
 {
-    rect_t *rects;
-    int max;
-    int pointer;
-} rects_list_t;
-
-const int screenWidth = 1280;
-const int screenHeight = 720;
-const int targetFPS = 360;
-const int listStartMax = 16;
-
-const double deltaFrameTime = 1 / (float)targetFPS;
-const double gravity = 9.82 * 0;
-const double mapBoundraryCollisionBouce = 1; // 1 means no force is lost upon wall collision (elastic), everything above 1 will cause a increase in force for every collision
-// 1000 units tolerance for the velocity, if it goes beyound that it's possible for the shapes to go out of bounds
-// NOTE! the corners don't have this tolerance as of now, might fix that later
-const Rectangle mapBoundraryUpper = {0, -1000, screenWidth, 1000};
-const Rectangle mapBoundraryLower = {0, screenHeight, screenWidth, 1000};
-const Rectangle mapBoundraryLeft = {-1000, 0, 1000, screenHeight};
-const Rectangle mapBoundraryRight = {screenWidth, 0, 1000, screenHeight};
+    mouseShapeOffset->x = shapePos.x - mousePos.x;
+    mouseShapeOffset->y = shapePos.y - mousePos.y;
+}
 
-void AddBall(balls_list_t *balls, ball_t newBall)
+// the mouse in world coordinates
+Vector2 GetMouseWorldPosition(Camera2D camera)
 {
-    balls->balls[balls->pointer] = newBall;
-    balls->pointer += 1;
+    return GetScreenToWorld2D(GetMousePosition(), camera);
 }
 
-void IncreaseBallsListSize(balls_list_t *balls)
+// the part of the world the window shows
+bounds_t GetCameraView(Camera2D camera)
 {
-    balls->max *= 2;
-    balls->balls = realloc(balls->balls, sizeof(ball_t) * balls->max);
+    Vector2 min = GetScreenToWorld2D((Vector2){0, 0}, camera);
+    Vector2 max = GetScreenToWorld2D((Vector2){(float)GetScreenWidth(), (float)GetScreenHeight()}, camera);
+    return (bounds_t){min.x, min.y, max.x, max.y};
 }
 
-void HandleAddingBallToList(balls_list_t *balls, ball_t newBall)
+// middle mouse drags the view around, the wheel zooms in and out around the mouse
+void UpdateViewCamera(Camera2D *camera)
 {
-    if (balls->pointer >= balls->max)
+    if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE))
     {
-        IncreaseBallsListSize(balls);
+        Vector2 delta = GetMouseDelta();
+        camera->target.x -= delta.x / camera->zoom;
+        camera->target.y -= delta.y / camera->zoom;
+    }
+    float wheel = GetMouseWheelMove();
+    if (wheel != 0)
+    {
+        // the point under the mouse stays where it is
+        camera->target = GetMouseWorldPosition(*camera);
+        camera->offset = GetMousePosition();
+        camera->zoom = fminf(fmaxf(camera->zoom * powf(zoomPerWheelStep, wheel), minZoom), maxZoom);
     }
-    AddBall(balls, newBall);
 }
 
-void AddRect(rects_list_t *rects, rect_t newRect)
+shapes_t *GetBodyShapes(world_t *world, body_handle_t body)
 {
-    rects->rects[rects->pointer] = newRect;
-    rects->pointer += 1;
+    return body.kind == BODY_BALL ? &world->balls.base : &world->rects.base;
 }
 
-void IncreaseRectsListSize(rects_list_t *rects)
+typedef struct mouse_drag_t
 {
-    rects->max *= 2;
-    rects->rects = realloc(rects->rects, sizeof(rect_t) * rects->max);
-}
+    body_handle_t body; // zeroed while no shape is grabbed, a grabbed shape that gets removed lets go by itself
+    VReal_t offset;
+    VReal_t target; // the mouse in world coordinates as of the last frame
+} mouse_drag_t;
 
-void HandleAddingRectToList(rects_list_t *rects, rect_t newRect)
+// runs before every physics step so the grabbed shape follows the mouse at any frame rate
+void DragBeforeStep(void *context, world_t *world, real_t deltaTime)
 {
-    if (rects->pointer >= rects->max)
-    {
-        IncreaseRectsListSize(rects);
-    }
-    AddRect(rects, newRect);
+    mouse_drag_t *drag = context;
+    WorldDragBody(world, drag->body, (VReal_t){drag->target.x + drag->offset.x, drag->target.y + drag->offset.y}, deltaTime);
 }
 
-Vector2 GetVector2FromV64F_t(V64F_t v64)
+// the shape under the mouse, a zeroed handle if there is none
+body_handle_t GetShapeAt(Vector2 mousePos, world_t *world)
 {
-    return (Vector2){(float)v64.x, (float)v64.y};
+    body_handle_t body = {0};
+    WorldQueryPoint(world, (VReal_t){mousePos.x, mousePos.y}, &body, 1);
+    return body;
 }
 
-Rectangle GetRectangleFromRect_t(rect_t rect)
+// grabs shape with mouse
+body_handle_t GrabShape(Vector2 mousePos, world_t *world, VReal_t *mouseShapeOffset)
 {
-    return (Rectangle){rect.base.position.x, rect.base.position.y, rect.size.x, rect.size.y};
+    body_handle_t body = GetShapeAt(mousePos, world);
+    int index = WorldGetBodyIndex(world, body);
+    if (index >= 0)
+    {
+        shapes_t *shapes = GetBodyShapes(world, body);
+        SetMouseShapeOffset(mouseShapeOffset, mousePos, (VReal_t){shapes->positionX[index], shapes->positionY[index]});
+    }
+    return body;
 }
 
-void SetMouseShapeOffset(V64F_t *mouseShapeOffset, Vector2 mousePos, V64F_t shapePos)
+// radius and zoom pick the level of detail, a circle is never drawn with more segments than its outline has pixels for
+void DrawBall(Vector2 center, float radius, float zoom)
 {
-    mouseShapeOffset->x = shapePos.x - mousePos.x;
-    mouseShapeOffset->y = shapePos.y - mousePos.y;
+    float screenRadius = radius * zoom;
+    if (screenRadius < pointRadiusPixels)
+    {
+        DrawRectangleV((Vector2){center.x - radius, center.y - radius}, (Vector2){2 * radius, 2 * radius}, RED);
+        return;
+    }
+    int segments = (int)(2 * PI * screenRadius / circleSegmentPixels);
+    segments = segments < minCircleSegments ? minCircleSegments : segments > maxCircleSegments ? maxCircleSegments : segments;
+    DrawCircleSector(center, radius, 0, 360, segments, RED);
 }
 
-void MoveShapeBasedOnMousePosition(V64F_t *shapePos, V64F_t *shapeVelocity, V64F_t mouseShapeOffset)
+// position is the upper left corner before turning, like the physics keeps it
+void DrawRect(Vector2 position, Vector2 size, float radian, float zoom)
 {
-    double posX = GetMousePosition().x + mouseShapeOffset.x;
-    double posY = GetMousePosition().y + mouseShapeOffset.y;
-#ifdef DEV_MODE
-    printf("new posX: %.2f - new posY: %.2f\n"
-           "shapePosX: %.2f - shapePosY: %.2f\n",
-           posX, posY,
-           shapePos->x, shapePos->y);
-    printf("velY: %.2f, velX: %.2f\n",
-           shapeVelocity->y, shapeVelocity->x);
-#endif
-    shapeVelocity->x = (posX - shapePos->x);
-    shapeVelocity->y = (posY - shapePos->y);
+    // turning something smaller than a pixel doesn't show
+    if (size.x * zoom < 1 && size.y * zoom < 1)
+    {
+        DrawRectangleV(position, size, YELLOW);
+        return;
+    }
+    // DrawRectanglePro turns around the origin, so the rect is drawn from its center like the physics turns it
+    Rectangle rect = {position.x + size.x / 2, position.y + size.y / 2, size.x, size.y};
+    DrawRectanglePro(rect, (Vector2){size.x / 2, size.y / 2}, radian * RAD2DEG, YELLOW);
 }
 
-// grabs shape with mouse
-int GrabShape(Vector2 mousePos, balls_list_t *balls, rects_list_t *rects, V64F_t *mouseShapeOffset)
+// raylib batches consecutive draws that share a texture and primitive into one draw call,
+// so the visible balls go first and the rects after them, each a single run
+// without a scheduler the shapes are drawn where they are
+void DrawVisible(const world_t *world, const scheduler_t *scheduler, const view_list_t *visible, float zoom)
 {
-    for (int i = 0; i < balls->pointer; i++)
+    const balls_list_t *balls = &world->balls;
+    for (int i = 0; i < visible->ballsCount; i++)
     {
-        if (CheckCollisionPointCircle(mousePos, GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius))
+        int index = visible->balls[i];
+        VReal_t position = {balls->base.positionX[index], balls->base.positionY[index]};
+        if (scheduler != NULL)
         {
-            SetMouseShapeOffset(mouseShapeOffset, mousePos, balls->balls[i].base.position);
-            return i;
+            position = GetInterpolatedBallPosition(scheduler, world, index);
         }
+        DrawBall(GetVector2FromVReal_t(position), balls->radius[index], zoom);
     }
-    for (int i = 0; i < rects->pointer; i++)
+    const rects_list_t *rects = &world->rects;
+    for (int i = 0; i < visible->rectsCount; i++)
     {
-        if (CheckCollisionPointRec(mousePos, GetRectangleFromRect_t(rects->rects[i])))
+        int index = visible->rects[i];
+        VReal_t position = {rects->base.positionX[index], rects->base.positionY[index]};
+        real_t radian = rects->base.radian[index];
+        if (scheduler != NULL)
         {
-            SetMouseShapeOffset(mouseShapeOffset, mousePos, rects->rects[i].base.position);
-            return i + balls->pointer;
+            position = GetInterpolatedRectPosition(scheduler, world, index);
+            radian = GetInterpolatedRectRadian(scheduler, world, index);
         }
+        DrawRect(GetVector2FromVReal_t(position), (Vector2){rects->sizeX[index], rects->sizeY[index]}, radian, zoom);
     }
-    return -1;
 }
 
-void Gravity(balls_list_t *balls, rects_list_t *rects)
+void DrawMapBounds(bounds_t map, float zoom)
 {
-    for (int i = 0; i < balls->pointer; i++)
-    {
-        balls->balls[i].base.velocity.y += gravity * deltaFrameTime;
-    }
-    for (int i = 0; i < rects->pointer; i++)
-    {
-        rects->rects[i].base.velocity.y += gravity * deltaFrameTime;
-    }
-}
-
-void MoveShapeWithVelocity(V64F_t *position, V64F_t velocity)
-{
-    position->x += velocity.x;
-    position->y += velocity.y;
+    DrawRectangleLinesEx((Rectangle){map.minX, map.minY, map.maxX - map.minX, map.maxY - map.minY}, 2 / zoom, DARKGRAY);
 }
 
-void MoveShapes(balls_list_t *balls, rects_list_t *rects)
+// p50/p99 over the last PROFILE_WINDOW frames for every phase and counter
+void DrawProfileOverlay(const profile_t *profile, int posX, int posY)
 {
-    // TODO add spinning of shapes
-    for (int i = 0; i < balls->pointer; i++)
+    const int fontSize = 20;
+    DrawText("phase          p50 us     p99 us", posX, posY, fontSize, DARKGREEN);
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
     {
-        MoveShapeWithVelocity(&balls->balls[i].base.position, balls->balls[i].base.velocity);
+        posY += fontSize + 2;
+        DrawText(TextFormat("%-12s %9.1f %9.1f", GetProfilePhaseName(i),
+                            GetProfilePercentile(&profile->phases[i], 0.5), GetProfilePercentile(&profile->phases[i], 0.99)),
+                 posX, posY, fontSize, DARKGREEN);
     }
-    for (int i = 0; i < rects->pointer; i++)
+    posY += 2 * (fontSize + 2);
+    DrawText("per step          p50        p99", posX, posY, fontSize, PURPLE);
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
     {
-        MoveShapeWithVelocity(&rects->rects[i].base.position, rects->rects[i].base.velocity);
-        rects->rects[i].base.radian += rects->rects[i].base.spinningVelocity;
+        posY += fontSize + 2;
+        DrawText(TextFormat("%-12s %9.0f %9.0f", GetProfileCounterName(i),
+                            GetProfilePercentile(&profile->counters[i], 0.5), GetProfilePercentile(&profile->counters[i], 0.99)),
+                 posX, posY, fontSize, PURPLE);
     }
 }
 
-// 1 = bigger, -1 = smaller, 0 = equal
-V64F_t GetShapesOffset(V64F_t shape1, V64F_t shape2)
+// shows a recording instead of simulating, space pauses, left and right seek by a second and home goes back to the start
+void PlayReplay(world_t *world, replay_t *replay, Camera2D camera)
 {
-    V64F_t offset = {0, 0};
-    if (shape1.x > shape2.x)
-    {
-        offset.x = 1;
-    }
-    else if (shape1.x < shape2.x)
+    long long frames = GetReplayFrames(replay);
+    long long frame = 0;
+    bool paused = false;
+    view_list_t visible = {0};
+    while (!WindowShouldClose())
     {
-        offset.x = -1;
-    }
+        UpdateViewCamera(&camera);
+        paused = IsKeyPressed(KEY_SPACE) ? !paused : paused;
+        frame += IsKeyPressed(KEY_RIGHT) ? targetFPS : 0;
+        frame -= IsKeyPressed(KEY_LEFT) ? targetFPS : 0;
+        frame = IsKeyPressed(KEY_HOME) ? 0 : frame;
+        frame = frame < frames ? frame : frames - 1;
+        frame = frame > 0 ? frame : 0;
+        ReplaySeek(replay, world, frame);
+        WorldQueryView(world, GetCameraView(camera), &visible);
 
-    if (shape1.y > shape2.y)
-    {
-        offset.y = 1;
-    }
-    else if (shape1.y < shape2.y)
-    {
-        offset.y = -1;
+        BeginDrawing();
+        ClearBackground(LIGHTGRAY);
+        BeginMode2D(camera);
+        DrawVisible(world, NULL, &visible, camera.zoom);
+        DrawMapBounds(world->mapBounds, camera.zoom);
+        EndMode2D();
+        DrawText(TextFormat("frame %lld / %lld%s", frame, frames, paused ? " - paused" : ""), 20, 20, 20, DARKGREEN);
+        EndDrawing();
+        frame += paused ? 0 : 1;
     }
-    return offset;
+    FreeViewList(&visible);
 }
 
-float GetRadianBetweenShapes(V64F_t shape1Pos, V64F_t shape2Pos)
+real_t GetBlended(const real_t *previous, const real_t *current, int index, real_t alpha)
 {
+    return previous[index] + (current[index] - previous[index]) * alpha;
+}
 
-    float dX = fabs(shape1Pos.x - shape2Pos.x);
-    float dY = fabs(shape1Pos.y - shape2Pos.y);
-
-    double atanRadian = atan(dX / dY);
-    float radian = 0;
-    V64F_t ballsOffset = GetShapesOffset(shape1Pos, shape2Pos);
-    if (ballsOffset.x <= 0 && ballsOffset.y >= 0)
-    {
-        radian = atanRadian;
-    }
-    // bottom right
-    else if (ballsOffset.x <= 0 && ballsOffset.y <= 0)
-    {
-        radian = PI - atanRadian;
-    }
-    // bottom left
-    else if (ballsOffset.x >= 0 && ballsOffset.y <= 0)
+// the physics thread already left out what is far from the view
+void DrawSnapshot(const render_snapshot_t *snapshot, real_t alpha, float zoom)
+{
+    const snapshot_shapes_t *balls = &snapshot->balls;
+    for (int i = 0; i < balls->count; i++)
     {
-        radian = PI + atanRadian;
+        Vector2 position = {GetBlended(balls->previousX, balls->positionX, i, alpha), GetBlended(balls->previousY, balls->positionY, i, alpha)};
+        DrawBall(position, balls->sizeX[i], zoom);
     }
-    // top left
-    else
+    const snapshot_shapes_t *rects = &snapshot->rects;
+    for (int i = 0; i < rects->count; i++)
     {
-        radian = (2 * PI) - atanRadian;
+        Vector2 position = {GetBlended(rects->previousX, rects->positionX, i, alpha), GetBlended(rects->previousY, rects->positionY, i, alpha)};
+        DrawRect(position, (Vector2){rects->sizeX[i], rects->sizeY[i]}, GetBlended(rects->previousRadian, rects->radian, i, alpha), zoom);
     }
-    return radian;
-}
-
-void HandleRectBallCollision(balls_list_t *balls, rects_list_t *rects)
-{
+    DrawMapBounds(snapshot->mapBounds, zoom);
 }
 
-void CalculateChangeInAngularVelocities(rect_t *rect1, rect_t *rect2, float velocityRelativeMagnitude)
-{
-    float I1 = (rect1->size.y * rect1->size.y + rect1->size.x * rect1->size.x) / 12;
-    float I2 = (rect2->size.y * rect2->size.y + rect2->size.x * rect2->size.x) / 12;
-    rect1->base.spinningVelocity -= velocityRelativeMagnitude * rect2->base.mass * (I1 + I2) / (I1 * I2);
-    rect2->base.spinningVelocity += velocityRelativeMagnitude * rect1->base.mass * (I1 + I2) / (I1 * I2);
-}
-V64F_t GetRectCenter(rect_t rect)
+// the particle scenario, stepped at the physics rate on every processor and drawn without interpolation
+// particles are too many to pick up one by one, the mouse only moves the view
+void PlayParticles(int count, Camera2D camera)
 {
-    return (V64F_t){rect.base.position.x + (rect.size.x / 2), rect.base.position.y + (rect.size.y / 2)};
-}
-void CalculateRectRectCollisionVelocities(rect_t *rect1, rect_t *rect2, float velocityRelativeMagnitude, float radian, float restitution)
-{
-    double impulse = 2 * rect1->base.mass * rect2->base.mass * velocityRelativeMagnitude / (rect1->base.mass + rect2->base.mass);
-    V64F_t impulseVector = {impulse * cos(radian), impulse * sin(radian)};
-#ifdef DEV_MODE
-    printf("rects collision radian: %.2f\n", radian);
-    printf("impulse: %.2f - impulse vector x val: %.2f - impulse vector y val: %.2f\n", impulse, impulseVector.x, impulseVector.y);
-    printf("radian: %.2f - cos val: %.2f - sin val: %.2f\n", radian, cos(radian), sin(radian));
-#endif
-    rect1->base.velocity.x = ((rect1->base.mass - rect2->base.mass) * rect1->base.velocity.x + 2 * rect2->base.mass * rect2->base.velocity.x +
-                              rect2->base.mass * (cos(rect1->base.radian - rect2->base.radian) * (rect1->base.velocity.x - rect2->base.velocity.x) +
-                                                  sin(rect1->base.radian - rect2->base.radian) * (rect1->base.velocity.y - rect2->base.velocity.y))) /
-                             (rect1->base.mass + rect2->base.mass);
-
-    rect1->base.velocity.y = ((rect1->base.mass - rect2->base.mass) * rect1->base.velocity.y + 2 * rect2->base.mass * rect2->base.velocity.y +
-                              rect2->base.mass * (cos(rect1->base.radian - rect2->base.radian) * (rect1->base.velocity.y - rect2->base.velocity.y) +
-                                                  sin(rect1->base.radian - rect2->base.radian) * (rect1->base.velocity.x - rect2->base.velocity.x))) /
-                             (rect1->base.mass + rect2->base.mass);
-
-    rect2->base.velocity.x = ((rect2->base.mass - rect1->base.mass) * rect2->base.velocity.x + 2 * rect1->base.mass * rect1->base.velocity.x +
-                              rect1->base.mass * (cos(rect1->base.radian - rect2->base.radian) * (rect2->base.velocity.x - rect1->base.velocity.x) +
-                                                  sin(rect1->base.radian - rect2->base.radian) * (rect2->base.velocity.y - rect1->base.velocity.y))) /
-                             (rect1->base.mass + rect2->base.mass);
-
-    rect2->base.velocity.y = ((rect2->base.mass - rect1->base.mass) * rect2->base.velocity.y + 2 * rect1->base.mass * rect1->base.velocity.y +
-                              rect1->base.mass * (cos(rect1->base.radian - rect2->base.radian) * (rect2->base.velocity.y - rect1->base.velocity.y) +
-                                                  sin(rect1->base.radian - rect2->base.radian) * (rect2->base.velocity.x - rect1->base.velocity.x))) /
-                             (rect1->base.mass + rect2->base.mass);
-
-    // rect1->base.velocity.y = rect1->base.velocity.y + (impulseVector.x / rect1->base.mass) * restitution;
-    // rect1->base.velocity.x = rect1->base.velocity.x - (impulseVector.y / rect1->base.mass) * restitution;
-    // rect2->base.velocity.y = rect2->base.velocity.y - (impulseVector.x / rect2->base.mass) * restitution;
-    // rect2->base.velocity.x = rect2->base.velocity.x + (impulseVector.y / rect2->base.mass) * restitution;
-    printf("rect 1 velocity x:y - %.2f:%.2f\n"
-           "rect 2 velocity x:y - %.2f:%.2f\n",
-           rect1->base.velocity.x, rect1->base.velocity.y,
-           rect2->base.velocity.x, rect2->base.velocity.y);
-}
-
-void MoveRectsApart(rect_t *rect1, rect_t *rect2, float radian)
-{
-    V64F_t centerRect1 = GetRectCenter(*rect1);
-    V64F_t centerRect2 = GetRectCenter(*rect2);
-    V64F_t collisionNormal = {centerRect2.x - centerRect1.x, centerRect2.y - centerRect1.y};
-    float distanceBetweenRectCenters = sqrt(collisionNormal.x * collisionNormal.x + collisionNormal.y * collisionNormal.y);
-    // float unitX = collisionNormal.x / distanceBetweenRectCenters;
-    // float unitY = collisionNormal.y / distanceBetweenRectCenters;
-    // collisionNormal.x /= distanceBetweenRectCenters;
-    // collisionNormal.y /= distanceBetweenRectCenters;
-
-    double overlapX = ((rect1->size.x / 2) + (rect2->size.x / 2)) - fabs(collisionNormal.x);
-    double overlapY = ((rect1->size.y / 2) + (rect2->size.y / 2)) - fabs(collisionNormal.y);
-
-    // rect1->base.position.x -= (overlapX * unitX / 2);
-    // rect1->base.position.y -= (overlapY * unitY / 2);
-    // rect2->base.position.x += (overlapX * unitX / 2);
-    // rect2->base.position.y += (overlapY * unitY / 2);
-    if (fabs(radian - PI) >= PI / 4 && fabs(radian - PI) < 3 * PI / 4) // are they left/right to each other on the unit circle
+    particles_t *particles = CreateParticleScenario(count, 1);
+    if (particles == NULL)
     {
-        if (collisionNormal.x < 0)
-        {
-            rect1->base.position.x += overlapX / 2;
-            rect2->base.position.x -= overlapX / 2;
-        }
-        else
-        {
-            rect1->base.position.x -= overlapX / 2;
-            rect2->base.position.x += overlapX / 2;
-        }
+        fprintf(stderr, "can't make %d particles\n", count);
+        return;
     }
-    else
+    ParticlesSetThreads(particles, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    bounds_t map = particles->mapBounds;
+    camera.zoom = fminf(fmaxf(screenWidth / (float)(map.maxX - map.minX), minZoom), maxZoom);
+    camera.target = (Vector2){(float)map.minX, (float)(map.maxY - screenHeight / camera.zoom)};
+    float radius = particles->radius;
+    double accumulator = 0;
+    while (!WindowShouldClose())
     {
-        if (collisionNormal.y < 0)
-        {
-            rect1->base.position.y += overlapY / 2;
-            rect2->base.position.y -= overlapY / 2;
-        }
-        else
+        UpdateViewCamera(&camera);
+        accumulator += GetFrameTime();
+        int steps = 0;
+        double stepStart = GetTime();
+        for (; accumulator >= physicsStepTime && steps < physicsMaxSubsteps; steps++)
         {
-            rect1->base.position.y -= overlapY / 2;
-            rect2->base.position.y += overlapY / 2;
+            ParticlesStep(particles, (float)physicsStepTime);
+            accumulator -= physicsStepTime;
         }
-    }
-}
+        // a step slower than real time drops what it can't catch up on instead of spiralling
+        accumulator = steps < physicsMaxSubsteps ? accumulator : 0;
+        double stepMs = (GetTime() - stepStart) * 1000;
 
-void CalculateCollisionRectRect(rect_t *rect1, rect_t *rect2)
-{
-    // calculate necessary data
-    double radian = GetRadianBetweenShapes(rect1->base.position, rect2->base.position);
-    double vrelX = rect1->base.velocity.x - rect2->base.velocity.x;
-    double vrelY = rect1->base.velocity.y - rect2->base.velocity.y;
-    double velocityRelativeMagnitude = sqrt(vrelX * vrelX + vrelY * vrelY);
-    double velMagRect1 = sqrt(rect1->base.velocity.x * rect1->base.velocity.x + rect1->base.velocity.y * rect1->base.velocity.y);
-    double velMagRect2 = sqrt(rect2->base.velocity.x * rect2->base.velocity.x + rect2->base.velocity.y * rect2->base.velocity.y);
-    MoveRectsApart(rect1, rect2, radian);
-    CalculateRectRectCollisionVelocities(rect1, rect2, velocityRelativeMagnitude, radian, 0.6); // 1 for elastic collision
-    CalculateChangeInAngularVelocities(rect1, rect2, velocityRelativeMagnitude);
-}
-
-void HandleRectRectCollision(rects_list_t *rects)
-{
-    for (int i = 0; i < rects->pointer - 1; i++)
-    {
-        for (int j = i + 1; j < rects->pointer; j++)
+        bounds_t view = GetCameraView(camera);
+        int visible = 0;
+        BeginDrawing();
+        ClearBackground(LIGHTGRAY);
+        BeginMode2D(camera);
+        for (int i = 0; i < particles->count; i++)
         {
-            if (CheckCollisionRecs(GetRectangleFromRect_t(rects->rects[i]), GetRectangleFromRect_t(rects->rects[j])))
+            float x = particles->positionX[i];
+            float y = particles->positionY[i];
+            if (x + radius < view.minX || x - radius > view.maxX || y + radius < view.minY || y - radius > view.maxY)
             {
-                CalculateCollisionRectRect(&rects->rects[i], &rects->rects[j]);
+                continue;
             }
+            DrawBall((Vector2){x, y}, radius, camera.zoom);
+            visible++;
         }
+        DrawMapBounds(map, camera.zoom);
+        EndMode2D();
+#ifdef DEV_MODE
+        DrawText(TextFormat("particles %d visible %d steps %d %.1f ms rebuilds %lld", particles->count, visible, steps, stepMs, particles->stats.rebuilds),
+                 20, 20, 20, DARKGREEN);
+#endif
+        EndDrawing();
     }
+    ParticlesDestroy(particles);
 }
 
-void HandleBallsCollisionVelocityChange(ball_t *ball1, ball_t *ball2, V64F_t normalVector, V64F_t tangentVector, float distanceBetweenBalls)
-{
-    double unitX = normalVector.x / distanceBetweenBalls;
-    double unitY = normalVector.y / distanceBetweenBalls;
-
-    double impulse = 2 * ball1->base.mass * ball2->base.mass *
-                    (ball1->base.velocity.x * unitX + ball1->base.velocity.y * unitY -
-                     (ball2->base.velocity.x * unitX + ball2->base.velocity.y * unitY)) /
-                    (ball1->base.mass + ball2->base.mass);
-
-    ball1->base.velocity.x -= impulse * unitX / ball1->base.mass;
-    ball1->base.velocity.y -= impulse * unitY / ball1->base.mass;
-    ball2->base.velocity.x += impulse * unitX / ball2->base.mass;
-    ball2->base.velocity.y += impulse * unitY / ball2->base.mass;
-}
-
-void PushBallsApart(ball_t *ball1, ball_t *ball2, V64F_t normalVector, float distanceBetweenBalls)
+// the physics runs on its own thread and this one only draws its snapshots and sends it the input
+void RunPipelined(world_t *world, const world_snapshot_t *startSnapshot, Camera2D camera)
 {
-    // get data needed
-    // float radianBetweenBalls = GetRadianBetweenBalls(ball1, ball2);
-    float intersectLength = ball1->radius + ball2->radius - distanceBetweenBalls;
-    float unitX = normalVector.x / distanceBetweenBalls;
-    float unitY = normalVector.y / distanceBetweenBalls;
-    // move balls apart
-    ball1->base.position.x += unitX * intersectLength / 2;
-    ball1->base.position.y += unitY * intersectLength / 2;
-
-    ball2->base.position.x -= unitX * intersectLength / 2;
-    ball2->base.position.y -= unitY * intersectLength / 2;
-}
-
-V64F_t GetNormalVector(V64F_t ball1, V64F_t ball2)
-{
-    return (V64F_t){ball1.x - ball2.x, ball1.y - ball2.y};
-}
-
-void CalculateCollisionBallBall(ball_t *ball1, ball_t *ball2)
-{
-    V64F_t normalVector = GetNormalVector(ball1->base.position, ball2->base.position);
-    V64F_t tangentVector = (V64F_t){-normalVector.y, normalVector.x};
-    float distanceBetweenBalls = sqrt(normalVector.x * normalVector.x + normalVector.y * normalVector.y);
-
-    PushBallsApart(ball1, ball2, normalVector, distanceBetweenBalls);
-    HandleBallsCollisionVelocityChange(ball1, ball2, normalVector, tangentVector, distanceBetweenBalls);
-}
-
-void HandleBallBallCollision(balls_list_t *balls)
-{
-    for (int i = 0; i < balls->pointer - 1; i++)
+    pipeline_t *pipeline = PipelineStart(world, physicsStepTime, physicsMaxSubsteps, startSnapshot);
+    if (pipeline == NULL)
     {
-        for (int j = i + 1; j < balls->pointer; j++)
-        {
-            if (CheckCollisionCircles(GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius, GetVector2FromV64F_t(balls->balls[j].base.position), balls->balls[j].radius))
-            {
-                CalculateCollisionBallBall(&balls->balls[i], &balls->balls[j]);
-            }
-        }
+        fprintf(stderr, "can't start the physics thread\n");
+        return;
     }
-}
-
-void HandleCollision(balls_list_t *balls, rects_list_t *rects)
-{
-    HandleBallBallCollision(balls);
-    HandleRectRectCollision(rects);
-}
-
-void HandleMapWallCollision(balls_list_t *balls, rects_list_t *rects)
-{
-    for (int i = 0; i < balls->pointer; i++)
+    while (!WindowShouldClose())
     {
-        if (CheckCollisionCircleRec(GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius, mapBoundraryUpper))
+        UpdateViewCamera(&camera);
+        Vector2 mouseWorld = GetMouseWorldPosition(camera);
+        VReal_t mousePos = {mouseWorld.x, mouseWorld.y};
+        PipelineSend(pipeline, (input_command_t){.kind = INPUT_VIEW, .position = mousePos, .view = GetCameraView(camera)});
+        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
         {
-            balls->balls[i].base.velocity.y *= -mapBoundraryCollisionBouce;
-            balls->balls[i].base.position.y = 0 + balls->balls[i].radius; // makes sure that the circle cannot go inside the map boundrary
+            PipelineSend(pipeline, (input_command_t){.kind = INPUT_MOUSE_DOWN, .position = mousePos});
         }
-        else if (CheckCollisionCircleRec(GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius, mapBoundraryLower))
+        if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT))
         {
-            balls->balls[i].base.velocity.y *= -mapBoundraryCollisionBouce;
-            balls->balls[i].base.position.y = screenHeight - balls->balls[i].radius; // makes sure that the circle cannot go inside the map boundrary
+            PipelineSend(pipeline, (input_command_t){.kind = INPUT_MOUSE_UP, .position = mousePos});
         }
-        if (CheckCollisionCircleRec(GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius, mapBoundraryLeft))
+        if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
         {
-            balls->balls[i].base.velocity.x *= -mapBoundraryCollisionBouce;
-            balls->balls[i].base.position.x = 0 + balls->balls[i].radius; // makes sure that the circle cannot go inside the map boundrary
+            PipelineSend(pipeline, (input_command_t){.kind = INPUT_REMOVE, .position = mousePos});
         }
-        else if (CheckCollisionCircleRec(GetVector2FromV64F_t(balls->balls[i].base.position), balls->balls[i].radius, mapBoundraryRight))
+        if (IsKeyPressed(KEY_R))
         {
-            balls->balls[i].base.velocity.x *= -mapBoundraryCollisionBouce;
-            balls->balls[i].base.position.x = screenWidth - balls->balls[i].radius; // makes sure that the circle cannot go inside the map boundrary
+            PipelineSend(pipeline, (input_command_t){.kind = INPUT_RESTORE, .position = mousePos});
         }
+
+        const render_snapshot_t *snapshot = PipelineAcquire(pipeline);
+        BeginDrawing();
+        ClearBackground(LIGHTGRAY);
+        BeginMode2D(camera);
+        DrawSnapshot(snapshot, GetSnapshotAlpha(snapshot, GetPipelineSeconds()), camera.zoom);
+        EndMode2D();
+#ifdef DEV_MODE
+        // the profile belongs to the physics thread, only what the snapshot carries is shown
+        DrawText(TextFormat("steps %lld substeps %d awake %d", snapshot->steps, snapshot->substeps, snapshot->awakeBodies), 20, 20, 20, DARKGREEN);
+#endif
+        EndDrawing();
     }
-    for (int i = 0; i < rects->pointer; i++)
-    {
-        if (CheckCollisionRecs(GetRectangleFromRect_t(rects->rects[i]), mapBoundraryUpper))
-        {
-            rects->rects[i].base.velocity.y *= -1;
-            rects->rects[i].base.position.y = 0;
+    PipelineStop(pipeline);
+}
 
-            // rect_t tempMapBoundraryUpper = (rect_t){(shape_t){(V64F_t){mapBoundraryUpper.x, mapBoundraryUpper.y}, 1000, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){mapBoundraryUpper.width, mapBoundraryUpper.height}};
-            // CalculateCollisionRectRect(&rects->rects[i], &tempMapBoundraryUpper);
-        }
-        else if (CheckCollisionRecs(GetRectangleFromRect_t(rects->rects[i]), mapBoundraryLower))
-        {
-            rects->rects[i].base.velocity.y *= -1;
-            rects->rects[i].base.position.y = screenHeight - rects->rects[i].size.y;
-            // rect_t tempMapBoundraryLower = (rect_t){(shape_t){(V64F_t){mapBoundraryLower.x, mapBoundraryLower.y}, 1000, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){mapBoundraryLower.width, mapBoundraryLower.height}};
-            // CalculateCollisionRectRect(&rects->rects[i], &tempMapBoundraryLower);
-        }
-        if (CheckCollisionRecs(GetRectangleFromRect_t(rects->rects[i]), mapBoundraryLeft))
-        {
-            rects->rects[i].base.velocity.x *= -1;
-            rects->rects[i].base.position.x = 0;
+// usage: game [--pipelined] [SCENE_FILE] | game --replay FILE | game --particles N, without a file the default scene is used
+// --pipelined steps the physics on its own thread while this one draws, --particles drops N particles into a pile
+// the middle mouse button pans and the wheel zooms, maps can be far bigger than the window
+// with PHYSICS_TRACE=FILE set a dev build traces input and sleeping into FILE
+int main(int argc, char **argv)
+{
+    InitWindow(screenWidth, screenHeight, "physics engine");
+    SetTargetFPS(targetFPS);
+    mouse_drag_t drag = {0};
+    world_t *world = WorldCreate();
+    Camera2D camera = {{0, 0}, {0, 0}, 0, 1};
+    view_list_t visible = {0};
 
-            // rect_t tempMapBoundraryLeft = (rect_t){(shape_t){(V64F_t){mapBoundraryLeft.x, mapBoundraryLeft.y}, 1000, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){mapBoundraryLeft.width, mapBoundraryLeft.height}};
-            // CalculateCollisionRectRect(&rects->rects[i], &tempMapBoundraryLeft);
+    if (argc == 3 && strcmp(argv[1], "--replay") == 0)
+    {
+        replay_t *replay = ReplayOpen(argv[2]);
+        bool opened = replay != NULL;
+        if (opened)
+        {
+            PlayReplay(world, replay, camera);
+            ReplayClose(replay);
         }
-        else if (CheckCollisionRecs(GetRectangleFromRect_t(rects->rects[i]), mapBoundraryRight))
+        else
         {
-            rects->rects[i].base.velocity.x *= -1;
-            rects->rects[i].base.position.x = screenWidth - rects->rects[i].size.x;
-            // rect_t tempMapBoundraryRight = (rect_t){(shape_t){(V64F_t){mapBoundraryRight.x, mapBoundraryRight.y}, 1000, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){mapBoundraryRight.width, mapBoundraryRight.height}};
-            // CalculateCollisionRectRect(&rects->rects[i], &tempMapBoundraryRight);
+            fprintf(stderr, "%s: can't open replay\n", argv[2]);
         }
+        WorldDestroy(world);
+        CloseWindow();
+        return opened ? 0 : 1;
     }
-}
-
-void DrawRects(rects_list_t rects)
-{
-    for (int i = 0; i < rects.pointer; i++)
+    if (argc == 3 && strcmp(argv[1], "--particles") == 0)
     {
-
-        Rectangle rect = GetRectangleFromRect_t(rects.rects[i]);
-        // due to how DrawRectanglePro works, this is needed for collision to work correctly
-        DrawRectangleRec(rect, YELLOW);
-        rect.x += rect.width / 2;
-        rect.y += rect.height / 2;
-        //DrawRectanglePro(rect, (Vector2){rects.rects[i].size.x / 2, rects.rects[i].size.y / 2}, rects.rects[i].base.radian, BLUE);
+        PlayParticles(atoi(argv[2]), camera);
+        WorldDestroy(world);
+        CloseWindow();
+        return 0;
     }
-}
+    bool pipelined = argc >= 2 && strcmp(argv[1], "--pipelined") == 0;
+    const char *scenePath = argc >= 2 + pipelined ? argv[1 + pipelined] : NULL;
+    if (scenePath == NULL || !WorldLoad(world, scenePath))
+    {
+        WorldAddBall(world, (ball_t){(shape_t){(VReal_t){screenWidth / 2, screenHeight / 2}, 10, 0, (VReal_t){0, 0}, 0, false}, 50});
+        WorldAddBall(world, (ball_t){(shape_t){(VReal_t){screenWidth / 4, screenHeight / 4}, 10, 0, (VReal_t){0, 0}, 0, false}, 50});
+        WorldAddBall(world, (ball_t){(shape_t){(VReal_t){3 * screenWidth / 4, 3 * screenHeight / 4}, 10, 0, (VReal_t){0, 0}, 0, false}, 50});
 
-void DrawBalls(balls_list_t balls)
-{
-    for (int i = 0; i < balls.pointer; i++)
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){100, 100}, 10, 0, (VReal_t){0, 0}, 0, false}, (VReal_t){100, 100}});
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){300, 300}, 10, 0, (VReal_t){0, 0}, 0, false}, (VReal_t){100, 100}});
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){500, 500}, 10, 0, (VReal_t){0, 0}, 0, false}, (VReal_t){100, 100}});
+    }
+    // KEY_R goes back to this
+    world_snapshot_t startSnapshot = {0};
+    WorldSnapshot(world, &startSnapshot);
+    if (pipelined)
     {
-        DrawCircleV(GetVector2FromV64F_t(balls.balls[i].base.position), balls.balls[i].radius, RED);
+        RunPipelined(world, &startSnapshot, camera);
+        FreeSnapshot(&startSnapshot);
+        WorldDestroy(world);
+        CloseWindow();
+        return 0;
     }
-}
-
-int main()
-{
-    InitWindow(screenWidth, screenHeight, "physics engine");
-    SetTargetFPS(targetFPS);
-    // is -1 if no shape is grabbed, otherwise will be the index of the grabbed object
-    // balls have their regular index, rects have their index + ballsCount
-    int selectedShape = -1;
-    V64F_t mouseShapeOffset = {0, 0};
-    balls_list_t balls = {malloc(sizeof(ball_t) * listStartMax), listStartMax, 0};
-    rects_list_t rects = {malloc(sizeof(rect_t) * listStartMax), listStartMax, 0};
-
-    HandleAddingBallToList(&balls, (ball_t){(shape_t){(V64F_t){screenWidth / 2, screenHeight / 2}, 10, 0, (V64F_t){0, 0}, 0, false}, 50});
-    HandleAddingBallToList(&balls, (ball_t){(shape_t){(V64F_t){screenWidth / 4, screenHeight / 4}, 10, 0, (V64F_t){0, 0}, 0, false}, 50});
-    HandleAddingBallToList(&balls, (ball_t){(shape_t){(V64F_t){3 * screenWidth / 4, 3 * screenHeight / 4}, 10, 0, (V64F_t){0, 0}, 0, false}, 50});
-
-    HandleAddingRectToList(&rects, (rect_t){(shape_t){(V64F_t){100, 100}, 10, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){100, 100}});
-    HandleAddingRectToList(&rects, (rect_t){(shape_t){(V64F_t){300, 300}, 10, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){100, 100}});
-    HandleAddingRectToList(&rects, (rect_t){(shape_t){(V64F_t){500, 500}, 10, 0, (V64F_t){0, 0}, 0, false}, (V64F_t){100, 100}});
+    scheduler_t scheduler;
+    InitScheduler(&scheduler, physicsStepTime);
+    scheduler.maxSubsteps = physicsMaxSubsteps;
+#ifdef DEV_MODE
+    // only traced when asked for, read it back with tracedump
+    const char *tracePath = getenv("PHYSICS_TRACE");
+    if (tracePath != NULL && !TraceStart(tracePath, TRACE_INPUT | TRACE_SLEEP))
+    {
+        perror(tracePath);
+    }
+#endif
     while (!WindowShouldClose())
     {
-        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && selectedShape == -1)
+        UpdateViewCamera(&camera);
+        Vector2 mousePos = GetMouseWorldPosition(camera);
+        drag.target = (VReal_t){mousePos.x, mousePos.y};
+        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && WorldGetBodyIndex(world, drag.body) < 0)
         {
-            selectedShape = GrabShape(GetMousePosition(), &balls, &rects, &mouseShapeOffset);
+            drag.body = GrabShape(mousePos, world, &drag.offset);
         }
         if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT))
         {
-            selectedShape = -1;
+            drag.body = (body_handle_t){0};
         }
-        if (IsKeyPressed(KEY_R))
+        // removing and restoring move bodies between steps, there is nothing to blend from
+        if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
         {
-            rects.rects[0].base.position = (V64F_t){100, 100};
-            rects.rects[1].base.position = (V64F_t){300, 300};
-            rects.rects[2].base.position = (V64F_t){500, 500};
-            rects.rects[0].base.velocity = (V64F_t){0, 0};
-            rects.rects[1].base.velocity = (V64F_t){0, 0};
-            rects.rects[2].base.velocity = (V64F_t){0, 0};
-            rects.rects[0].base.spinningVelocity = 0;
-            rects.rects[1].base.spinningVelocity = 0;
-            rects.rects[2].base.spinningVelocity = 0;
-            rects.rects[0].base.radian = 0;
-            rects.rects[1].base.radian = 0;
-            rects.rects[2].base.radian = 0;
+            WorldRemoveBody(world, GetShapeAt(mousePos, world));
+            ResetSchedulerInterpolation(&scheduler);
         }
-
-        HandleCollision(&balls, &rects);
-        Gravity(&balls, &rects);
-        MoveShapes(&balls, &rects);
-        HandleMapWallCollision(&balls, &rects);
-        if (selectedShape != -1)
+        if (IsKeyPressed(KEY_R))
         {
-            if (selectedShape > balls.pointer - 1)
-            {
-                MoveShapeBasedOnMousePosition(&rects.rects[selectedShape - balls.pointer].base.position, &rects.rects[selectedShape - balls.pointer].base.velocity, mouseShapeOffset);
-            }
-            else
-            {
-                MoveShapeBasedOnMousePosition(&balls.balls[selectedShape].base.position, &balls.balls[selectedShape].base.velocity, mouseShapeOffset);
-            }
+            WorldRestore(world, &startSnapshot);
+            ResetSchedulerInterpolation(&scheduler);
         }
 
+        SchedulerAdvance(&scheduler, world, GetFrameTime(), DragBeforeStep, &drag);
+
+        uint64_t drawStart = ProfileBegin();
+        WorldQueryView(world, GetCameraView(camera), &visible);
         BeginDrawing();
 
         ClearBackground(LIGHTGRAY);
-        DrawBalls(balls);
-        DrawRects(rects);
+        BeginMode2D(camera);
+        DrawVisible(world, &scheduler, &visible, camera.zoom);
+        DrawMapBounds(world->mapBounds, camera.zoom);
+        EndMode2D();
 #ifdef DEV_MODE
-        DrawText(TextFormat("ball 1 data\n"
-                            "position x:y - %.2f:%.2f\n"
-                            "velocity x:y - %.2f:%.2f\n"
-                            "current shape grabbed: %d\n"
-                            "is holding left mouse button: %d",
-                            balls.balls[0].base.position.x, balls.balls[0].base.position.y,
-                            balls.balls[0].base.velocity.x, balls.balls[0].base.velocity.y,
-                            selectedShape, IsKeyDown(KEY_A)),
-                 20, 20, 20, DARKGREEN);
-        DrawText(TextFormat("rect 1 data\n"
-                            "position x:y - %.2f:%.2f\n"
-                            "velocity x:y - %.2f:%.2f\n"
-                            "spinning velocity: %.2f\n"
-                            "is holding left mouse button: %d",
-                            rects.rects[0].base.position.x, rects.rects[0].base.position.y,
-                            rects.rects[0].base.velocity.x, rects.rects[0].base.velocity.y,
-                            rects.rects[0].base.spinningVelocity, IsKeyDown(KEY_A)),
-                 20, 200, 20, PURPLE);
+        DrawProfileOverlay(&world->profile, 20, 20);
+        DrawText(TextFormat("steps %d substeps %d visible %d", scheduler.lastSteps, scheduler.lastSubsteps, visible.ballsCount + visible.rectsCount),
+                 20, screenHeight - 40, 20, DARKGREEN);
 #endif
+        // the overlay shows the previous frame's draw time, EndDrawing is left out since it waits for the frame rate
+        ProfileEnd(&world->profile, PROFILE_PHASE_DRAW, drawStart);
         EndDrawing();
     }
-    // free lists
-    free(balls.balls);
-    free(rects.rects);
+    TraceStop();
+    FreeViewList(&visible);
+    FreeScheduler(&scheduler);
+    FreeSnapshot(&startSnapshot);
+    WorldDestroy(world);
     return 0;
 }
\ No newline at end of file
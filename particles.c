@@ -0,0 +1,397 @@
+#include "particles.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+const float particleSkinScale = 1; // default skin, in radii
+const int particleSubsteps = 8;
+const int particleIterations = 1;
+const float particleMaxMove = 0.5f; // in radii per substep along each axis, faster particles would pass through each other
+const int particleGrain = 2048;
+const int particleCellsPerParticle = 4; // the grid gets coarser instead of having more cells than this per particle
+
+typedef struct particle_task_t
+{
+    particles_t *particles;
+    float deltaTime;
+    int parity; // of the bands being solved
+} particle_task_t;
+
+particles_t *ParticlesCreate(float radius)
+{
+    particles_t *particles = calloc(1, sizeof(particles_t));
+    if (particles == NULL)
+    {
+        return NULL;
+    }
+    particles->radius = radius;
+    particles->skin = particleSkinScale * radius;
+    particles->substeps = particleSubsteps;
+    particles->iterations = particleIterations;
+    particles->gravity = (float)GetDefaultWorldParams().gravity;
+    particles->mapBounds = (bounds_t){0, 0, screenWidth, screenHeight};
+    atomic_init(&particles->listsStale, true);
+    atomic_init(&particles->contacts, 0);
+    atomic_init(&particles->listedNeighbors, 0);
+    atomic_init(&particles->droppedNeighbors, 0);
+    return particles;
+}
+
+void ParticlesDestroy(particles_t *particles)
+{
+    free(particles->positionX);
+    free(particles->positionY);
+    free(particles->velocityX);
+    free(particles->velocityY);
+    free(particles->neighbors);
+    free(particles->neighborCounts);
+    free(particles->listX);
+    free(particles->listY);
+    free(particles->cellOf);
+    free(particles->order);
+    free(particles->cellStarts);
+    free(particles->bandStarts);
+    ThreadPoolDestroy(particles->pool);
+    free(particles);
+}
+
+void ParticlesReserve(particles_t *particles, int count)
+{
+    if (count <= particles->max)
+    {
+        return;
+    }
+    particles->max = count;
+    float **floats[] = {&particles->positionX, &particles->positionY, &particles->velocityX, &particles->velocityY, &particles->listX, &particles->listY};
+    for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++)
+    {
+        *floats[i] = realloc(*floats[i], sizeof(float) * count);
+    }
+    particles->neighbors = realloc(particles->neighbors, sizeof(int) * PARTICLE_MAX_NEIGHBORS * count);
+    particles->neighborCounts = realloc(particles->neighborCounts, sizeof(int) * count);
+    particles->cellOf = realloc(particles->cellOf, sizeof(int) * count);
+    particles->order = realloc(particles->order, sizeof(int) * count);
+}
+
+int ParticlesAdd(particles_t *particles, float x, float y, float velocityX, float velocityY)
+{
+    if (particles->count == particles->max)
+    {
+        ParticlesReserve(particles, particles->max > 0 ? particles->max * 2 : 1024);
+    }
+    int index = particles->count++;
+    particles->positionX[index] = x;
+    particles->positionY[index] = y;
+    particles->velocityX[index] = velocityX;
+    particles->velocityY[index] = velocityY;
+    atomic_store_explicit(&particles->listsStale, true, memory_order_relaxed);
+    return index;
+}
+
+void ParticlesSetThreads(particles_t *particles, int threads)
+{
+    ThreadPoolDestroy(particles->pool);
+    particles->pool = threads > 1 ? ThreadPoolCreate(threads) : NULL;
+}
+
+// where the centers of the particles have to stay
+bounds_t GetParticleLimits(const particles_t *particles)
+{
+    bounds_t map = particles->mapBounds;
+    real_t radius = particles->radius;
+    return (bounds_t){map.minX + radius, map.minY + radius, map.maxX - radius, map.maxY - radius};
+}
+
+float ClampParticle(float value, float min, float max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+// gravity and the move, no further than particleMaxMove, then whether anything left the skin its neighbor list was built with
+void PredictParticles(void *context, int begin, int end)
+{
+    const particle_task_t *task = context;
+    particles_t *particles = task->particles;
+    float deltaTime = task->deltaTime;
+    float inverseDeltaTime = 1 / deltaTime;
+    float gravityStep = particles->gravity * deltaTime;
+    float maxSpeed = particleMaxMove * particles->radius * inverseDeltaTime;
+    float halfSkin = particles->skin * 0.5f;
+    float halfSkinSquared = halfSkin * halfSkin;
+    float *positionX = particles->positionX;
+    float *positionY = particles->positionY;
+    float *velocityX = particles->velocityX;
+    float *velocityY = particles->velocityY;
+    const float *listX = particles->listX;
+    const float *listY = particles->listY;
+    bounds_t limits = GetParticleLimits(particles);
+    float minX = (float)limits.minX;
+    float minY = (float)limits.minY;
+    float maxX = (float)limits.maxX;
+    float maxY = (float)limits.maxY;
+    bool stale = false;
+    for (int i = begin; i < end; i++)
+    {
+        float speedX = ClampParticle(velocityX[i], -maxSpeed, maxSpeed);
+        float speedY = ClampParticle(velocityY[i] + gravityStep, -maxSpeed, maxSpeed);
+        float movedToX = positionX[i] + speedX * deltaTime;
+        float movedToY = positionY[i] + speedY * deltaTime;
+        float x = ClampParticle(movedToX, minX, maxX);
+        float y = ClampParticle(movedToY, minY, maxY);
+        velocityX[i] = speedX + (x - movedToX) * inverseDeltaTime;
+        velocityY[i] = speedY + (y - movedToY) * inverseDeltaTime;
+        positionX[i] = x;
+        positionY[i] = y;
+        float movedX = x - listX[i];
+        float movedY = y - listY[i];
+        stale |= movedX * movedX + movedY * movedY > halfSkinSquared;
+    }
+    if (stale)
+    {
+        atomic_store_explicit(&particles->listsStale, true, memory_order_relaxed);
+    }
+}
+
+int GetParticleCell(const particles_t *particles, float x, float y)
+{
+    int cellX = (int)((x - particles->mapBounds.minX) / particles->cellSize);
+    int cellY = (int)((y - particles->mapBounds.minY) / particles->cellSize);
+    // anything outside the map goes into the border cells, the walls push it back in
+    cellX = cellX < 0 ? 0 : (cellX >= particles->cellsX ? particles->cellsX - 1 : cellX);
+    cellY = cellY < 0 ? 0 : (cellY >= particles->cellsY ? particles->cellsY - 1 : cellY);
+    // column after column, so a column of the grid is one run of particles from the top of the map down
+    return cellX * particles->cellsY + cellY;
+}
+
+// lists the particles after each one within the cutoff, from the cells around it
+void FindParticleNeighbors(void *context, int begin, int end)
+{
+    particles_t *particles = context;
+    float cutoff = 2 * particles->radius + particles->skin;
+    float cutoffSquared = cutoff * cutoff;
+    const float *positionX = particles->positionX;
+    const float *positionY = particles->positionY;
+    long long listed = 0;
+    long long dropped = 0;
+    for (int i = begin; i < end; i++)
+    {
+        float x = positionX[i];
+        float y = positionY[i];
+        int cell = GetParticleCell(particles, x, y);
+        int cellX = cell / particles->cellsY;
+        int cellY = cell % particles->cellsY;
+        int *neighbors = &particles->neighbors[i * PARTICLE_MAX_NEIGHBORS];
+        int count = 0;
+        // particles are sorted by cell, so the column on the left holds none after i
+        for (int neighborX = cellX; neighborX <= cellX + 1 && neighborX < particles->cellsX; neighborX++)
+        {
+            int columnStart = neighborX * particles->cellsY;
+            // the three cells of a column are next to each other, so are their particles
+            int first = particles->cellStarts[columnStart + (cellY > 0 ? cellY - 1 : 0)];
+            int last = particles->cellStarts[columnStart + (cellY + 1 < particles->cellsY ? cellY + 2 : particles->cellsY)];
+            for (int j = first > i + 1 ? first : i + 1; j < last; j++)
+            {
+                float distanceX = positionX[j] - x;
+                float distanceY = positionY[j] - y;
+                if (distanceX * distanceX + distanceY * distanceY < cutoffSquared)
+                {
+                    if (count < PARTICLE_MAX_NEIGHBORS)
+                    {
+                        neighbors[count++] = j;
+                    }
+                    else
+                    {
+                        dropped++;
+                    }
+                }
+            }
+        }
+        particles->neighborCounts[i] = count;
+        listed += count;
+    }
+    atomic_fetch_add_explicit(&particles->listedNeighbors, listed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&particles->droppedNeighbors, dropped, memory_order_relaxed);
+}
+
+// puts values into the order of particles->order, through scratch, and swaps the two
+void PermuteParticleValues(const particles_t *particles, float **values, float **scratch)
+{
+    for (int i = 0; i < particles->count; i++)
+    {
+        (*scratch)[i] = (*values)[particles->order[i]];
+    }
+    float *sorted = *scratch;
+    *scratch = *values;
+    *values = sorted;
+}
+
+// sorts the particles by grid cell, then lists the pairs within the cutoff
+void BuildParticleNeighbors(particles_t *particles)
+{
+    int count = particles->count;
+    bounds_t map = particles->mapBounds;
+    float width = (float)(map.maxX - map.minX);
+    float height = (float)(map.maxY - map.minY);
+    particles->cellSize = 2 * particles->radius + particles->skin;
+    long long maxCells = (long long)count * particleCellsPerParticle + 1024;
+    while ((long long)ceilf(width / particles->cellSize) * (long long)ceilf(height / particles->cellSize) > maxCells)
+    {
+        particles->cellSize *= 2;
+    }
+    particles->cellsX = width > 0 ? (int)ceilf(width / particles->cellSize) : 1;
+    particles->cellsY = height > 0 ? (int)ceilf(height / particles->cellSize) : 1;
+    int cells = particles->cellsX * particles->cellsY;
+    if (cells + 1 > particles->cellsMax)
+    {
+        particles->cellsMax = cells + 1;
+        particles->cellStarts = realloc(particles->cellStarts, sizeof(int) * particles->cellsMax);
+    }
+    particles->bandsCount = (particles->cellsX + 1) / 2;
+    if (particles->bandsCount + 1 > particles->bandsMax)
+    {
+        particles->bandsMax = particles->bandsCount + 1;
+        particles->bandStarts = realloc(particles->bandStarts, sizeof(int) * particles->bandsMax);
+    }
+
+    // counting sort, cellStarts[c] ends up as the first particle of cell c
+    int *cellStarts = particles->cellStarts;
+    memset(cellStarts, 0, sizeof(int) * (cells + 1));
+    for (int i = 0; i < count; i++)
+    {
+        particles->cellOf[i] = GetParticleCell(particles, particles->positionX[i], particles->positionY[i]);
+        cellStarts[particles->cellOf[i] + 1]++;
+    }
+    for (int cell = 0; cell < cells; cell++)
+    {
+        cellStarts[cell + 1] += cellStarts[cell];
+    }
+    for (int i = 0; i < count; i++)
+    {
+        particles->order[cellStarts[particles->cellOf[i]]++] = i;
+    }
+    // every start moved to the next cell's start while filling
+    memmove(cellStarts + 1, cellStarts, sizeof(int) * cells);
+    cellStarts[0] = 0;
+    PermuteParticleValues(particles, &particles->positionX, &particles->listX);
+    PermuteParticleValues(particles, &particles->positionY, &particles->listY);
+    PermuteParticleValues(particles, &particles->velocityX, &particles->listX);
+    PermuteParticleValues(particles, &particles->velocityY, &particles->listY);
+    for (int band = 0; band <= particles->bandsCount; band++)
+    {
+        int column = 2 * band < particles->cellsX ? 2 * band : particles->cellsX;
+        particles->bandStarts[band] = cellStarts[column * particles->cellsY];
+    }
+
+    atomic_store_explicit(&particles->listedNeighbors, 0, memory_order_relaxed);
+    atomic_store_explicit(&particles->droppedNeighbors, 0, memory_order_relaxed);
+    ParallelFor(particles->pool, count, particleGrain, FindParticleNeighbors, particles);
+    particles->stats.dropped += atomic_load_explicit(&particles->droppedNeighbors, memory_order_relaxed);
+    memcpy(particles->listX, particles->positionX, sizeof(float) * count);
+    memcpy(particles->listY, particles->positionY, sizeof(float) * count);
+    atomic_store_explicit(&particles->listsStale, false, memory_order_relaxed);
+    particles->stats.rebuilds++;
+}
+
+// pushes every overlapping pair of the bands apart in place, Gauss-Seidel, and the velocities take the pushes along
+// a band is two grid columns and pairs never reach further than the next column, so bands of one parity share no particles
+// and run in parallel, with the same result on any number of threads
+// each pair moves apart by (diameter - distance) / distance of its offset, split between the two
+// for the small overlaps of a stable pile that is (diameter² - distance²) / (2 diameter²) to first order, which is always
+// short of the full push, so no pair needs a sqrt or a division; only pairs more than half on top of each other, which the
+// first order would part ever more slowly, take the exact push
+void SolveParticleBands(void *context, int begin, int end)
+{
+    const particle_task_t *task = context;
+    particles_t *particles = task->particles;
+    float inverseDeltaTime = 1 / task->deltaTime;
+    float diameter = 2 * particles->radius;
+    float diameterSquared = diameter * diameter;
+    float pushScale = 0.5f / (2 * diameterSquared);
+    float deepSquared = 0.25f * diameterSquared;
+    float *positionX = particles->positionX;
+    float *positionY = particles->positionY;
+    float *velocityX = particles->velocityX;
+    float *velocityY = particles->velocityY;
+    bounds_t limits = GetParticleLimits(particles);
+    float minX = (float)limits.minX;
+    float minY = (float)limits.minY;
+    float maxX = (float)limits.maxX;
+    float maxY = (float)limits.maxY;
+    long long contacts = 0;
+    for (int pair = begin; pair < end; pair++)
+    {
+        int band = 2 * pair + task->parity;
+        int first = particles->bandStarts[band];
+        int last = particles->bandStarts[band + 1];
+        for (int n = 0; n < last - first; n++)
+        {
+            // against gravity, so the floor holds up a whole column in one sweep
+            int i = particles->gravity >= 0 ? last - 1 - n : first + n;
+            const int *neighbors = &particles->neighbors[i * PARTICLE_MAX_NEIGHBORS];
+            for (int k = 0; k < particles->neighborCounts[i]; k++)
+            {
+                int j = neighbors[k];
+                float offsetX = positionX[i] - positionX[j];
+                float offsetY = positionY[i] - positionY[j];
+                float distanceSquared = offsetX * offsetX + offsetY * offsetY;
+                if (distanceSquared >= diameterSquared)
+                {
+                    continue;
+                }
+                float push = (diameterSquared - distanceSquared) * pushScale;
+                if (distanceSquared < deepSquared)
+                {
+                    // particles on the same spot have no direction to part in, they take one along x
+                    if (distanceSquared == 0)
+                    {
+                        offsetX = 0.01f * diameter;
+                        distanceSquared = offsetX * offsetX;
+                    }
+                    float distance = sqrtf(distanceSquared);
+                    push = 0.5f * (diameter - distance) / distance;
+                }
+                positionX[i] += push * offsetX;
+                positionY[i] += push * offsetY;
+                positionX[j] -= push * offsetX;
+                positionY[j] -= push * offsetY;
+                velocityX[i] += push * offsetX * inverseDeltaTime;
+                velocityY[i] += push * offsetY * inverseDeltaTime;
+                velocityX[j] -= push * offsetX * inverseDeltaTime;
+                velocityY[j] -= push * offsetY * inverseDeltaTime;
+                contacts++;
+            }
+            float x = ClampParticle(positionX[i], minX, maxX);
+            float y = ClampParticle(positionY[i], minY, maxY);
+            velocityX[i] += (x - positionX[i]) * inverseDeltaTime;
+            velocityY[i] += (y - positionY[i]) * inverseDeltaTime;
+            positionX[i] = x;
+            positionY[i] = y;
+        }
+    }
+    atomic_fetch_add_explicit(&particles->contacts, contacts, memory_order_relaxed);
+}
+
+void ParticlesStep(particles_t *particles, float deltaTime)
+{
+    int count = particles->count;
+    particle_task_t task = {particles, deltaTime / particles->substeps, 0};
+    for (int substep = 0; substep < particles->substeps; substep++)
+    {
+        ParallelFor(particles->pool, count, particleGrain, PredictParticles, &task);
+        if (atomic_load_explicit(&particles->listsStale, memory_order_relaxed))
+        {
+            BuildParticleNeighbors(particles);
+        }
+        for (int iteration = 0; iteration < particles->iterations; iteration++)
+        {
+            atomic_store_explicit(&particles->contacts, 0, memory_order_relaxed);
+            for (task.parity = 0; task.parity < 2; task.parity++)
+            {
+                ParallelFor(particles->pool, (particles->bandsCount + 1 - task.parity) / 2, 1, SolveParticleBands, &task);
+            }
+        }
+    }
+    particles->stats.steps++;
+    particles->stats.neighbors += atomic_load_explicit(&particles->listedNeighbors, memory_order_relaxed);
+    particles->stats.contacts += atomic_load_explicit(&particles->contacts, memory_order_relaxed);
+}
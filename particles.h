@@ -0,0 +1,77 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "physics.h"
+#include <stdatomic.h>
+
+#define PARTICLE_MAX_NEIGHBORS 16 // after each particle, a cache line of indices, touching equal circles have at most 6 in all
+
+// many small balls of one radius, for granular scenes of 100k and more that the body lists can't step at interactive rates
+// particles only have a position and a velocity, stored as float whatever real_t is: no mass, spin, sleeping or handles
+// contacts are resolved on positions, each iteration pushes overlapping pairs apart and the velocity follows what
+// the pushes did, which is stable at any count without a velocity solver, like the rest of the engine it's inelastic
+// pairs come from a neighbor list of everything within two radii plus a skin, it's only rebuilt once some particle moved
+// further than half the skin since the last build, so most steps never touch a grid
+// particles don't collide with the bodies of a world, they only share its map bounds and gravity
+
+typedef struct particles_stats_t
+{
+    long long steps;
+    long long rebuilds;  // of the neighbor lists
+    long long neighbors; // pairs in the lists, summed over steps
+    long long dropped;   // neighbors past PARTICLE_MAX_NEIGHBORS left out of a list, only a pile crushed far past touching has any
+    long long contacts;  // overlapping pairs in the last iteration, summed over steps
+} particles_stats_t;
+
+typedef struct particles_t
+{
+    int count;
+    int max;
+    float radius;
+    float skin;     // neighbors are kept up to this far beyond touching
+    // a deep pile needs many contact passes for its weight to reach the floor, and substeps converge it far better
+    // than iterations: the overlap left goes down with the square of the substeps but only linearly with iterations
+    int substeps;
+    int iterations; // contact passes per substep
+    float gravity;  // units/second²
+    bounds_t mapBounds;
+    // the order changes on every neighbor list rebuild, particles are sorted by grid cell so neighbors are near in memory
+    float *positionX;
+    float *positionY;
+    float *velocityX;
+    float *velocityY;
+    // neighbor lists, each pair once: the neighbors after i are neighbors[i * PARTICLE_MAX_NEIGHBORS ..], neighborCounts[i] of them
+    int *neighbors;
+    int *neighborCounts;
+    float *listX; // positions the lists were built at
+    float *listY;
+    // scratch
+    int *cellOf;
+    int *order;
+    int *cellStarts;
+    int cellsMax;
+    int cellsX;
+    int cellsY;
+    float cellSize;
+    int *bandStarts; // first particle of every two grid columns, and the count at the end
+    int bandsCount;
+    int bandsMax;
+    atomic_bool listsStale;
+    atomic_llong contacts;          // of the last contact pass
+    atomic_llong listedNeighbors;   // pairs in the lists
+    atomic_llong droppedNeighbors;  // by the last rebuild
+    thread_pool_t *pool; // NULL when running single threaded
+    particles_stats_t stats;
+} particles_t;
+
+// the map bounds are the screen's and gravity is the world default until changed
+particles_t *ParticlesCreate(float radius);
+void ParticlesDestroy(particles_t *particles);
+// returns the index of the new particle, which only holds until the next step
+int ParticlesAdd(particles_t *particles, float x, float y, float velocityX, float velocityY);
+void ParticlesReserve(particles_t *particles, int count);
+// threads includes the calling thread, 1 runs everything on the caller
+void ParticlesSetThreads(particles_t *particles, int threads);
+void ParticlesStep(particles_t *particles, float deltaTime);
+
+#endif
@@ -0,0 +1,2664 @@
+#include "physics.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <tgmath.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "kernels.h"
+#include "trace.h"
+#include "pool.h"
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+const int screenWidth = 1280;
+const int screenHeight = 720;
+const int listStartMax = 16;
+
+const int broadphaseMinBuckets = 64;
+const int integrationGrain = 4096; // bodies per parallel range, a multiple of every SIMD_WIDTH
+const int collisionGrain = 256;    // pairs per parallel range
+const real_t broadphaseCellScale = 2; // cell size = mean body extent * scale
+
+// defaults for world_params_t, every world gets its own copy to change
+const real_t gravity = 9.82 * 0;
+const real_t mapBoundraryCollisionBouce = 1; // 1 means no force is lost upon wall collision (elastic), everything above 1 will cause a increase in force for every collision
+// shapes past an edge of the map are mirrored back so there is no velocity limit on the walls
+// rects bounce elastically off the walls unless a world says otherwise
+const real_t mapBoundraryRectBounce = 1;
+
+// a body slower than this for timeToSleep seconds may fall asleep, once everything touching it agrees
+const real_t sleepVelocity = 18;          // units/second
+const real_t sleepSpinningVelocity = 0.72; // radians/second
+const real_t timeToSleep = 0.5;
+
+// world_params_t defaults too
+const real_t ballRestitution = 1;   // balls bounce off each other elastically
+const real_t rectRestitution = 0.6;
+const real_t restitutionThreshold = 18; // units/second, slower contacts don't bounce at all
+const real_t contactSlop = 0.01;          // penetration left in place so resting contacts keep touching and stay cached
+const real_t contactCorrection = 0.8;     // share of the remaining penetration removed every step
+const int defaultVelocityIterations = 8;
+const real_t boxFaceTolerance = 0.95;         // a box face only takes over as reference face when it is clearly less deep
+const real_t boxFaceAbsoluteTolerance = 0.01; // relative to the half size along the face normal
+const real_t queryTreeMargin = 0.25;   // fat bounds reach this share of the body's size past it on every side
+const real_t queryTreeLookahead = 0.01; // and this many seconds of its movement ahead
+// a body moving less than its smallest half size in a step stops short of the middle of anything it runs into,
+// so the narrow phase still pushes it back out the side it came from, faster ones are swept
+const real_t continuousMotionScale = 1;
+
+// picked by the first WorldCreate, the same for every world after it
+const physics_kernels_t *physicsKernels = &physicsKernelsBaseline;
+pthread_once_t physicsKernelsOnce = PTHREAD_ONCE_INIT;
+
+void InitPhysicsKernels(void)
+{
+    physicsKernels = SelectPhysicsKernels();
+}
+
+const physics_kernels_t *SelectPhysicsKernels(void)
+{
+    const char *forced = getenv("PHYSICS_KERNELS");
+    if (forced != NULL && strcmp(forced, "baseline") == 0)
+    {
+        return &physicsKernelsBaseline;
+    }
+    if (forced != NULL && strcmp(forced, "scalar") == 0)
+    {
+        return &physicsKernelsScalar;
+    }
+#ifdef PHYSICS_KERNELS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &physicsKernelsAvx2;
+    }
+#endif
+    return &physicsKernelsBaseline;
+}
+
+const char *GetPhysicsKernelsName(void)
+{
+    pthread_once(&physicsKernelsOnce, InitPhysicsKernels);
+    return physicsKernels->name;
+}
+
+// body arrays live in pools, growing them never moves a body
+// false if one of them couldn't grow, the ones before it may have, which only leaves them room to spare
+bool ResizeShapes(shapes_t *shapes, int max)
+{
+    int blocks = (max + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE;
+    return PoolArrayGrow(&shapes->positionX, max, sizeof(real_t)) && PoolArrayGrow(&shapes->positionY, max, sizeof(real_t)) &&
+           PoolArrayGrow(&shapes->velocityX, max, sizeof(real_t)) && PoolArrayGrow(&shapes->velocityY, max, sizeof(real_t)) &&
+           PoolArrayGrow(&shapes->mass, max, sizeof(real_t)) && PoolArrayGrow(&shapes->radian, max, sizeof(real_t)) &&
+           PoolArrayGrow(&shapes->spinningVelocity, max, sizeof(real_t)) && PoolArrayGrow(&shapes->isGrabbed, max, sizeof(bool)) &&
+           PoolArrayGrow(&shapes->awake, max, sizeof(real_t)) && PoolArrayGrow(&shapes->sleepTime, max, sizeof(real_t)) &&
+           PoolArrayGrow(&shapes->blockAwake, blocks, sizeof(unsigned char)) && PoolArrayGrow(&shapes->blockMoved, blocks, sizeof(unsigned char)) &&
+           PoolArrayGrow(&shapes->slot, max, sizeof(int));
+}
+
+void FreeShapes(shapes_t *shapes)
+{
+    PoolArrayFree(shapes->positionX);
+    PoolArrayFree(shapes->positionY);
+    PoolArrayFree(shapes->velocityX);
+    PoolArrayFree(shapes->velocityY);
+    PoolArrayFree(shapes->mass);
+    PoolArrayFree(shapes->radian);
+    PoolArrayFree(shapes->spinningVelocity);
+    PoolArrayFree(shapes->isGrabbed);
+    PoolArrayFree(shapes->awake);
+    PoolArrayFree(shapes->sleepTime);
+    PoolArrayFree(shapes->blockAwake);
+    PoolArrayFree(shapes->blockMoved);
+    PoolArrayFree(shapes->slot);
+    *shapes = (shapes_t){0};
+}
+
+// the whole state of the body at from, sleep and handle slot included, replaces the one at to
+void MoveShape(shapes_t *shapes, int from, int to)
+{
+    SetShape(shapes, to, GetShape(shapes, from));
+    shapes->awake[to] = shapes->awake[from];
+    shapes->sleepTime[to] = shapes->sleepTime[from];
+    shapes->slot[to] = shapes->slot[from];
+    shapes->blockAwake[to / SLEEP_BLOCK_SIZE] |= shapes->awake[to] != 0;
+    shapes->blockMoved[to / SLEEP_BLOCK_SIZE] = 1;
+}
+
+bool ReserveBodySlots(body_slots_t *slots, int count)
+{
+    if (slots->max >= count)
+    {
+        return true;
+    }
+    if (!PoolArrayGrow(&slots->indices, count, sizeof(int)) || !PoolArrayGrow(&slots->generations, count, sizeof(unsigned int)) ||
+        !PoolArrayGrow(&slots->treeLeaves, count, sizeof(int)))
+    {
+        return false;
+    }
+    slots->max = count;
+    return true;
+}
+
+void FreeBodySlots(body_slots_t *slots)
+{
+    PoolArrayFree(slots->indices);
+    PoolArrayFree(slots->generations);
+    PoolArrayFree(slots->treeLeaves);
+    *slots = (body_slots_t){0};
+}
+
+// free slots keep -2 - the next free slot in indices, so the chain's -1 end stays -1 and no free slot looks like an index
+// the mapping is its own inverse
+int GetFreeSlotLink(int slot)
+{
+    return -2 - slot;
+}
+
+// 0 stays reserved for handles that name nothing
+unsigned int GetNextGeneration(unsigned int generation)
+{
+    return generation + 1 != 0 ? generation + 1 : 1;
+}
+
+// reuses the most recently freed slot, a new one only when none is free, -1 if the slots couldn't grow
+int AllocateBodySlot(body_slots_t *slots, int index)
+{
+    int slot = slots->freeSlot;
+    if (slot >= 0)
+    {
+        slots->freeSlot = GetFreeSlotLink(slots->indices[slot]);
+        // bumped here too, so a handle taken after a snapshot can't match the slot's generation once that is restored
+        slots->generations[slot] = GetNextGeneration(slots->generations[slot]);
+    }
+    else
+    {
+        if (slots->count >= slots->max && !ReserveBodySlots(slots, slots->max > 0 ? slots->max * 2 : listStartMax))
+        {
+            return -1;
+        }
+        slot = slots->count++;
+        slots->generations[slot] = 1;
+    }
+    slots->indices[slot] = index;
+    slots->treeLeaves[slot] = AABB_TREE_NULL;
+    return slot;
+}
+
+void FreeBodySlot(body_slots_t *slots, int slot)
+{
+    slots->generations[slot] = GetNextGeneration(slots->generations[slot]);
+    slots->indices[slot] = GetFreeSlotLink(slots->freeSlot);
+    slots->freeSlot = slot;
+}
+
+shape_t GetShape(const shapes_t *shapes, int index)
+{
+    return (shape_t){(VReal_t){shapes->positionX[index], shapes->positionY[index]},
+                     shapes->mass[index],
+                     shapes->radian[index],
+                     (VReal_t){shapes->velocityX[index], shapes->velocityY[index]},
+                     shapes->spinningVelocity[index],
+                     shapes->isGrabbed[index]};
+}
+
+void SetShape(shapes_t *shapes, int index, shape_t shape)
+{
+    shapes->positionX[index] = shape.position.x;
+    shapes->positionY[index] = shape.position.y;
+    shapes->velocityX[index] = shape.velocity.x;
+    shapes->velocityY[index] = shape.velocity.y;
+    shapes->mass[index] = shape.mass;
+    shapes->radian[index] = shape.radian;
+    shapes->spinningVelocity[index] = shape.spinningVelocity;
+    shapes->isGrabbed[index] = shape.isGrabbed;
+}
+
+void WakeShape(shapes_t *shapes, int index)
+{
+    shapes->awake[index] = 1;
+    shapes->sleepTime[index] = 0;
+    shapes->blockAwake[index / SLEEP_BLOCK_SIZE] = 1;
+}
+
+// calls task over the runs of blocks in [begin, end) that still have an awake shape
+void RunOnAwakeBlocks(const shapes_t *shapes, int begin, int end, parallel_task_t task, void *context)
+{
+    int runBegin = begin;
+    while (runBegin < end)
+    {
+        while (runBegin < end && shapes->blockAwake[runBegin / SLEEP_BLOCK_SIZE] == 0)
+        {
+            runBegin = (runBegin / SLEEP_BLOCK_SIZE + 1) * SLEEP_BLOCK_SIZE;
+        }
+        int runEnd = runBegin;
+        while (runEnd < end && shapes->blockAwake[runEnd / SLEEP_BLOCK_SIZE] != 0)
+        {
+            runEnd = (runEnd / SLEEP_BLOCK_SIZE + 1) * SLEEP_BLOCK_SIZE;
+        }
+        runEnd = runEnd < end ? runEnd : end;
+        if (runBegin < runEnd)
+        {
+            task(context, runBegin, runEnd);
+        }
+        runBegin = runEnd;
+    }
+}
+
+bool InitBallsList(balls_list_t *balls, int max)
+{
+    *balls = (balls_list_t){0};
+    balls->max = max;
+    balls->slots.freeSlot = -1;
+    return ResizeShapes(&balls->base, max) && PoolArrayGrow(&balls->radius, max, sizeof(real_t));
+}
+
+void FreeBallsList(balls_list_t *balls)
+{
+    FreeShapes(&balls->base);
+    PoolArrayFree(balls->radius);
+    FreeBodySlots(&balls->slots);
+    *balls = (balls_list_t){0};
+}
+
+ball_t GetBall(const balls_list_t *balls, int index)
+{
+    return (ball_t){GetShape(&balls->base, index), balls->radius[index]};
+}
+
+void SetBall(balls_list_t *balls, int index, ball_t ball)
+{
+    SetShape(&balls->base, index, ball.base);
+    balls->radius[index] = ball.radius;
+}
+
+int AddBall(balls_list_t *balls, ball_t newBall)
+{
+    int slot = AllocateBodySlot(&balls->slots, balls->pointer);
+    if (slot < 0)
+    {
+        return -1;
+    }
+    SetBall(balls, balls->pointer, newBall);
+    WakeShape(&balls->base, balls->pointer);
+    balls->base.blockMoved[balls->pointer / SLEEP_BLOCK_SIZE] = 1;
+    balls->base.slot[balls->pointer] = slot;
+    balls->pointer += 1;
+    return slot;
+}
+
+// the last ball takes the removed one's index, so the list stays dense
+void RemoveBall(balls_list_t *balls, int index)
+{
+    int last = balls->pointer - 1;
+    FreeBodySlot(&balls->slots, balls->base.slot[index]);
+    if (index != last)
+    {
+        MoveShape(&balls->base, last, index);
+        balls->radius[index] = balls->radius[last];
+        balls->slots.indices[balls->base.slot[index]] = index;
+    }
+    balls->pointer = last;
+}
+
+// the list keeps its size if an array couldn't grow
+bool IncreaseBallsListSize(balls_list_t *balls)
+{
+    int max = balls->max * 2;
+    if (!ResizeShapes(&balls->base, max) || !PoolArrayGrow(&balls->radius, max, sizeof(real_t)))
+    {
+        return false;
+    }
+    balls->max = max;
+    return true;
+}
+
+int HandleAddingBallToList(balls_list_t *balls, ball_t newBall)
+{
+    if (balls->pointer >= balls->max && !IncreaseBallsListSize(balls))
+    {
+        return -1;
+    }
+    return AddBall(balls, newBall);
+}
+
+bool ResizeRectsArrays(rects_list_t *rects, int max)
+{
+    return ResizeShapes(&rects->base, max) && PoolArrayGrow(&rects->sizeX, max, sizeof(real_t)) &&
+           PoolArrayGrow(&rects->sizeY, max, sizeof(real_t)) && PoolArrayGrow(&rects->cosRadian, max, sizeof(real_t)) &&
+           PoolArrayGrow(&rects->sinRadian, max, sizeof(real_t));
+}
+
+bool InitRectsList(rects_list_t *rects, int max)
+{
+    *rects = (rects_list_t){0};
+    rects->max = max;
+    rects->slots.freeSlot = -1;
+    return ResizeRectsArrays(rects, max);
+}
+
+void FreeRectsList(rects_list_t *rects)
+{
+    FreeShapes(&rects->base);
+    PoolArrayFree(rects->sizeX);
+    PoolArrayFree(rects->sizeY);
+    PoolArrayFree(rects->cosRadian);
+    PoolArrayFree(rects->sinRadian);
+    FreeBodySlots(&rects->slots);
+    *rects = (rects_list_t){0};
+}
+
+rect_t GetRect(const rects_list_t *rects, int index)
+{
+    return (rect_t){GetShape(&rects->base, index), (VReal_t){rects->sizeX[index], rects->sizeY[index]}};
+}
+
+void SetRect(rects_list_t *rects, int index, rect_t rect)
+{
+    SetShape(&rects->base, index, rect.base);
+    rects->sizeX[index] = rect.size.x;
+    rects->sizeY[index] = rect.size.y;
+    rects->cosRadian[index] = cos(rect.base.radian);
+    rects->sinRadian[index] = sin(rect.base.radian);
+}
+
+int AddRect(rects_list_t *rects, rect_t newRect)
+{
+    int slot = AllocateBodySlot(&rects->slots, rects->pointer);
+    if (slot < 0)
+    {
+        return -1;
+    }
+    SetRect(rects, rects->pointer, newRect);
+    WakeShape(&rects->base, rects->pointer);
+    rects->base.blockMoved[rects->pointer / SLEEP_BLOCK_SIZE] = 1;
+    rects->base.slot[rects->pointer] = slot;
+    rects->pointer += 1;
+    return slot;
+}
+
+void RemoveRect(rects_list_t *rects, int index)
+{
+    int last = rects->pointer - 1;
+    FreeBodySlot(&rects->slots, rects->base.slot[index]);
+    if (index != last)
+    {
+        MoveShape(&rects->base, last, index);
+        rects->sizeX[index] = rects->sizeX[last];
+        rects->sizeY[index] = rects->sizeY[last];
+        rects->cosRadian[index] = rects->cosRadian[last];
+        rects->sinRadian[index] = rects->sinRadian[last];
+        rects->slots.indices[rects->base.slot[index]] = index;
+    }
+    rects->pointer = last;
+}
+
+bool IncreaseRectsListSize(rects_list_t *rects)
+{
+    int max = rects->max * 2;
+    if (!ResizeRectsArrays(rects, max))
+    {
+        return false;
+    }
+    rects->max = max;
+    return true;
+}
+
+int HandleAddingRectToList(rects_list_t *rects, rect_t newRect)
+{
+    if (rects->pointer >= rects->max && !IncreaseRectsListSize(rects))
+    {
+        return -1;
+    }
+    return AddRect(rects, newRect);
+}
+
+void IncreasePairsListSize(pairs_list_t *pairs)
+{
+    pairs->max = pairs->max > 0 ? pairs->max * 2 : listStartMax;
+    pairs->pairs = realloc(pairs->pairs, sizeof(pair_t) * pairs->max);
+}
+
+void HandleAddingPairToList(pairs_list_t *pairs, int first, int second)
+{
+    if (pairs->pointer >= pairs->max)
+    {
+        IncreasePairsListSize(pairs);
+    }
+    pairs->pairs[pairs->pointer] = (pair_t){first, second};
+    pairs->pointer += 1;
+}
+
+void EnsureBroadphaseBoundsSize(broadphase_t *broadphase, int count)
+{
+    if (count <= broadphase->boundsMax)
+    {
+        return;
+    }
+    while (broadphase->boundsMax < count)
+    {
+        broadphase->boundsMax = broadphase->boundsMax > 0 ? broadphase->boundsMax * 2 : listStartMax;
+    }
+    broadphase->bounds = realloc(broadphase->bounds, sizeof(bounds_t) * broadphase->boundsMax);
+}
+
+void EnsureBroadphaseEntriesSize(broadphase_t *broadphase, int count)
+{
+    if (count <= broadphase->entriesMax)
+    {
+        return;
+    }
+    while (broadphase->entriesMax < count)
+    {
+        broadphase->entriesMax = broadphase->entriesMax > 0 ? broadphase->entriesMax * 2 : listStartMax;
+    }
+    broadphase->entries = realloc(broadphase->entries, sizeof(grid_entry_t) * broadphase->entriesMax);
+    broadphase->sortedEntries = realloc(broadphase->sortedEntries, sizeof(grid_entry_t) * broadphase->entriesMax);
+}
+
+void FreeBroadphase(broadphase_t *broadphase)
+{
+    free(broadphase->bounds);
+    free(broadphase->entries);
+    free(broadphase->sortedEntries);
+    free(broadphase->bucketStarts);
+    free(broadphase->pairs.pairs);
+    for (int i = 0; i < BROADPHASE_CHUNKS; i++)
+    {
+        free(broadphase->chunkPairs[i].pairs);
+    }
+    *broadphase = (broadphase_t){0};
+}
+
+// picks the cell size from the current size distribution so that a typical body covers at most 2x2 cells
+real_t GetBroadphaseCellSize(const bounds_t *bounds, int count)
+{
+    double extentSum = 0; // a float sum over a million bodies would drift
+    for (int i = 0; i < count; i++)
+    {
+        extentSum += (double)fmax(bounds[i].maxX - bounds[i].minX, bounds[i].maxY - bounds[i].minY);
+    }
+    real_t cellSize = count > 0 ? (real_t)((double)broadphaseCellScale * extentSum / count) : 1;
+    return cellSize > (real_t)1e-6 ? cellSize : 1;
+}
+
+int GetGridCell(real_t coordinate, real_t cellSize)
+{
+    return (int)floor(coordinate / cellSize);
+}
+
+unsigned int GetGridBucket(int cellX, int cellY, int bucketCount)
+{
+    return ((unsigned int)cellX * 73856093u ^ (unsigned int)cellY * 19349663u) & (unsigned int)(bucketCount - 1);
+}
+
+// finds the overlapping pairs inside one chunk of buckets
+void FindBroadphasePairsTask(void *context, int begin, int end)
+{
+    broadphase_t *broadphase = context;
+    const bounds_t *bounds = broadphase->bounds;
+    real_t cellSize = broadphase->cellSize;
+    for (int chunk = begin; chunk < end; chunk++)
+    {
+        pairs_list_t *pairs = &broadphase->chunkPairs[chunk];
+        pairs->pointer = 0;
+        int firstBucket = (int)((long long)broadphase->bucketCount * chunk / BROADPHASE_CHUNKS);
+        int lastBucket = (int)((long long)broadphase->bucketCount * (chunk + 1) / BROADPHASE_CHUNKS);
+        for (int bucket = firstBucket; bucket < lastBucket; bucket++)
+        {
+            int bucketEnd = broadphase->bucketStarts[bucket + 1];
+            for (int i = broadphase->bucketStarts[bucket]; i < bucketEnd - 1; i++)
+            {
+                grid_entry_t entry1 = broadphase->sortedEntries[i];
+                for (int j = i + 1; j < bucketEnd; j++)
+                {
+                    grid_entry_t entry2 = broadphase->sortedEntries[j];
+                    // different cells can share a bucket
+                    if (entry1.cellX != entry2.cellX || entry1.cellY != entry2.cellY)
+                    {
+                        continue;
+                    }
+                    // two sleeping bodies stay where they are, nothing to solve
+                    if (broadphase->awake[entry1.body] == 0 && broadphase->awake[entry2.body] == 0)
+                    {
+                        continue;
+                    }
+                    bounds_t bounds1 = bounds[entry1.body];
+                    bounds_t bounds2 = bounds[entry2.body];
+                    if (!CheckBoundsOverlap(bounds1, bounds2))
+                    {
+                        continue;
+                    }
+                    // a pair can share several cells, only report it from the cell holding the corner of the overlap
+                    if (GetGridCell(fmax(bounds1.minX, bounds2.minX), cellSize) != entry1.cellX ||
+                        GetGridCell(fmax(bounds1.minY, bounds2.minY), cellSize) != entry1.cellY)
+                    {
+                        continue;
+                    }
+                    HandleAddingPairToList(pairs, entry1.body, entry2.body);
+                }
+            }
+        }
+    }
+}
+
+// fills broadphase->pairs with every pair of overlapping bounds, each pair reported exactly once
+// the order of the pairs doesn't depend on how many threads the pool has
+void FindBroadphasePairs(broadphase_t *broadphase, int count, thread_pool_t *pool)
+{
+    const bounds_t *bounds = broadphase->bounds;
+    broadphase->pairs.pointer = 0;
+    if (count < 2)
+    {
+        return;
+    }
+    real_t cellSize = GetBroadphaseCellSize(bounds, count);
+    broadphase->cellSize = cellSize;
+
+    int entriesCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int cellsX = GetGridCell(bounds[i].maxX, cellSize) - GetGridCell(bounds[i].minX, cellSize) + 1;
+        int cellsY = GetGridCell(bounds[i].maxY, cellSize) - GetGridCell(bounds[i].minY, cellSize) + 1;
+        entriesCount += cellsX * cellsY;
+    }
+    EnsureBroadphaseEntriesSize(broadphase, entriesCount);
+
+    int bucketCount = broadphaseMinBuckets;
+    while (bucketCount < entriesCount * 2)
+    {
+        bucketCount *= 2;
+    }
+    if (bucketCount != broadphase->bucketCount)
+    {
+        broadphase->bucketCount = bucketCount;
+        broadphase->bucketStarts = realloc(broadphase->bucketStarts, sizeof(int) * (bucketCount + 1));
+    }
+    int *bucketStarts = broadphase->bucketStarts;
+    for (int i = 0; i <= bucketCount; i++)
+    {
+        bucketStarts[i] = 0;
+    }
+
+    // insert every body into all the cells its bounds touch
+    int entry = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int minCellX = GetGridCell(bounds[i].minX, cellSize);
+        int maxCellX = GetGridCell(bounds[i].maxX, cellSize);
+        int minCellY = GetGridCell(bounds[i].minY, cellSize);
+        int maxCellY = GetGridCell(bounds[i].maxY, cellSize);
+        for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+        {
+            for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+            {
+                broadphase->entries[entry] = (grid_entry_t){cellX, cellY, i};
+                bucketStarts[GetGridBucket(cellX, cellY, bucketCount) + 1] += 1;
+                entry++;
+            }
+        }
+    }
+
+    // counting sort by bucket, stable so bodies stay in index order inside a bucket
+    for (int i = 0; i < bucketCount; i++)
+    {
+        bucketStarts[i + 1] += bucketStarts[i];
+    }
+    for (int i = 0; i < entriesCount; i++)
+    {
+        grid_entry_t current = broadphase->entries[i];
+        broadphase->sortedEntries[bucketStarts[GetGridBucket(current.cellX, current.cellY, bucketCount)]++] = current;
+    }
+    for (int i = bucketCount; i > 0; i--)
+    {
+        bucketStarts[i] = bucketStarts[i - 1];
+    }
+    bucketStarts[0] = 0;
+
+    ParallelFor(pool, BROADPHASE_CHUNKS, 1, FindBroadphasePairsTask, broadphase);
+    for (int chunk = 0; chunk < BROADPHASE_CHUNKS; chunk++)
+    {
+        pairs_list_t *chunkPairs = &broadphase->chunkPairs[chunk];
+        while (broadphase->pairs.max < broadphase->pairs.pointer + chunkPairs->pointer)
+        {
+            IncreasePairsListSize(&broadphase->pairs);
+        }
+        memcpy(&broadphase->pairs.pairs[broadphase->pairs.pointer], chunkPairs->pairs, sizeof(pair_t) * chunkPairs->pointer);
+        broadphase->pairs.pointer += chunkPairs->pointer;
+    }
+}
+
+typedef struct gravity_task_t
+{
+    shapes_t *shapes;
+    real_t amount;
+} gravity_task_t;
+
+void GravityKernel(void *context, int begin, int end)
+{
+    gravity_task_t *task = context;
+    // sleeping shapes in an awake block must not pick up speed
+    physicsKernels->addScaledToArray(&task->shapes->velocityY[begin], task->amount, &task->shapes->awake[begin], end - begin);
+}
+
+void GravityTask(void *context, int begin, int end)
+{
+    gravity_task_t *task = context;
+    RunOnAwakeBlocks(task->shapes, begin, end, GravityKernel, task);
+}
+
+void Gravity(world_t *world, real_t deltaTime)
+{
+    gravity_task_t ballsTask = {&world->balls.base, world->params.gravity * deltaTime};
+    gravity_task_t rectsTask = {&world->rects.base, world->params.gravity * deltaTime};
+    ParallelFor(world->pool, world->balls.pointer, integrationGrain, GravityTask, &ballsTask);
+    ParallelFor(world->pool, world->rects.pointer, integrationGrain, GravityTask, &rectsTask);
+}
+
+// begin is always at the start of a block, the query tree catches up with these blocks before its next query
+void MarkBlocksMoved(shapes_t *shapes, int begin, int end)
+{
+    memset(&shapes->blockMoved[begin / SLEEP_BLOCK_SIZE], 1, (end - begin + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE);
+}
+
+typedef struct move_task_t
+{
+    balls_list_t *balls;
+    rects_list_t *rects;
+    real_t deltaTime;
+} move_task_t;
+
+// sleeping shapes have no velocity so running over them changes nothing, the block check just saves the work
+void MoveBallsKernel(void *context, int begin, int end)
+{
+    move_task_t *task = context;
+    balls_list_t *balls = task->balls;
+    physicsKernels->addScaledToArray(&balls->base.positionX[begin], task->deltaTime, &balls->base.velocityX[begin], end - begin);
+    physicsKernels->addScaledToArray(&balls->base.positionY[begin], task->deltaTime, &balls->base.velocityY[begin], end - begin);
+    MarkBlocksMoved(&balls->base, begin, end);
+}
+
+void MoveBallsTask(void *context, int begin, int end)
+{
+    move_task_t *task = context;
+    RunOnAwakeBlocks(&task->balls->base, begin, end, MoveBallsKernel, task);
+}
+
+void MoveRectsKernel(void *context, int begin, int end)
+{
+    move_task_t *task = context;
+    rects_list_t *rects = task->rects;
+    physicsKernels->addScaledToArray(&rects->base.positionX[begin], task->deltaTime, &rects->base.velocityX[begin], end - begin);
+    physicsKernels->addScaledToArray(&rects->base.positionY[begin], task->deltaTime, &rects->base.velocityY[begin], end - begin);
+    physicsKernels->addScaledToArray(&rects->base.radian[begin], task->deltaTime, &rects->base.spinningVelocity[begin], end - begin);
+    MarkBlocksMoved(&rects->base, begin, end);
+    // refreshed right where the rects turn, so the cached values are current between steps too
+    // sleeping rects don't turn, theirs stay valid
+    for (int i = begin; i < end; i++)
+    {
+        rects->cosRadian[i] = cos(rects->base.radian[i]);
+        rects->sinRadian[i] = sin(rects->base.radian[i]);
+    }
+}
+
+void MoveRectsTask(void *context, int begin, int end)
+{
+    move_task_t *task = context;
+    RunOnAwakeBlocks(&task->rects->base, begin, end, MoveRectsKernel, task);
+}
+
+void MoveShapes(world_t *world, real_t deltaTime)
+{
+    move_task_t task = {&world->balls, &world->rects, deltaTime};
+    ParallelFor(world->pool, world->balls.pointer, integrationGrain, MoveBallsTask, &task);
+    ParallelFor(world->pool, world->rects.pointer, integrationGrain, MoveRectsTask, &task);
+}
+
+VReal_t GetRectCenter(rect_t rect)
+{
+    return (VReal_t){rect.base.position.x + (rect.size.x / 2), rect.base.position.y + (rect.size.y / 2)};
+}
+
+real_t GetDotProduct(VReal_t vector1, VReal_t vector2)
+{
+    return vector1.x * vector2.x + vector1.y * vector2.y;
+}
+
+real_t GetCrossProduct(VReal_t vector1, VReal_t vector2)
+{
+    return vector1.x * vector2.y - vector1.y * vector2.x;
+}
+
+VReal_t GetScaledSum(VReal_t vector1, VReal_t vector2, real_t scale)
+{
+    return (VReal_t){vector1.x + vector2.x * scale, vector1.y + vector2.y * scale};
+}
+
+// a rect in world space, the axes are its turned x and y axis
+typedef struct box_t
+{
+    VReal_t center;
+    VReal_t axisX;
+    VReal_t axisY;
+    VReal_t halfSize;
+} box_t;
+
+box_t GetRectBox(const rects_list_t *rects, int index)
+{
+    real_t halfX = rects->sizeX[index] / 2;
+    real_t halfY = rects->sizeY[index] / 2;
+    real_t cosRadian = rects->cosRadian[index];
+    real_t sinRadian = rects->sinRadian[index];
+    return (box_t){(VReal_t){rects->base.positionX[index] + halfX, rects->base.positionY[index] + halfY},
+                   (VReal_t){cosRadian, sinRadian},
+                   (VReal_t){-sinRadian, cosRadian},
+                   (VReal_t){halfX, halfY}};
+}
+
+manifold_t GetBallBallManifold(VReal_t center1, real_t radius1, VReal_t center2, real_t radius2)
+{
+    manifold_t manifold = {0};
+    VReal_t offset = {center1.x - center2.x, center1.y - center2.y};
+    real_t distanceSquared = GetDotProduct(offset, offset);
+    real_t radiusSum = radius1 + radius2;
+    if (distanceSquared > radiusSum * radiusSum)
+    {
+        return manifold;
+    }
+    real_t distance = sqrt(distanceSquared);
+    // balls on top of each other have no direction, any one works
+    manifold.normal = distance > (real_t)1e-9 ? (VReal_t){offset.x / distance, offset.y / distance} : (VReal_t){1, 0};
+    manifold.penetrations[0] = radiusSum - distance;
+    // halfway between the two surfaces
+    manifold.points[0] = GetScaledSum(center2, manifold.normal, radius2 - manifold.penetrations[0] / 2);
+    manifold.pointsCount = 1;
+    return manifold;
+}
+
+// the normal points from the box towards the ball
+manifold_t GetBallBoxManifold(VReal_t center, real_t radius, box_t box)
+{
+    manifold_t manifold = {0};
+    VReal_t offset = {center.x - box.center.x, center.y - box.center.y};
+    real_t localX = GetDotProduct(offset, box.axisX);
+    real_t localY = GetDotProduct(offset, box.axisY);
+    real_t closestX = fmin(fmax(localX, -box.halfSize.x), box.halfSize.x);
+    real_t closestY = fmin(fmax(localY, -box.halfSize.y), box.halfSize.y);
+    real_t distanceX = localX - closestX;
+    real_t distanceY = localY - closestY;
+    real_t distanceSquared = distanceX * distanceX + distanceY * distanceY;
+    if (distanceSquared > radius * radius)
+    {
+        return manifold;
+    }
+
+    VReal_t localNormal;
+    if (distanceSquared > (real_t)1e-18)
+    {
+        real_t distance = sqrt(distanceSquared);
+        localNormal = (VReal_t){distanceX / distance, distanceY / distance};
+        manifold.penetrations[0] = radius - distance;
+    }
+    else
+    {
+        // the center is inside the box, push it out through the nearest face
+        real_t faceDistanceX = box.halfSize.x - fabs(localX);
+        real_t faceDistanceY = box.halfSize.y - fabs(localY);
+        if (faceDistanceX < faceDistanceY)
+        {
+            localNormal = (VReal_t){localX < 0 ? -1 : 1, 0};
+            closestX = localNormal.x * box.halfSize.x;
+            manifold.penetrations[0] = radius + faceDistanceX;
+        }
+        else
+        {
+            localNormal = (VReal_t){0, localY < 0 ? -1 : 1};
+            closestY = localNormal.y * box.halfSize.y;
+            manifold.penetrations[0] = radius + faceDistanceY;
+        }
+    }
+    manifold.normal = GetScaledSum((VReal_t){box.axisX.x * localNormal.x, box.axisX.y * localNormal.x}, box.axisY, localNormal.y);
+    manifold.points[0] = GetScaledSum(GetScaledSum(box.center, box.axisX, closestX), box.axisY, closestY);
+    manifold.pointsCount = 1;
+    return manifold;
+}
+
+// how far apart the boxes are along one face normal of the first one, negative when they overlap on it
+real_t GetBoxFaceSeparation(box_t other, VReal_t axis, real_t halfSize, VReal_t offset)
+{
+    real_t otherRadius = fabs(GetDotProduct(other.axisX, axis)) * other.halfSize.x + fabs(GetDotProduct(other.axisY, axis)) * other.halfSize.y;
+    return fabs(GetDotProduct(offset, axis)) - halfSize - otherRadius;
+}
+
+// keeps the part of the segment where dot(point, direction) <= limit
+bool ClipSegment(VReal_t points[2], VReal_t direction, real_t limit)
+{
+    real_t distance0 = GetDotProduct(points[0], direction) - limit;
+    real_t distance1 = GetDotProduct(points[1], direction) - limit;
+    if (distance0 > 0 && distance1 > 0)
+    {
+        return false;
+    }
+    VReal_t along = {points[1].x - points[0].x, points[1].y - points[0].y};
+    if (distance0 > 0)
+    {
+        points[0] = GetScaledSum(points[0], along, distance0 / (distance0 - distance1));
+    }
+    else if (distance1 > 0)
+    {
+        points[1] = GetScaledSum(points[0], along, distance0 / (distance0 - distance1));
+    }
+    return true;
+}
+
+// separating axis test over the 4 face normals, the face with the least penetration becomes the reference face
+// and the most opposing face of the other box is clipped against its sides, what stays below it are the contact points
+manifold_t GetBoxBoxManifold(box_t box1, box_t box2)
+{
+    manifold_t manifold = {0};
+    box_t boxes[2] = {box1, box2};
+    VReal_t offset = {box2.center.x - box1.center.x, box2.center.y - box1.center.y};
+    real_t bestSeparation = -INFINITY;
+    int referenceBox = 0;
+    int referenceAxis = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        box_t reference = boxes[i / 2];
+        VReal_t axis = i % 2 == 0 ? reference.axisX : reference.axisY;
+        real_t halfSize = i % 2 == 0 ? reference.halfSize.x : reference.halfSize.y;
+        real_t separation = GetBoxFaceSeparation(boxes[1 - i / 2], axis, halfSize, offset);
+        if (separation > 0)
+        {
+            return manifold;
+        }
+        // later axes have to be clearly better, so the reference face doesn't flip between steps on near ties
+        if (i == 0 || separation > boxFaceTolerance * bestSeparation + boxFaceAbsoluteTolerance * halfSize)
+        {
+            bestSeparation = separation;
+            referenceBox = i / 2;
+            referenceAxis = i % 2;
+        }
+    }
+
+    box_t reference = boxes[referenceBox];
+    box_t incident = boxes[1 - referenceBox];
+    VReal_t normal = referenceAxis == 0 ? reference.axisX : reference.axisY;
+    VReal_t tangent = referenceAxis == 0 ? reference.axisY : reference.axisX;
+    real_t normalHalfSize = referenceAxis == 0 ? reference.halfSize.x : reference.halfSize.y;
+    real_t tangentHalfSize = referenceAxis == 0 ? reference.halfSize.y : reference.halfSize.x;
+    VReal_t referenceToIncident = {incident.center.x - reference.center.x, incident.center.y - reference.center.y};
+    if (GetDotProduct(referenceToIncident, normal) < 0)
+    {
+        normal = (VReal_t){-normal.x, -normal.y};
+    }
+
+    // the incident face is the one whose normal points most against the reference normal
+    real_t dotX = GetDotProduct(incident.axisX, normal);
+    real_t dotY = GetDotProduct(incident.axisY, normal);
+    bool incidentOnX = fabs(dotX) > fabs(dotY);
+    VReal_t incidentNormal = incidentOnX ? incident.axisX : incident.axisY;
+    real_t incidentSign = (incidentOnX ? dotX : dotY) > 0 ? -1 : 1;
+    VReal_t incidentTangent = incidentOnX ? incident.axisY : incident.axisX;
+    real_t incidentNormalHalfSize = incidentOnX ? incident.halfSize.x : incident.halfSize.y;
+    real_t incidentTangentHalfSize = incidentOnX ? incident.halfSize.y : incident.halfSize.x;
+    VReal_t faceCenter = GetScaledSum(incident.center, incidentNormal, incidentSign * incidentNormalHalfSize);
+    VReal_t points[2] = {GetScaledSum(faceCenter, incidentTangent, incidentTangentHalfSize),
+                        GetScaledSum(faceCenter, incidentTangent, -incidentTangentHalfSize)};
+
+    real_t referenceTangent = GetDotProduct(reference.center, tangent);
+    if (!ClipSegment(points, tangent, referenceTangent + tangentHalfSize) ||
+        !ClipSegment(points, (VReal_t){-tangent.x, -tangent.y}, -referenceTangent + tangentHalfSize))
+    {
+        return manifold;
+    }
+    real_t referenceFace = GetDotProduct(reference.center, normal) + normalHalfSize;
+    for (int i = 0; i < 2; i++)
+    {
+        real_t separation = GetDotProduct(points[i], normal) - referenceFace;
+        if (separation <= 0)
+        {
+            manifold.points[manifold.pointsCount] = points[i];
+            manifold.penetrations[manifold.pointsCount] = -separation;
+            manifold.pointsCount++;
+        }
+    }
+    // normal points from the reference box to the incident one, the manifold wants it towards box1
+    manifold.normal = referenceBox == 0 ? (VReal_t){-normal.x, -normal.y} : normal;
+    return manifold;
+}
+
+// balls and rects share one index space here, balls first
+VReal_t GetBodyCenter(const world_t *world, int body)
+{
+    if (body < world->balls.pointer)
+    {
+        return (VReal_t){world->balls.base.positionX[body], world->balls.base.positionY[body]};
+    }
+    return GetRectCenter(GetRect(&world->rects, body - world->balls.pointer));
+}
+
+manifold_t GetPairManifold(const world_t *world, pair_t pair)
+{
+    const balls_list_t *balls = &world->balls;
+    int ballsCount = balls->pointer;
+    if (pair.second < ballsCount)
+    {
+        return GetBallBallManifold(GetBodyCenter(world, pair.first), balls->radius[pair.first], GetBodyCenter(world, pair.second), balls->radius[pair.second]);
+    }
+    if (pair.first >= ballsCount)
+    {
+        return GetBoxBoxManifold(GetRectBox(&world->rects, pair.first - ballsCount), GetRectBox(&world->rects, pair.second - ballsCount));
+    }
+    // the lower index is always the ball
+    return GetBallBoxManifold(GetBodyCenter(world, pair.first), balls->radius[pair.first], GetRectBox(&world->rects, pair.second - ballsCount));
+}
+
+// restitution between two bodies, anything with a rect in it loses energy
+real_t GetPairRestitution(const world_t *world, pair_t pair)
+{
+    return pair.second < world->balls.pointer ? world->params.ballRestitution : world->params.rectRestitution;
+}
+
+// the body's kind in the top bit and its handle slot below it, unlike its index it stays the same while bodies come and go
+unsigned int GetContactBodyKey(const world_t *world, int body)
+{
+    int ballsCount = world->balls.pointer;
+    return body < ballsCount ? (unsigned int)world->balls.base.slot[body] : 1u << 31 | (unsigned int)world->rects.base.slot[body - ballsCount];
+}
+
+unsigned long long GetContactKey(const world_t *world, int body1, int body2)
+{
+    unsigned long long key1 = GetContactBodyKey(world, body1);
+    unsigned long long key2 = GetContactBodyKey(world, body2);
+    unsigned long long low = key1 < key2 ? key1 : key2;
+    unsigned long long high = key1 < key2 ? key2 : key1;
+    // + 1 so no key is ever 0
+    return (low + 1) << 32 | high;
+}
+
+int GetContactCacheSlot(const contact_cache_t *cache, unsigned long long key)
+{
+    unsigned int mask = (unsigned int)cache->capacity - 1;
+    unsigned int slot = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (cache->keys[slot] != 0 && cache->keys[slot] != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return (int)slot;
+}
+
+// last step's impulses for the pair, 0 when it wasn't touching back then
+bool FindCachedContact(const contact_cache_t *cache, unsigned long long key, real_t normalImpulses[MAX_CONTACT_POINTS])
+{
+    int slot = cache->count > 0 ? GetContactCacheSlot(cache, key) : 0;
+    bool found = cache->count > 0 && cache->keys[slot] == key;
+    for (int i = 0; i < MAX_CONTACT_POINTS; i++)
+    {
+        normalImpulses[i] = found ? cache->normalImpulses[slot * MAX_CONTACT_POINTS + i] : 0;
+    }
+    return found;
+}
+
+void ClearContactCache(contact_cache_t *cache)
+{
+    if (cache->count > 0)
+    {
+        memset(cache->keys, 0, sizeof(unsigned long long) * cache->capacity);
+    }
+    cache->count = 0;
+}
+
+// keeps the table at most half full so probes stay short
+void EnsureContactCacheSize(contact_cache_t *cache, int count)
+{
+    if (count * 2 <= cache->capacity)
+    {
+        return;
+    }
+    contact_cache_t oldCache = *cache;
+    cache->capacity = cache->capacity > 0 ? cache->capacity : listStartMax;
+    while (count * 2 > cache->capacity)
+    {
+        cache->capacity *= 2;
+    }
+    cache->keys = calloc(cache->capacity, sizeof(unsigned long long));
+    cache->normalImpulses = malloc(sizeof(real_t) * cache->capacity * MAX_CONTACT_POINTS);
+    for (int i = 0; i < oldCache.capacity; i++)
+    {
+        if (oldCache.keys[i] != 0)
+        {
+            int slot = GetContactCacheSlot(cache, oldCache.keys[i]);
+            cache->keys[slot] = oldCache.keys[i];
+            memcpy(&cache->normalImpulses[slot * MAX_CONTACT_POINTS], &oldCache.normalImpulses[i * MAX_CONTACT_POINTS], sizeof(real_t) * MAX_CONTACT_POINTS);
+        }
+    }
+    free(oldCache.keys);
+    free(oldCache.normalImpulses);
+}
+
+void SetCachedContact(contact_cache_t *cache, unsigned long long key, const real_t normalImpulses[MAX_CONTACT_POINTS])
+{
+    EnsureContactCacheSize(cache, cache->count + 1);
+    int slot = GetContactCacheSlot(cache, key);
+    if (cache->keys[slot] == 0)
+    {
+        cache->keys[slot] = key;
+        cache->count++;
+    }
+    memcpy(&cache->normalImpulses[slot * MAX_CONTACT_POINTS], normalImpulses, sizeof(real_t) * MAX_CONTACT_POINTS);
+}
+
+// empties the table and gives it exactly capacity slots, a restored cache needs the capacity it was saved with to hash the same
+void SetContactCacheCapacity(contact_cache_t *cache, int capacity)
+{
+    if (cache->capacity != capacity)
+    {
+        free(cache->keys);
+        free(cache->normalImpulses);
+        cache->keys = malloc(sizeof(unsigned long long) * capacity);
+        cache->normalImpulses = malloc(sizeof(real_t) * capacity * MAX_CONTACT_POINTS);
+        cache->capacity = capacity;
+    }
+    memset(cache->keys, 0, sizeof(unsigned long long) * capacity);
+    cache->count = 0;
+}
+
+void FreeContactCache(contact_cache_t *cache)
+{
+    free(cache->keys);
+    free(cache->normalImpulses);
+    *cache = (contact_cache_t){0};
+}
+
+void EnsureContactsSize(contacts_list_t *contacts, int count)
+{
+    if (count <= contacts->max)
+    {
+        return;
+    }
+    while (contacts->max < count)
+    {
+        contacts->max = contacts->max > 0 ? contacts->max * 2 : listStartMax;
+    }
+    contacts->body1 = realloc(contacts->body1, sizeof(int) * contacts->max);
+    contacts->body2 = realloc(contacts->body2, sizeof(int) * contacts->max);
+    contacts->normalX = realloc(contacts->normalX, sizeof(real_t) * contacts->max);
+    contacts->normalY = realloc(contacts->normalY, sizeof(real_t) * contacts->max);
+    contacts->pointsCount = realloc(contacts->pointsCount, sizeof(int) * contacts->max);
+    for (int i = 0; i < MAX_CONTACT_POINTS; i++)
+    {
+        contacts->penetration[i] = realloc(contacts->penetration[i], sizeof(real_t) * contacts->max);
+        contacts->armCross1[i] = realloc(contacts->armCross1[i], sizeof(real_t) * contacts->max);
+        contacts->armCross2[i] = realloc(contacts->armCross2[i], sizeof(real_t) * contacts->max);
+        contacts->bounceVelocity[i] = realloc(contacts->bounceVelocity[i], sizeof(real_t) * contacts->max);
+        contacts->normalImpulse[i] = realloc(contacts->normalImpulse[i], sizeof(real_t) * contacts->max);
+        contacts->normalMass[i] = realloc(contacts->normalMass[i], sizeof(real_t) * contacts->max);
+    }
+}
+
+void FreeContacts(contacts_list_t *contacts)
+{
+    free(contacts->body1);
+    free(contacts->body2);
+    free(contacts->normalX);
+    free(contacts->normalY);
+    free(contacts->pointsCount);
+    for (int i = 0; i < MAX_CONTACT_POINTS; i++)
+    {
+        free(contacts->penetration[i]);
+        free(contacts->armCross1[i]);
+        free(contacts->armCross2[i]);
+        free(contacts->bounceVelocity[i]);
+        free(contacts->normalImpulse[i]);
+        free(contacts->normalMass[i]);
+    }
+    *contacts = (contacts_list_t){0};
+}
+
+void EnsureSolverBodiesSize(solver_bodies_t *bodies, int count)
+{
+    if (count <= bodies->max)
+    {
+        return;
+    }
+    while (bodies->max < count)
+    {
+        bodies->max = bodies->max > 0 ? bodies->max * 2 : listStartMax;
+    }
+    bodies->positionX = realloc(bodies->positionX, sizeof(real_t) * bodies->max);
+    bodies->positionY = realloc(bodies->positionY, sizeof(real_t) * bodies->max);
+    bodies->velocityX = realloc(bodies->velocityX, sizeof(real_t) * bodies->max);
+    bodies->velocityY = realloc(bodies->velocityY, sizeof(real_t) * bodies->max);
+    bodies->spinningVelocity = realloc(bodies->spinningVelocity, sizeof(real_t) * bodies->max);
+    bodies->inverseMass = realloc(bodies->inverseMass, sizeof(real_t) * bodies->max);
+    bodies->inverseInertia = realloc(bodies->inverseInertia, sizeof(real_t) * bodies->max);
+    bodies->awake = realloc(bodies->awake, sizeof(real_t) * bodies->max);
+}
+
+void FreeSolverBodies(solver_bodies_t *bodies)
+{
+    free(bodies->positionX);
+    free(bodies->positionY);
+    free(bodies->velocityX);
+    free(bodies->velocityY);
+    free(bodies->spinningVelocity);
+    free(bodies->inverseMass);
+    free(bodies->inverseInertia);
+    free(bodies->awake);
+    *bodies = (solver_bodies_t){0};
+}
+
+// copies the fields the solver changes between a shape list and its range of the solver bodies
+void CopySolverBodies(solver_bodies_t *bodies, shapes_t *shapes, int firstBody, int count, bool toSolver)
+{
+    real_t *solverArrays[] = {bodies->positionX, bodies->positionY, bodies->velocityX, bodies->velocityY, bodies->spinningVelocity, bodies->awake};
+    real_t *shapeArrays[] = {shapes->positionX, shapes->positionY, shapes->velocityX, shapes->velocityY, shapes->spinningVelocity, shapes->awake};
+    for (int i = 0; i < (int)(sizeof(solverArrays) / sizeof(solverArrays[0])); i++)
+    {
+        if (toSolver)
+        {
+            memcpy(&solverArrays[i][firstBody], shapeArrays[i], sizeof(real_t) * count);
+        }
+        else
+        {
+            memcpy(shapeArrays[i], &solverArrays[i][firstBody], sizeof(real_t) * count);
+        }
+    }
+}
+
+void GatherSolverBodies(world_t *world)
+{
+    solver_bodies_t *bodies = &world->solverBodies;
+    int ballsCount = world->balls.pointer;
+    EnsureSolverBodiesSize(bodies, ballsCount + world->rects.pointer);
+    CopySolverBodies(bodies, &world->balls.base, 0, ballsCount, true);
+    CopySolverBodies(bodies, &world->rects.base, ballsCount, world->rects.pointer, true);
+    for (int i = 0; i < ballsCount; i++)
+    {
+        bodies->inverseMass[i] = 1 / world->balls.base.mass[i];
+        bodies->inverseInertia[i] = 0;
+    }
+    for (int i = 0; i < world->rects.pointer; i++)
+    {
+        real_t mass = world->rects.base.mass[i];
+        real_t sizeX = world->rects.sizeX[i];
+        real_t sizeY = world->rects.sizeY[i];
+        bodies->inverseMass[ballsCount + i] = 1 / mass;
+        bodies->inverseInertia[ballsCount + i] = 12 / (mass * (sizeX * sizeX + sizeY * sizeY));
+    }
+}
+
+void ScatterSolverBodies(world_t *world)
+{
+    CopySolverBodies(&world->solverBodies, &world->balls.base, 0, world->balls.pointer, false);
+    CopySolverBodies(&world->solverBodies, &world->rects.base, world->balls.pointer, world->rects.pointer, false);
+}
+
+void EnsureBatchesSize(batches_t *batches, int pairsCount, int bodiesCount)
+{
+    if (pairsCount > batches->touchingMax)
+    {
+        batches->touchingMax = pairsCount;
+        batches->touching = realloc(batches->touching, sizeof(bool) * pairsCount);
+        batches->pairBatch = realloc(batches->pairBatch, sizeof(unsigned char) * pairsCount);
+        batches->candidates = realloc(batches->candidates, sizeof(int) * pairsCount);
+    }
+    if (bodiesCount > batches->bodyBatchesMax)
+    {
+        batches->bodyBatchesMax = bodiesCount;
+        batches->bodyBatches = realloc(batches->bodyBatches, sizeof(unsigned long long) * bodiesCount);
+    }
+}
+
+void FreeBatches(batches_t *batches)
+{
+    free(batches->touching);
+    free(batches->bodyBatches);
+    free(batches->pairBatch);
+    free(batches->candidates);
+    free(batches->pairs.pairs);
+    *batches = (batches_t){0};
+}
+
+// greedy graph coloring in broad phase order: every touching pair goes into the first batch neither of its bodies is in yet
+void BuildCollisionBatches(batches_t *batches, const pairs_list_t *candidates, int bodiesCount)
+{
+    memset(batches->bodyBatches, 0, sizeof(unsigned long long) * bodiesCount);
+    memset(batches->batchStarts, 0, sizeof(batches->batchStarts));
+    int touchingCount = 0;
+    for (int i = 0; i < candidates->pointer; i++)
+    {
+        if (!batches->touching[i])
+        {
+            continue;
+        }
+        pair_t pair = candidates->pairs[i];
+        unsigned long long used = batches->bodyBatches[pair.first] | batches->bodyBatches[pair.second];
+        int batch = used == ~0ULL ? MAX_BATCHES : __builtin_ctzll(~used);
+        if (batch < MAX_BATCHES)
+        {
+            batches->bodyBatches[pair.first] |= 1ULL << batch;
+            batches->bodyBatches[pair.second] |= 1ULL << batch;
+        }
+        batches->pairBatch[touchingCount++] = (unsigned char)batch;
+        batches->batchStarts[batch + 1]++;
+    }
+    for (int batch = 0; batch <= MAX_BATCHES; batch++)
+    {
+        batches->batchStarts[batch + 1] += batches->batchStarts[batch];
+    }
+
+    while (batches->pairs.max < touchingCount)
+    {
+        IncreasePairsListSize(&batches->pairs);
+    }
+    batches->pairs.pointer = touchingCount;
+    int batchNext[MAX_BATCHES + 1];
+    memcpy(batchNext, batches->batchStarts, sizeof(batchNext));
+    int touchingIndex = 0;
+    for (int i = 0; i < candidates->pointer; i++)
+    {
+        if (batches->touching[i])
+        {
+            int slot = batchNext[batches->pairBatch[touchingIndex++]]++;
+            batches->pairs.pairs[slot] = candidates->pairs[i];
+            batches->candidates[slot] = i;
+        }
+    }
+}
+
+typedef struct collision_task_t
+{
+    world_t *world;
+    int batchStart; // solver tasks get ranges relative to the batch they run over
+    atomic_int warmStarts;
+} collision_task_t;
+
+void FindManifoldsTask(void *context, int begin, int end)
+{
+    collision_task_t *task = context;
+    world_t *world = task->world;
+    for (int i = begin; i < end; i++)
+    {
+        world->manifolds[i] = GetPairManifold(world, world->broadphase.pairs.pairs[i]);
+        world->batches.touching[i] = world->manifolds[i].pointsCount > 0;
+    }
+}
+
+// turns the manifolds of the batched pairs into solver contacts, with last step's impulses to warm start from
+void PrepareContactsTask(void *context, int begin, int end)
+{
+    collision_task_t *task = context;
+    world_t *world = task->world;
+    const solver_bodies_t *bodies = &world->solverBodies;
+    contacts_list_t *contacts = &world->contacts;
+    int warmStarts = 0;
+    for (int i = begin; i < end; i++)
+    {
+        pair_t pair = world->batches.pairs.pairs[i];
+        const manifold_t *manifold = &world->manifolds[world->batches.candidates[i]];
+        int body1 = pair.first;
+        int body2 = pair.second;
+        VReal_t center1 = GetBodyCenter(world, body1);
+        VReal_t center2 = GetBodyCenter(world, body2);
+        real_t restitution = GetPairRestitution(world, pair);
+        real_t cachedImpulses[MAX_CONTACT_POINTS];
+        warmStarts += FindCachedContact(&world->previousContactCache, GetContactKey(world, body1, body2), cachedImpulses);
+
+        contacts->body1[i] = body1;
+        contacts->body2[i] = body2;
+        contacts->normalX[i] = manifold->normal.x;
+        contacts->normalY[i] = manifold->normal.y;
+        contacts->pointsCount[i] = manifold->pointsCount;
+        for (int point = 0; point < MAX_CONTACT_POINTS; point++)
+        {
+            if (point >= manifold->pointsCount)
+            {
+                contacts->penetration[point][i] = 0;
+                contacts->armCross1[point][i] = 0;
+                contacts->armCross2[point][i] = 0;
+                contacts->bounceVelocity[point][i] = 0;
+                contacts->normalImpulse[point][i] = 0;
+                contacts->normalMass[point][i] = 0;
+                continue;
+            }
+            VReal_t arm1 = {manifold->points[point].x - center1.x, manifold->points[point].y - center1.y};
+            VReal_t arm2 = {manifold->points[point].x - center2.x, manifold->points[point].y - center2.y};
+            real_t armCross1 = GetCrossProduct(arm1, manifold->normal);
+            real_t armCross2 = GetCrossProduct(arm2, manifold->normal);
+            // relative velocity of the two bodies at the point along the normal, negative while they approach
+            real_t normalVelocity = (bodies->velocityX[body1] - bodies->velocityX[body2]) * manifold->normal.x +
+                                    (bodies->velocityY[body1] - bodies->velocityY[body2]) * manifold->normal.y +
+                                    bodies->spinningVelocity[body1] * armCross1 - bodies->spinningVelocity[body2] * armCross2;
+            contacts->penetration[point][i] = manifold->penetrations[point];
+            contacts->armCross1[point][i] = armCross1;
+            contacts->armCross2[point][i] = armCross2;
+            // slow contacts don't bounce, otherwise resting bodies would never settle
+            contacts->bounceVelocity[point][i] = normalVelocity < -restitutionThreshold ? -restitution * normalVelocity : 0;
+            contacts->normalImpulse[point][i] = cachedImpulses[point];
+            contacts->normalMass[point][i] = 1 / (bodies->inverseMass[body1] + bodies->inverseMass[body2] +
+                                                  bodies->inverseInertia[body1] * armCross1 * armCross1 +
+                                                  bodies->inverseInertia[body2] * armCross2 * armCross2);
+        }
+        TRACE(TRACE_CONTACTS, TRACE_EVENT_CONTACT, body1, body2, manifold->penetrations[0], manifold->normal.x, manifold->normal.y);
+    }
+    atomic_fetch_add(&task->warmStarts, warmStarts);
+}
+
+// applies last step's impulses before the first iteration, so a resting contact starts out close to its answer
+void WarmStartContactsTask(void *context, int begin, int end)
+{
+    collision_task_t *task = context;
+    solver_bodies_t *bodies = &task->world->solverBodies;
+    contacts_list_t *contacts = &task->world->contacts;
+    for (int i = task->batchStart + begin; i < task->batchStart + end; i++)
+    {
+        for (int point = 0; point < contacts->pointsCount[i]; point++)
+        {
+            ApplyContactImpulse(bodies, contacts, i, point, contacts->normalImpulse[point][i]);
+        }
+        bodies->awake[contacts->body1[i]] = 1;
+        bodies->awake[contacts->body2[i]] = 1;
+    }
+}
+
+// one sequential impulse pass over a batch, see the solveContacts kernel
+void SolveContactsTask(void *context, int begin, int end)
+{
+    collision_task_t *task = context;
+    physicsKernels->solveContacts(&task->world->solverBodies, &task->world->contacts, task->batchStart + begin, task->batchStart + end);
+}
+
+// pushes the bodies out of each other once the velocities are solved, split by inverse mass
+// only the deepest point counts, correcting every point of a face contact would push it out twice
+void CorrectContactPositionsTask(void *context, int begin, int end)
+{
+    collision_task_t *task = context;
+    solver_bodies_t *bodies = &task->world->solverBodies;
+    contacts_list_t *contacts = &task->world->contacts;
+    for (int i = task->batchStart + begin; i < task->batchStart + end; i++)
+    {
+        int body1 = contacts->body1[i];
+        int body2 = contacts->body2[i];
+        real_t penetration = contacts->penetration[0][i];
+        for (int point = 1; point < MAX_CONTACT_POINTS; point++)
+        {
+            penetration = fmax(penetration, contacts->penetration[point][i]);
+        }
+        real_t correction = fmax(penetration - contactSlop, (real_t)0) * contactCorrection / (bodies->inverseMass[body1] + bodies->inverseMass[body2]);
+        bodies->positionX[body1] += contacts->normalX[i] * correction * bodies->inverseMass[body1];
+        bodies->positionY[body1] += contacts->normalY[i] * correction * bodies->inverseMass[body1];
+        bodies->positionX[body2] -= contacts->normalX[i] * correction * bodies->inverseMass[body2];
+        bodies->positionY[body2] -= contacts->normalY[i] * correction * bodies->inverseMass[body2];
+    }
+}
+
+// runs a solver task over every batch, batches one after another and the contacts inside one in parallel
+void RunContactBatches(world_t *world, collision_task_t *task, parallel_task_t solverTask)
+{
+    batches_t *batches = &world->batches;
+    for (int batch = 0; batch <= MAX_BATCHES; batch++)
+    {
+        task->batchStart = batches->batchStarts[batch];
+        int batchSize = batches->batchStarts[batch + 1] - task->batchStart;
+        if (batch == MAX_BATCHES)
+        {
+            // the overflow batch can share bodies, so it can't be split up, and neither can its lanes
+            for (int i = 0; i < batchSize; i++)
+            {
+                solverTask(task, i, i + 1);
+            }
+        }
+        else
+        {
+            ParallelFor(world->pool, batchSize, collisionGrain, solverTask, task);
+        }
+    }
+}
+
+void EnsureManifoldsSize(world_t *world, int count)
+{
+    if (count <= world->manifoldsMax)
+    {
+        return;
+    }
+    while (world->manifoldsMax < count)
+    {
+        world->manifoldsMax = world->manifoldsMax > 0 ? world->manifoldsMax * 2 : listStartMax;
+    }
+    world->manifolds = realloc(world->manifolds, sizeof(manifold_t) * world->manifoldsMax);
+}
+
+// touching pairs join their bodies into one island
+void SetIslandEdges(islands_t *islands, const pairs_list_t *pairs)
+{
+    while (islands->edges.max < pairs->pointer)
+    {
+        IncreasePairsListSize(&islands->edges);
+    }
+    memcpy(islands->edges.pairs, pairs->pairs, sizeof(pair_t) * pairs->pointer);
+    islands->edges.pointer = pairs->pointer;
+}
+
+// narrow phase over the broad phase pairs, then solves the touching ones batch after batch and caches their impulses
+void ResolveBroadphasePairs(world_t *world, int bodiesCount)
+{
+    broadphase_t *broadphase = &world->broadphase;
+    batches_t *batches = &world->batches;
+    contacts_list_t *contacts = &world->contacts;
+    world->stats.candidatePairs += broadphase->pairs.pointer;
+    EnsureBatchesSize(batches, broadphase->pairs.pointer, bodiesCount);
+    EnsureManifoldsSize(world, broadphase->pairs.pointer);
+
+    collision_task_t task = {.world = world};
+    atomic_init(&task.warmStarts, 0);
+    ParallelFor(world->pool, broadphase->pairs.pointer, collisionGrain, FindManifoldsTask, &task);
+    BuildCollisionBatches(batches, &broadphase->pairs, bodiesCount);
+    SetIslandEdges(&world->islands, &batches->pairs);
+
+    EnsureContactsSize(contacts, batches->pairs.pointer);
+    contacts->pointer = batches->pairs.pointer;
+    ParallelFor(world->pool, contacts->pointer, collisionGrain, PrepareContactsTask, &task);
+
+    RunContactBatches(world, &task, WarmStartContactsTask);
+    for (int i = 0; i < world->velocityIterations; i++)
+    {
+        RunContactBatches(world, &task, SolveContactsTask);
+    }
+    RunContactBatches(world, &task, CorrectContactPositionsTask);
+
+    for (int i = 0; i < contacts->pointer; i++)
+    {
+        real_t normalImpulses[MAX_CONTACT_POINTS];
+        for (int point = 0; point < MAX_CONTACT_POINTS; point++)
+        {
+            normalImpulses[point] = contacts->normalImpulse[point][i];
+        }
+        SetCachedContact(&world->contactCache, GetContactKey(world, contacts->body1[i], contacts->body2[i]), normalImpulses);
+    }
+    world->stats.collisions += contacts->pointer;
+    world->stats.warmStarts += atomic_load(&task.warmStarts);
+}
+
+bounds_t GetBallBounds(const balls_list_t *balls, int index)
+{
+    real_t x = balls->base.positionX[index];
+    real_t y = balls->base.positionY[index];
+    real_t radius = balls->radius[index];
+    return (bounds_t){x - radius, y - radius, x + radius, y + radius};
+}
+
+// bounds of the turned rect, around its center
+bounds_t GetRectBounds(const rects_list_t *rects, int index)
+{
+    box_t box = GetRectBox(rects, index);
+    real_t extentX = fabs(box.axisX.x) * box.halfSize.x + fabs(box.axisY.x) * box.halfSize.y;
+    real_t extentY = fabs(box.axisX.y) * box.halfSize.x + fabs(box.axisY.y) * box.halfSize.y;
+    return (bounds_t){box.center.x - extentX, box.center.y - extentY, box.center.x + extentX, box.center.y + extentY};
+}
+
+void FillBallBoundsTask(void *context, int begin, int end)
+{
+    world_t *world = context;
+    for (int i = begin; i < end; i++)
+    {
+        world->broadphase.bounds[i] = GetBallBounds(&world->balls, i);
+    }
+}
+
+void FillRectBoundsTask(void *context, int begin, int end)
+{
+    world_t *world = context;
+    bounds_t *bounds = &world->broadphase.bounds[world->balls.pointer];
+    for (int i = begin; i < end; i++)
+    {
+        bounds[i] = GetRectBounds(&world->rects, i);
+    }
+}
+
+typedef struct awake_blocks_task_t
+{
+    shapes_t *shapes;
+    int count;
+} awake_blocks_task_t;
+
+void UpdateAwakeBlocksTask(void *context, int begin, int end)
+{
+    awake_blocks_task_t *task = context;
+    for (int block = begin; block < end; block++)
+    {
+        int blockEnd = (block + 1) * SLEEP_BLOCK_SIZE < task->count ? (block + 1) * SLEEP_BLOCK_SIZE : task->count;
+        unsigned char blockAwake = 0;
+        for (int i = block * SLEEP_BLOCK_SIZE; i < blockEnd; i++)
+        {
+            blockAwake |= task->shapes->awake[i] != 0;
+        }
+        task->shapes->blockAwake[block] = blockAwake;
+    }
+}
+
+void UpdateAwakeBlocks(world_t *world)
+{
+    awake_blocks_task_t ballsTask = {&world->balls.base, world->balls.pointer};
+    awake_blocks_task_t rectsTask = {&world->rects.base, world->rects.pointer};
+    int ballBlocks = (world->balls.pointer + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE;
+    int rectBlocks = (world->rects.pointer + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE;
+    ParallelFor(world->pool, ballBlocks, integrationGrain / SLEEP_BLOCK_SIZE, UpdateAwakeBlocksTask, &ballsTask);
+    ParallelFor(world->pool, rectBlocks, integrationGrain / SLEEP_BLOCK_SIZE, UpdateAwakeBlocksTask, &rectsTask);
+}
+
+void HandleCollision(world_t *world)
+{
+    // last step's contacts become the warm start source, the other table is refilled by this step
+    contact_cache_t previousContactCache = world->previousContactCache;
+    world->previousContactCache = world->contactCache;
+    world->contactCache = previousContactCache;
+    ClearContactCache(&world->contactCache);
+
+    // bounds and the per step copies count towards the broad phase
+    uint64_t broadphaseStart = ProfileBegin();
+    int bodiesCount = world->balls.pointer + world->rects.pointer;
+    GatherSolverBodies(world);
+    EnsureBroadphaseBoundsSize(&world->broadphase, bodiesCount);
+    ParallelFor(world->pool, world->balls.pointer, integrationGrain, FillBallBoundsTask, world);
+    ParallelFor(world->pool, world->rects.pointer, integrationGrain, FillRectBoundsTask, world);
+    world->broadphase.awake = world->solverBodies.awake;
+    FindBroadphasePairs(&world->broadphase, bodiesCount, world->pool);
+    // without two bodies there is no grid
+    world->broadphase.gridBalls = bodiesCount >= 2 ? world->balls.pointer : -1;
+    world->broadphase.gridRects = world->rects.pointer;
+    ProfileEnd(&world->profile, PROFILE_PHASE_BROADPHASE, broadphaseStart);
+
+    uint64_t solveStart = ProfileBegin();
+    ResolveBroadphasePairs(world, bodiesCount);
+    ScatterSolverBodies(world);
+    // contacts may have woken shapes in blocks that were skipped so far
+    UpdateAwakeBlocks(world);
+    ProfileEnd(&world->profile, PROFILE_PHASE_SOLVE, solveStart);
+}
+
+void BallsWallCollisionKernel(void *context, int begin, int end)
+{
+    world_t *world = context;
+    balls_list_t *balls = &world->balls;
+    bounds_t map = world->mapBounds;
+    // balls are positioned by their center so the radius applies to both walls
+    physicsKernels->clampToWalls(&balls->base.positionX[begin], &balls->base.velocityX[begin], &balls->radius[begin], 1, map.minX, map.maxX, world->params.ballWallBounce, end - begin);
+    physicsKernels->clampToWalls(&balls->base.positionY[begin], &balls->base.velocityY[begin], &balls->radius[begin], 1, map.minY, map.maxY, world->params.ballWallBounce, end - begin);
+}
+
+void BallsWallCollisionTask(void *context, int begin, int end)
+{
+    world_t *world = context;
+    RunOnAwakeBlocks(&world->balls.base, begin, end, BallsWallCollisionKernel, world);
+}
+
+void RectsWallCollisionKernel(void *context, int begin, int end)
+{
+    world_t *world = context;
+    rects_list_t *rects = &world->rects;
+    bounds_t map = world->mapBounds;
+    // rects are positioned by their upper left corner so the size only matters for the far wall
+    physicsKernels->clampToWalls(&rects->base.positionX[begin], &rects->base.velocityX[begin], &rects->sizeX[begin], 0, map.minX, map.maxX, world->params.rectWallBounce, end - begin);
+    physicsKernels->clampToWalls(&rects->base.positionY[begin], &rects->base.velocityY[begin], &rects->sizeY[begin], 0, map.minY, map.maxY, world->params.rectWallBounce, end - begin);
+}
+
+void RectsWallCollisionTask(void *context, int begin, int end)
+{
+    world_t *world = context;
+    RunOnAwakeBlocks(&world->rects.base, begin, end, RectsWallCollisionKernel, world);
+}
+
+void HandleMapWallCollision(world_t *world)
+{
+    ParallelFor(world->pool, world->balls.pointer, integrationGrain, BallsWallCollisionTask, world);
+    ParallelFor(world->pool, world->rects.pointer, integrationGrain, RectsWallCollisionTask, world);
+}
+
+void EnsureIslandsSize(islands_t *islands, int count)
+{
+    if (count <= islands->max)
+    {
+        return;
+    }
+    islands->max = count;
+    islands->parent = realloc(islands->parent, sizeof(int) * count);
+    islands->islandSleepTime = realloc(islands->islandSleepTime, sizeof(real_t) * count);
+}
+
+void FreeIslands(islands_t *islands)
+{
+    free(islands->edges.pairs);
+    free(islands->parent);
+    free(islands->islandSleepTime);
+    *islands = (islands_t){0};
+}
+
+int FindIslandRoot(int *parent, int body)
+{
+    while (parent[body] != body)
+    {
+        // path halving
+        parent[body] = parent[parent[body]];
+        body = parent[body];
+    }
+    return body;
+}
+
+void JoinIslands(int *parent, int body1, int body2)
+{
+    int root1 = FindIslandRoot(parent, body1);
+    int root2 = FindIslandRoot(parent, body2);
+    // the lower index wins so the forest doesn't depend on edge direction
+    if (root1 < root2)
+    {
+        parent[root2] = root1;
+    }
+    else if (root2 < root1)
+    {
+        parent[root1] = root2;
+    }
+}
+
+typedef struct sleep_task_t
+{
+    shapes_t *shapes;
+    real_t deltaTime;
+} sleep_task_t;
+
+void UpdateSleepTimeTask(void *context, int begin, int end)
+{
+    sleep_task_t *task = context;
+    shapes_t *shapes = task->shapes;
+    for (int i = begin; i < end; i++)
+    {
+        if (shapes->awake[i] == 0)
+        {
+            continue;
+        }
+        real_t speedSquared = shapes->velocityX[i] * shapes->velocityX[i] + shapes->velocityY[i] * shapes->velocityY[i];
+        bool calm = speedSquared < sleepVelocity * sleepVelocity && fabs(shapes->spinningVelocity[i]) < sleepSpinningVelocity && !shapes->isGrabbed[i];
+        shapes->sleepTime[i] = calm ? shapes->sleepTime[i] + task->deltaTime : 0;
+    }
+}
+
+void PutShapeToSleep(shapes_t *shapes, int index)
+{
+    shapes->awake[index] = 0;
+    shapes->velocityX[index] = 0;
+    shapes->velocityY[index] = 0;
+    shapes->spinningVelocity[index] = 0;
+}
+
+// an island falls asleep once every awake body in it has been calm for timeToSleep, otherwise all of it wakes up
+void HandleSleeping(world_t *world, real_t deltaTime)
+{
+    islands_t *islands = &world->islands;
+    shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    int firstBodies[2] = {0, world->balls.pointer};
+    int bodiesCount = counts[0] + counts[1];
+    EnsureIslandsSize(islands, bodiesCount);
+
+    for (int list = 0; list < 2; list++)
+    {
+        sleep_task_t task = {lists[list], deltaTime};
+        ParallelFor(world->pool, counts[list], integrationGrain, UpdateSleepTimeTask, &task);
+    }
+
+    for (int i = 0; i < bodiesCount; i++)
+    {
+        islands->parent[i] = i;
+        // sleeping bodies don't hold their island awake
+        islands->islandSleepTime[i] = INFINITY;
+    }
+    for (int i = 0; i < islands->edges.pointer; i++)
+    {
+        JoinIslands(islands->parent, islands->edges.pairs[i].first, islands->edges.pairs[i].second);
+    }
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < counts[list]; i++)
+        {
+            if (lists[list]->awake[i] != 0)
+            {
+                int root = FindIslandRoot(islands->parent, i + firstBodies[list]);
+                islands->islandSleepTime[root] = fmin(islands->islandSleepTime[root], lists[list]->sleepTime[i]);
+            }
+        }
+    }
+
+    int awakeBodies = 0;
+    int fellAsleep = 0;
+    int wokeUp = 0;
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < counts[list]; i++)
+        {
+            int root = FindIslandRoot(islands->parent, i + firstBodies[list]);
+            if (islands->islandSleepTime[root] >= timeToSleep)
+            {
+                if (lists[list]->awake[i] != 0)
+                {
+                    PutShapeToSleep(lists[list], i);
+                    fellAsleep++;
+                }
+            }
+            else
+            {
+                wokeUp += lists[list]->awake[i] == 0;
+                lists[list]->awake[i] = 1;
+                awakeBodies++;
+            }
+        }
+    }
+    if (fellAsleep > 0 || wokeUp > 0)
+    {
+        TRACE(TRACE_SLEEP, TRACE_EVENT_SLEEP, fellAsleep, wokeUp, 0, 0, 0);
+    }
+    world->stats.awakeBodies = awakeBodies;
+    UpdateAwakeBlocks(world);
+}
+
+// tree items are the body's handle slot and kind, they don't change when removals move bodies to other indices
+int GetQueryTreeItem(body_kind_t kind, int slot)
+{
+    return slot * 2 + kind;
+}
+
+body_handle_t GetQueryTreeBody(const world_t *world, int item)
+{
+    body_kind_t kind = item & 1;
+    const body_slots_t *slots = kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    return (body_handle_t){kind, item >> 1, slots->generations[item >> 1]};
+}
+
+bounds_t GetFatBounds(bounds_t bounds, real_t velocityX, real_t velocityY)
+{
+    real_t margin = queryTreeMargin * fmax(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY);
+    bounds_t fat = {bounds.minX - margin, bounds.minY - margin, bounds.maxX + margin, bounds.maxY + margin};
+    real_t aheadX = velocityX * queryTreeLookahead;
+    real_t aheadY = velocityY * queryTreeLookahead;
+    fat.minX += aheadX < 0 ? aheadX : 0;
+    fat.maxX += aheadX > 0 ? aheadX : 0;
+    fat.minY += aheadY < 0 ? aheadY : 0;
+    fat.maxY += aheadY > 0 ? aheadY : 0;
+    return fat;
+}
+
+void InsertQueryTreeBody(world_t *world, body_kind_t kind, int index, bounds_t bounds)
+{
+    shapes_t *shapes = kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+    body_slots_t *slots = kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    int slot = shapes->slot[index];
+    bounds_t fat = GetFatBounds(bounds, shapes->velocityX[index], shapes->velocityY[index]);
+    slots->treeLeaves[slot] = AabbTreeInsert(&world->queryTree, fat, GetQueryTreeItem(kind, slot));
+}
+
+// new bodies get their leaf here, moved ones only get a new one once they left their fat bounds
+// the margin and lookahead make that rare
+void UpdateQueryTreeLeaf(world_t *world, body_kind_t kind, int index, bounds_t bounds)
+{
+    shapes_t *shapes = kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+    body_slots_t *slots = kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    int leaf = slots->treeLeaves[shapes->slot[index]];
+    if (leaf == AABB_TREE_NULL)
+    {
+        InsertQueryTreeBody(world, kind, index, bounds);
+    }
+    else if (!CheckBoundsContain(world->queryTree.nodes[leaf].bounds, bounds))
+    {
+        AabbTreeMove(&world->queryTree, leaf, GetFatBounds(bounds, shapes->velocityX[index], shapes->velocityY[index]));
+    }
+}
+
+// catches the tree up with the blocks that moved since it was last used
+void UpdateQueryTreeLeaves(world_t *world, body_kind_t kind)
+{
+    shapes_t *shapes = kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+    int count = kind == BODY_BALL ? world->balls.pointer : world->rects.pointer;
+    for (int block = 0; block * SLEEP_BLOCK_SIZE < count; block++)
+    {
+        if (shapes->blockMoved[block] == 0)
+        {
+            continue;
+        }
+        int blockEnd = (block + 1) * SLEEP_BLOCK_SIZE < count ? (block + 1) * SLEEP_BLOCK_SIZE : count;
+        for (int i = block * SLEEP_BLOCK_SIZE; i < blockEnd; i++)
+        {
+            bounds_t bounds = kind == BODY_BALL ? GetBallBounds(&world->balls, i) : GetRectBounds(&world->rects, i);
+            UpdateQueryTreeLeaf(world, kind, i, bounds);
+        }
+        shapes->blockMoved[block] = 0;
+    }
+}
+
+void ResetQueryTree(world_t *world)
+{
+    ClearAabbTree(&world->queryTree);
+    body_slots_t *slots[2] = {&world->balls.slots, &world->rects.slots};
+    shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < slots[list]->count; i++)
+        {
+            slots[list]->treeLeaves[i] = AABB_TREE_NULL;
+        }
+        memset(lists[list]->blockMoved, 1, (counts[list] + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE);
+    }
+    world->queryTreeStale = false;
+}
+
+// run before every query rather than every step, runs that never query never pay for the tree
+void UpdateQueryTree(world_t *world)
+{
+    if (world->queryTreeStale)
+    {
+        ResetQueryTree(world);
+    }
+    UpdateQueryTreeLeaves(world, BODY_BALL);
+    UpdateQueryTreeLeaves(world, BODY_RECT);
+}
+
+void EnsureContinuousSize(continuous_t *continuous, int bodiesCount)
+{
+    if (bodiesCount > continuous->fastIndicesMax)
+    {
+        continuous->fastIndicesMax = bodiesCount;
+        continuous->fastIndices = realloc(continuous->fastIndices, sizeof(int) * bodiesCount);
+    }
+}
+
+void AddFastBody(continuous_t *continuous, int body)
+{
+    if (continuous->count == continuous->max)
+    {
+        continuous->max = continuous->max > 0 ? continuous->max * 2 : listStartMax;
+        continuous->bodies = realloc(continuous->bodies, sizeof(int) * continuous->max);
+        continuous->impacts = realloc(continuous->impacts, sizeof(real_t) * continuous->max);
+    }
+    continuous->fastIndices[body] = continuous->count;
+    continuous->bodies[continuous->count] = body;
+    continuous->impacts[continuous->count] = 1;
+    continuous->count++;
+}
+
+void FreeContinuous(continuous_t *continuous)
+{
+    free(continuous->fastIndices);
+    free(continuous->bodies);
+    free(continuous->impacts);
+    FreeAabbTree(&continuous->tree);
+    *continuous = (continuous_t){0};
+}
+
+// a body as the sweep tests see it, its turning over the step is left out
+typedef struct swept_body_t
+{
+    bool isBall;
+    box_t box;     // halfSize is 0 for balls
+    real_t radius; // 0 for rects
+    VReal_t motion;
+} swept_body_t;
+
+// body is a solver body index, balls first and rects after them
+swept_body_t GetSweptBody(const world_t *world, int body)
+{
+    int ballsCount = world->balls.pointer;
+    if (body < ballsCount)
+    {
+        const shapes_t *shapes = &world->balls.base;
+        box_t box = {(VReal_t){shapes->positionX[body], shapes->positionY[body]}, (VReal_t){1, 0}, (VReal_t){0, 1}, (VReal_t){0, 0}};
+        VReal_t motion = {shapes->velocityX[body] * world->continuous.deltaTime, shapes->velocityY[body] * world->continuous.deltaTime};
+        return (swept_body_t){true, box, world->balls.radius[body], motion};
+    }
+    const shapes_t *shapes = &world->rects.base;
+    int index = body - ballsCount;
+    VReal_t motion = {shapes->velocityX[index] * world->continuous.deltaTime, shapes->velocityY[index] * world->continuous.deltaTime};
+    return (swept_body_t){false, GetRectBox(&world->rects, index), 0, motion};
+}
+
+// the body's bounds now and after this step's motion
+bounds_t GetSweptBounds(const world_t *world, int body)
+{
+    int ballsCount = world->balls.pointer;
+    const shapes_t *shapes = body < ballsCount ? &world->balls.base : &world->rects.base;
+    int index = body < ballsCount ? body : body - ballsCount;
+    bounds_t bounds = body < ballsCount ? GetBallBounds(&world->balls, index) : GetRectBounds(&world->rects, index);
+    real_t motionX = shapes->velocityX[index] * world->continuous.deltaTime;
+    real_t motionY = shapes->velocityY[index] * world->continuous.deltaTime;
+    bounds.minX += motionX < 0 ? motionX : 0;
+    bounds.maxX += motionX > 0 ? motionX : 0;
+    bounds.minY += motionY < 0 ? motionY : 0;
+    bounds.maxY += motionY > 0 ? motionY : 0;
+    return bounds;
+}
+
+// share of the motion after which a point moving from offset, relative to the circle's center, reaches the circle
+// false when it starts inside it, the narrow phase already has that pair, or doesn't get there within the step
+bool GetCircleImpact(VReal_t offset, VReal_t motion, real_t radius, real_t *impact)
+{
+    real_t startDistance = GetDotProduct(offset, offset) - radius * radius;
+    real_t along = GetDotProduct(offset, motion);
+    if (startDistance <= 0 || along >= 0)
+    {
+        return false;
+    }
+    real_t motionSquared = GetDotProduct(motion, motion);
+    real_t discriminant = along * along - motionSquared * startDistance;
+    if (discriminant < 0)
+    {
+        return false;
+    }
+    *impact = (-along - sqrt(discriminant)) / motionSquared;
+    return *impact <= 1;
+}
+
+// the ball's center against the box grown by the radius, whose corners are round
+bool GetBallBoxImpact(VReal_t center, real_t radius, box_t box, VReal_t motion, real_t *impact)
+{
+    VReal_t offset = {center.x - box.center.x, center.y - box.center.y};
+    VReal_t localOffset = {GetDotProduct(offset, box.axisX), GetDotProduct(offset, box.axisY)};
+    VReal_t localMotion = {GetDotProduct(motion, box.axisX), GetDotProduct(motion, box.axisY)};
+    bounds_t grown = {-box.halfSize.x - radius, -box.halfSize.y - radius, box.halfSize.x + radius, box.halfSize.y + radius};
+    int axis;
+    if (!GetRayBoundsFraction(grown, localOffset.x, localOffset.y, localMotion.x, localMotion.y, 1, impact, &axis))
+    {
+        return false;
+    }
+    VReal_t point = GetScaledSum(localOffset, localMotion, *impact);
+    if (fabs(point.x) <= box.halfSize.x || fabs(point.y) <= box.halfSize.y)
+    {
+        // next to a side, starting there means the ball already touches the box
+        return axis >= 0;
+    }
+    // in a corner square of the grown box only the round corner counts, missing it means missing the box
+    VReal_t corner = {point.x < 0 ? -box.halfSize.x : box.halfSize.x, point.y < 0 ? -box.halfSize.y : box.halfSize.y};
+    return GetCircleImpact((VReal_t){localOffset.x - corner.x, localOffset.y - corner.y}, localMotion, radius, impact);
+}
+
+// separating axis test over the step, the boxes touch once they overlap on the face normals of both
+bool GetBoxBoxImpact(box_t box1, box_t box2, VReal_t motion, real_t *impact)
+{
+    VReal_t offset = {box1.center.x - box2.center.x, box1.center.y - box2.center.y};
+    VReal_t axes[4] = {box1.axisX, box1.axisY, box2.axisX, box2.axisY};
+    real_t enter = 0;
+    real_t exit = 1;
+    bool separated = false;
+    for (int i = 0; i < 4; i++)
+    {
+        real_t radius = fabs(GetDotProduct(box1.axisX, axes[i])) * box1.halfSize.x + fabs(GetDotProduct(box1.axisY, axes[i])) * box1.halfSize.y +
+                        fabs(GetDotProduct(box2.axisX, axes[i])) * box2.halfSize.x + fabs(GetDotProduct(box2.axisY, axes[i])) * box2.halfSize.y;
+        real_t distance = GetDotProduct(offset, axes[i]);
+        real_t speed = GetDotProduct(motion, axes[i]);
+        // flipped so the distance is positive, the boxes overlap on the axis while distance + speed * t <= radius
+        if (distance < 0)
+        {
+            distance = -distance;
+            speed = -speed;
+        }
+        if (distance > radius)
+        {
+            if (speed >= 0)
+            {
+                return false;
+            }
+            separated = true;
+            enter = fmax(enter, (distance - radius) / -speed);
+        }
+        if (speed < 0)
+        {
+            exit = fmin(exit, (distance + radius) / -speed);
+        }
+        else if (speed > 0)
+        {
+            exit = fmin(exit, (radius - distance) / speed);
+        }
+    }
+    *impact = enter;
+    return separated && enter <= exit;
+}
+
+// body1 and body2 are shrunk by contactSlop, so the bodies end up that deep in each other and the next step's narrow phase sees them touch
+bool GetSweptImpact(swept_body_t body1, swept_body_t body2, real_t *impact)
+{
+    VReal_t motion = {body1.motion.x - body2.motion.x, body1.motion.y - body2.motion.y};
+    if (body1.isBall && body2.isBall)
+    {
+        VReal_t offset = {body1.box.center.x - body2.box.center.x, body1.box.center.y - body2.box.center.y};
+        return GetCircleImpact(offset, motion, body1.radius + body2.radius - contactSlop, impact);
+    }
+    if (body1.isBall)
+    {
+        return GetBallBoxImpact(body1.box.center, body1.radius - contactSlop, body2.box, motion, impact);
+    }
+    if (body2.isBall)
+    {
+        return GetBallBoxImpact(body2.box.center, body2.radius - contactSlop, body1.box, (VReal_t){-motion.x, -motion.y}, impact);
+    }
+    body1.box.halfSize = (VReal_t){body1.box.halfSize.x - contactSlop / 2, body1.box.halfSize.y - contactSlop / 2};
+    body2.box.halfSize = (VReal_t){body2.box.halfSize.x - contactSlop / 2, body2.box.halfSize.y - contactSlop / 2};
+    return GetBoxBoxImpact(body1.box, body2.box, motion, impact);
+}
+
+// adds the fast shapes of one list, sizes are radius and radius for balls, so halfSizeScale * the smaller one is the half size
+// returns how far the others move at most on each axis
+VReal_t FindFastShapes(continuous_t *continuous, const shapes_t *shapes, const real_t *sizeX, const real_t *sizeY, real_t halfSizeScale, int firstBody, int count)
+{
+    VReal_t slowMotion = {0, 0};
+    real_t scale = continuousMotionScale * halfSizeScale;
+    real_t deltaTime = continuous->deltaTime;
+    for (int block = 0; block * SLEEP_BLOCK_SIZE < count; block++)
+    {
+        // sleeping shapes don't move at all
+        if (shapes->blockAwake[block] == 0)
+        {
+            continue;
+        }
+        int blockEnd = (block + 1) * SLEEP_BLOCK_SIZE < count ? (block + 1) * SLEEP_BLOCK_SIZE : count;
+        for (int i = block * SLEEP_BLOCK_SIZE; i < blockEnd; i++)
+        {
+            real_t motionX = shapes->velocityX[i] * deltaTime;
+            real_t motionY = shapes->velocityY[i] * deltaTime;
+            real_t limit = scale * (sizeX[i] < sizeY[i] ? sizeX[i] : sizeY[i]);
+            if (motionX * motionX + motionY * motionY > limit * limit)
+            {
+                AddFastBody(continuous, firstBody + i);
+                continue;
+            }
+            motionX = fabs(motionX);
+            motionY = fabs(motionY);
+            slowMotion.x = motionX > slowMotion.x ? motionX : slowMotion.x;
+            slowMotion.y = motionY > slowMotion.y ? motionY : slowMotion.y;
+        }
+    }
+    return slowMotion;
+}
+
+// collects the bodies that move far enough to skip past something and returns how far the others move at most on each axis
+VReal_t FindFastBodies(world_t *world)
+{
+    continuous_t *continuous = &world->continuous;
+    int ballsCount = world->balls.pointer;
+    EnsureContinuousSize(continuous, ballsCount + world->rects.pointer);
+    memset(continuous->fastIndices, -1, sizeof(int) * (ballsCount + world->rects.pointer));
+    continuous->count = 0;
+    VReal_t ballsMotion = FindFastShapes(continuous, &world->balls.base, world->balls.radius, world->balls.radius, 1, 0, ballsCount);
+    VReal_t rectsMotion = FindFastShapes(continuous, &world->rects.base, world->rects.sizeX, world->rects.sizeY, 0.5, ballsCount, world->rects.pointer);
+    return (VReal_t){fmax(ballsMotion.x, rectsMotion.x), fmax(ballsMotion.y, rectsMotion.y)};
+}
+
+typedef struct continuous_query_t
+{
+    world_t *world;
+    int fastIndex; // of the body being swept
+    swept_body_t body;
+} continuous_query_t;
+
+void AddImpact(continuous_t *continuous, int fastIndex, real_t impact)
+{
+    continuous->impacts[fastIndex] = fmin(continuous->impacts[fastIndex], impact);
+}
+
+// items of the swept tree are fast indices, every pair is handled from its lower one
+bool SweepAgainstFastBody(void *context, int item)
+{
+    continuous_query_t *query = context;
+    continuous_t *continuous = &query->world->continuous;
+    real_t impact;
+    if (item > query->fastIndex && GetSweptImpact(query->body, GetSweptBody(query->world, continuous->bodies[item]), &impact))
+    {
+        AddImpact(continuous, query->fastIndex, impact);
+        AddImpact(continuous, item, impact);
+    }
+    return true;
+}
+
+// the slow bodies come from the broad phase grid this step already built, its bounds are from before the solver ran
+// region covers every cell a slow body could be in while meeting the swept one
+void SweepAgainstSlowBodies(world_t *world, const continuous_query_t *query, bounds_t region)
+{
+    const broadphase_t *broadphase = &world->broadphase;
+    real_t cellSize = broadphase->cellSize;
+    int minCellX = GetGridCell(region.minX, cellSize);
+    int maxCellX = GetGridCell(region.maxX, cellSize);
+    int minCellY = GetGridCell(region.minY, cellSize);
+    int maxCellY = GetGridCell(region.maxY, cellSize);
+    for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+    {
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+        {
+            unsigned int bucket = GetGridBucket(cellX, cellY, broadphase->bucketCount);
+            for (int i = broadphase->bucketStarts[bucket]; i < broadphase->bucketStarts[bucket + 1]; i++)
+            {
+                grid_entry_t entry = broadphase->sortedEntries[i];
+                // fast bodies, the swept one included, are paired up in the swept tree
+                if (entry.cellX != cellX || entry.cellY != cellY || world->continuous.fastIndices[entry.body] >= 0)
+                {
+                    continue;
+                }
+                bounds_t bounds = broadphase->bounds[entry.body];
+                // a body in several of the cells is only tested from the one holding the corner of the overlap
+                if (!CheckBoundsOverlap(bounds, region) || GetGridCell(fmax(bounds.minX, region.minX), cellSize) != cellX ||
+                    GetGridCell(fmax(bounds.minY, region.minY), cellSize) != cellY)
+                {
+                    continue;
+                }
+                real_t impact;
+                if (GetSweptImpact(query->body, GetSweptBody(world, entry.body), &impact))
+                {
+                    AddImpact(&world->continuous, query->fastIndex, impact);
+                }
+            }
+        }
+    }
+}
+
+// runs between Gravity and MoveShapes, on the velocities the bodies are about to move with
+// serial, a step rarely has more than a handful of fast bodies and one without any only pays for finding that out
+void HandleContinuousCollision(world_t *world, real_t deltaTime)
+{
+    continuous_t *continuous = &world->continuous;
+    continuous->deltaTime = deltaTime;
+    VReal_t slowMotion = FindFastBodies(world);
+    if (continuous->count == 0 || world->balls.pointer + world->rects.pointer < 2)
+    {
+        return;
+    }
+    ClearAabbTree(&continuous->tree);
+    for (int i = 0; i < continuous->count; i++)
+    {
+        AabbTreeInsert(&continuous->tree, GetSweptBounds(world, continuous->bodies[i]), i);
+    }
+    for (int i = 0; i < continuous->count; i++)
+    {
+        continuous_query_t query = {world, i, GetSweptBody(world, continuous->bodies[i])};
+        bounds_t bounds = GetSweptBounds(world, continuous->bodies[i]);
+        AabbTreeQuery(&continuous->tree, bounds, SweepAgainstFastBody, &query);
+        // a slow body moves at most slowMotion, so anything it could meet this one in starts within that of the swept bounds
+        bounds = (bounds_t){bounds.minX - slowMotion.x, bounds.minY - slowMotion.y, bounds.maxX + slowMotion.x, bounds.maxY + slowMotion.y};
+        SweepAgainstSlowBodies(world, &query, bounds);
+    }
+    // pulled back so MoveShapes only takes them as far as their first hit, they keep their velocity
+    // and the next step's narrow phase finds them touching what they hit and bounces them off it
+    int ballsCount = world->balls.pointer;
+    for (int i = 0; i < continuous->count; i++)
+    {
+        real_t impact = continuous->impacts[i];
+        if (impact >= 1)
+        {
+            continue;
+        }
+        int body = continuous->bodies[i];
+        shapes_t *shapes = body < ballsCount ? &world->balls.base : &world->rects.base;
+        int index = body < ballsCount ? body : body - ballsCount;
+        shapes->positionX[index] -= shapes->velocityX[index] * deltaTime * (1 - impact);
+        shapes->positionY[index] -= shapes->velocityY[index] * deltaTime * (1 - impact);
+        world->stats.impacts++;
+        TRACE(TRACE_CONTACTS, TRACE_EVENT_IMPACT, body, 0, impact, shapes->velocityX[index], shapes->velocityY[index]);
+    }
+    world->stats.sweptBodies += continuous->count;
+}
+
+world_params_t GetDefaultWorldParams(void)
+{
+    return (world_params_t){gravity, mapBoundraryCollisionBouce, mapBoundraryRectBounce, ballRestitution, rectRestitution};
+}
+
+world_t *WorldCreate(void)
+{
+    pthread_once(&physicsKernelsOnce, InitPhysicsKernels);
+    world_t *world = malloc(sizeof(world_t));
+    if (world == NULL)
+    {
+        return NULL;
+    }
+    // | and not ||, both lists are initialized so both can be freed
+    if (!InitBallsList(&world->balls, listStartMax) | !InitRectsList(&world->rects, listStartMax))
+    {
+        FreeBallsList(&world->balls);
+        FreeRectsList(&world->rects);
+        free(world);
+        return NULL;
+    }
+    world->broadphase = (broadphase_t){0};
+    world->broadphase.gridBalls = -1;
+    world->batches = (batches_t){0};
+    world->islands = (islands_t){0};
+    world->manifolds = NULL;
+    world->manifoldsMax = 0;
+    world->solverBodies = (solver_bodies_t){0};
+    world->contacts = (contacts_list_t){0};
+    world->contactCache = (contact_cache_t){0};
+    world->previousContactCache = (contact_cache_t){0};
+    world->velocityIterations = defaultVelocityIterations;
+    world->pool = NULL;
+    world->continuous = (continuous_t){0};
+    InitAabbTree(&world->continuous.tree);
+    InitAabbTree(&world->queryTree);
+    world->queryTreeStale = false;
+    world->mapBounds = (bounds_t){0, 0, screenWidth, screenHeight};
+    world->params = GetDefaultWorldParams();
+    world->stats = (world_stats_t){0};
+    ResetProfile(&world->profile);
+    return world;
+}
+
+void WorldDestroy(world_t *world)
+{
+    FreeBallsList(&world->balls);
+    FreeRectsList(&world->rects);
+    FreeBroadphase(&world->broadphase);
+    FreeBatches(&world->batches);
+    FreeIslands(&world->islands);
+    free(world->manifolds);
+    FreeSolverBodies(&world->solverBodies);
+    FreeContacts(&world->contacts);
+    FreeContactCache(&world->contactCache);
+    FreeContactCache(&world->previousContactCache);
+    FreeContinuous(&world->continuous);
+    FreeAabbTree(&world->queryTree);
+    ThreadPoolDestroy(world->pool);
+    free(world);
+}
+
+body_handle_t WorldAddBall(world_t *world, ball_t ball)
+{
+    int slot = HandleAddingBallToList(&world->balls, ball);
+    return (body_handle_t){BODY_BALL, slot, slot >= 0 ? world->balls.slots.generations[slot] : 0};
+}
+
+body_handle_t WorldAddRect(world_t *world, rect_t rect)
+{
+    int slot = HandleAddingRectToList(&world->rects, rect);
+    return (body_handle_t){BODY_RECT, slot, slot >= 0 ? world->rects.slots.generations[slot] : 0};
+}
+
+int WorldGetBodyIndex(const world_t *world, body_handle_t body)
+{
+    const body_slots_t *slots = body.kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    const shapes_t *shapes = body.kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+    int count = body.kind == BODY_BALL ? world->balls.pointer : world->rects.pointer;
+    bool alive = body.generation != 0 && body.slot >= 0 && body.slot < slots->count && slots->generations[body.slot] == body.generation;
+    int index = alive ? slots->indices[body.slot] : -1;
+    // a free slot's link is negative, and the body at the index has to name the slot back
+    return index >= 0 && index < count && shapes->slot[index] == body.slot ? index : -1;
+}
+
+bool WorldRemoveBody(world_t *world, body_handle_t body)
+{
+    int index = WorldGetBodyIndex(world, body);
+    if (index < 0)
+    {
+        return false;
+    }
+    const body_slots_t *slots = body.kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    if (!world->queryTreeStale && slots->treeLeaves[body.slot] != AABB_TREE_NULL)
+    {
+        AabbTreeRemove(&world->queryTree, slots->treeLeaves[body.slot]);
+    }
+    if (body.kind == BODY_BALL)
+    {
+        RemoveBall(&world->balls, index);
+    }
+    else
+    {
+        RemoveRect(&world->rects, index);
+    }
+    // the cache is keyed by handle slot, the removed body's pairs aren't touching next step and aren't carried over
+    world->broadphase.gridBalls = -1;
+    return true;
+}
+
+void WorldBodiesMoved(world_t *world)
+{
+    world->queryTreeStale = true;
+    world->broadphase.gridBalls = -1;
+}
+
+bool WorldReserve(world_t *world, int balls, int rects)
+{
+    while (world->balls.max < balls)
+    {
+        if (!IncreaseBallsListSize(&world->balls))
+        {
+            return false;
+        }
+    }
+    while (world->rects.max < rects)
+    {
+        if (!IncreaseRectsListSize(&world->rects))
+        {
+            return false;
+        }
+    }
+    return ReserveBodySlots(&world->balls.slots, balls) && ReserveBodySlots(&world->rects.slots, rects);
+}
+
+void WorldSetThreads(world_t *world, int threads)
+{
+    ThreadPoolDestroy(world->pool);
+    world->pool = threads > 1 ? ThreadPoolCreate(threads) : NULL;
+}
+
+void ApplyImpulse(shapes_t *shapes, int index, VReal_t impulse)
+{
+    shapes->velocityX[index] += impulse.x / shapes->mass[index];
+    shapes->velocityY[index] += impulse.y / shapes->mass[index];
+    WakeShape(shapes, index);
+}
+
+bool WorldApplyImpulse(world_t *world, body_handle_t body, VReal_t impulse)
+{
+    int index = WorldGetBodyIndex(world, body);
+    if (index < 0)
+    {
+        return false;
+    }
+    ApplyImpulse(body.kind == BODY_BALL ? &world->balls.base : &world->rects.base, index, impulse);
+    return true;
+}
+
+bool WorldDragBody(world_t *world, body_handle_t body, VReal_t target, real_t deltaTime)
+{
+    int index = WorldGetBodyIndex(world, body);
+    if (index < 0)
+    {
+        return false;
+    }
+    shapes_t *shapes = body.kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+    TRACE(TRACE_INPUT, TRACE_EVENT_MOUSE_DRAG, index, 0, target.x, target.y, 0);
+    shapes->velocityX[index] = (target.x - shapes->positionX[index]) / deltaTime;
+    shapes->velocityY[index] = (target.y - shapes->positionY[index]) / deltaTime;
+    // a dragged shape has to move even if it fell asleep
+    WakeShape(shapes, index);
+    return true;
+}
+
+void WorldStep(world_t *world, real_t deltaTime)
+{
+    world_stats_t before = world->stats;
+    profile_t *profile = &world->profile;
+    uint64_t stepStart = ProfileBegin();
+    // times its broad phase and solve phase itself
+    HandleCollision(world);
+    uint64_t phaseStart = ProfileBegin();
+    Gravity(world, deltaTime);
+    ProfileEnd(profile, PROFILE_PHASE_GRAVITY, phaseStart);
+    phaseStart = ProfileBegin();
+    HandleContinuousCollision(world, deltaTime);
+    ProfileEnd(profile, PROFILE_PHASE_CONTINUOUS, phaseStart);
+    phaseStart = ProfileBegin();
+    MoveShapes(world, deltaTime);
+    ProfileEnd(profile, PROFILE_PHASE_MOVE, phaseStart);
+    phaseStart = ProfileBegin();
+    HandleMapWallCollision(world);
+    ProfileEnd(profile, PROFILE_PHASE_WALLS, phaseStart);
+    phaseStart = ProfileBegin();
+    HandleSleeping(world, deltaTime);
+    ProfileEnd(profile, PROFILE_PHASE_SLEEP, phaseStart);
+    ProfileEnd(profile, PROFILE_PHASE_STEP, stepStart);
+    ProfileCount(profile, PROFILE_COUNTER_PAIRS, world->stats.candidatePairs - before.candidatePairs);
+    ProfileCount(profile, PROFILE_COUNTER_CONTACTS, world->stats.collisions - before.collisions);
+    ProfileCount(profile, PROFILE_COUNTER_BODIES, before.awakeBodies);
+    TRACE(TRACE_STEP, TRACE_EVENT_STEP, (int)world->stats.steps, world->stats.awakeBodies, world->stats.candidatePairs - before.candidatePairs,
+          world->stats.collisions - before.collisions, world->stats.warmStarts - before.warmStarts);
+    world->stats.steps++;
+}
+
+bool BodyContainsPoint(const world_t *world, body_kind_t kind, int index, VReal_t point)
+{
+    if (kind == BODY_BALL)
+    {
+        VReal_t offset = {point.x - world->balls.base.positionX[index], point.y - world->balls.base.positionY[index]};
+        return GetDotProduct(offset, offset) <= world->balls.radius[index] * world->balls.radius[index];
+    }
+    // in the rect's own axes it's a plain rectangle test
+    box_t box = GetRectBox(&world->rects, index);
+    VReal_t offset = {point.x - box.center.x, point.y - box.center.y};
+    return fabs(GetDotProduct(offset, box.axisX)) <= box.halfSize.x && fabs(GetDotProduct(offset, box.axisY)) <= box.halfSize.y;
+}
+
+typedef struct query_context_t
+{
+    world_t *world;
+    VReal_t point;
+    bounds_t region;
+    body_handle_t *bodies;
+    int max;
+    int count;
+} query_context_t;
+
+void AddQueryResult(query_context_t *query, body_handle_t body)
+{
+    if (query->count < query->max)
+    {
+        query->bodies[query->count] = body;
+    }
+    query->count++;
+}
+
+bool QueryPointCallback(void *context, int item)
+{
+    query_context_t *query = context;
+    body_handle_t body = GetQueryTreeBody(query->world, item);
+    if (BodyContainsPoint(query->world, body.kind, WorldGetBodyIndex(query->world, body), query->point))
+    {
+        AddQueryResult(query, body);
+    }
+    return true;
+}
+
+bool QueryRegionCallback(void *context, int item)
+{
+    query_context_t *query = context;
+    body_handle_t body = GetQueryTreeBody(query->world, item);
+    int index = WorldGetBodyIndex(query->world, body);
+    bounds_t bounds = body.kind == BODY_BALL ? GetBallBounds(&query->world->balls, index) : GetRectBounds(&query->world->rects, index);
+    if (CheckBoundsOverlap(bounds, query->region))
+    {
+        AddQueryResult(query, body);
+    }
+    return true;
+}
+
+int WorldQueryPoint(world_t *world, VReal_t point, body_handle_t *bodies, int max)
+{
+    UpdateQueryTree(world);
+    query_context_t query = {world, point, {point.x, point.y, point.x, point.y}, bodies, max, 0};
+    AabbTreeQuery(&world->queryTree, query.region, QueryPointCallback, &query);
+    return query.count;
+}
+
+int WorldQueryRegion(world_t *world, bounds_t region, body_handle_t *bodies, int max)
+{
+    UpdateQueryTree(world);
+    query_context_t query = {world, {0, 0}, region, bodies, max, 0};
+    AabbTreeQuery(&world->queryTree, region, QueryRegionCallback, &query);
+    return query.count;
+}
+
+typedef struct raycast_context_t
+{
+    world_t *world;
+    VReal_t origin;
+    VReal_t direction; // normalized, so fractions are distances
+    raycast_hit_t *hit;
+    bool found;
+} raycast_context_t;
+
+// distance along the ray to the ball, false if it misses it before maxDistance
+bool GetRayBallHit(VReal_t origin, VReal_t direction, VReal_t center, real_t radius, real_t maxDistance, real_t *distance, VReal_t *normal)
+{
+    VReal_t offset = {origin.x - center.x, origin.y - center.y};
+    real_t startDistance = GetDotProduct(offset, offset) - radius * radius;
+    if (startDistance <= 0)
+    {
+        *distance = 0;
+        *normal = (VReal_t){-direction.x, -direction.y};
+        return true;
+    }
+    real_t along = GetDotProduct(offset, direction);
+    real_t discriminant = along * along - startDistance;
+    if (along > 0 || discriminant < 0)
+    {
+        return false;
+    }
+    *distance = -along - sqrt(discriminant);
+    VReal_t point = GetScaledSum(origin, direction, *distance);
+    *normal = (VReal_t){(point.x - center.x) / radius, (point.y - center.y) / radius};
+    return *distance <= maxDistance;
+}
+
+// the slab test in the box's own axes
+bool GetRayBoxHit(VReal_t origin, VReal_t direction, box_t box, real_t maxDistance, real_t *distance, VReal_t *normal)
+{
+    VReal_t offset = {origin.x - box.center.x, origin.y - box.center.y};
+    VReal_t localOrigin = {GetDotProduct(offset, box.axisX), GetDotProduct(offset, box.axisY)};
+    VReal_t localDirection = {GetDotProduct(direction, box.axisX), GetDotProduct(direction, box.axisY)};
+    bounds_t localBounds = {-box.halfSize.x, -box.halfSize.y, box.halfSize.x, box.halfSize.y};
+    int axis;
+    if (!GetRayBoundsFraction(localBounds, localOrigin.x, localOrigin.y, localDirection.x, localDirection.y, maxDistance, distance, &axis))
+    {
+        return false;
+    }
+    if (axis < 0)
+    {
+        *normal = (VReal_t){-direction.x, -direction.y};
+        return true;
+    }
+    // the face it came through faces against the ray
+    VReal_t faceAxis = axis == 0 ? box.axisX : box.axisY;
+    real_t sign = (axis == 0 ? localDirection.x : localDirection.y) > 0 ? -1 : 1;
+    *normal = (VReal_t){faceAxis.x * sign, faceAxis.y * sign};
+    return true;
+}
+
+real_t RaycastCallback(void *context, int item, real_t maxFraction)
+{
+    raycast_context_t *raycast = context;
+    world_t *world = raycast->world;
+    body_handle_t body = GetQueryTreeBody(world, item);
+    int index = WorldGetBodyIndex(world, body);
+    real_t distance;
+    VReal_t normal;
+    bool hit = body.kind == BODY_BALL
+                   ? GetRayBallHit(raycast->origin, raycast->direction, (VReal_t){world->balls.base.positionX[index], world->balls.base.positionY[index]},
+                                   world->balls.radius[index], maxFraction, &distance, &normal)
+                   : GetRayBoxHit(raycast->origin, raycast->direction, GetRectBox(&world->rects, index), maxFraction, &distance, &normal);
+    if (!hit)
+    {
+        return maxFraction;
+    }
+    *raycast->hit = (raycast_hit_t){body, GetScaledSum(raycast->origin, raycast->direction, distance), normal, distance};
+    raycast->found = true;
+    return distance;
+}
+
+bool WorldRaycast(world_t *world, VReal_t origin, VReal_t direction, real_t maxDistance, raycast_hit_t *hit)
+{
+    real_t length = sqrt(GetDotProduct(direction, direction));
+    if (length <= 0)
+    {
+        return false;
+    }
+    UpdateQueryTree(world);
+    raycast_context_t raycast = {world, origin, {direction.x / length, direction.y / length}, hit, false};
+    AabbTreeRaycast(&world->queryTree, origin.x, origin.y, raycast.direction.x, raycast.direction.y, maxDistance, RaycastCallback, &raycast);
+    return raycast.found;
+}
+
+void AddViewBody(int **indices, int *count, int *max, int index)
+{
+    if (*count == *max)
+    {
+        *max = *max > 0 ? *max * 2 : listStartMax;
+        *indices = realloc(*indices, sizeof(int) * *max);
+    }
+    (*indices)[(*count)++] = index;
+}
+
+// bodies the grid doesn't hold are checked one by one
+void AddViewRange(const world_t *world, bounds_t view, view_list_t *visible, int firstBall, int firstRect)
+{
+    for (int i = firstBall; i < world->balls.pointer; i++)
+    {
+        if (CheckBoundsOverlap(GetBallBounds(&world->balls, i), view))
+        {
+            AddViewBody(&visible->balls, &visible->ballsCount, &visible->ballsMax, i);
+        }
+    }
+    for (int i = firstRect; i < world->rects.pointer; i++)
+    {
+        if (CheckBoundsOverlap(GetRectBounds(&world->rects, i), view))
+        {
+            AddViewBody(&visible->rects, &visible->rectsCount, &visible->rectsMax, i);
+        }
+    }
+}
+
+void WorldQueryView(const world_t *world, bounds_t view, view_list_t *visible)
+{
+    visible->ballsCount = 0;
+    visible->rectsCount = 0;
+    const broadphase_t *broadphase = &world->broadphase;
+    int gridBalls = broadphase->gridBalls;
+    real_t cellSize = broadphase->cellSize;
+    // the grid is from before the last step moved the bodies, a cell of slack finds everything that moved less than that
+    bounds_t region = {view.minX - cellSize, view.minY - cellSize, view.maxX + cellSize, view.maxY + cellSize};
+    int minCellX = GetGridCell(region.minX, cellSize);
+    int maxCellX = GetGridCell(region.maxX, cellSize);
+    int minCellY = GetGridCell(region.minY, cellSize);
+    int maxCellY = GetGridCell(region.maxY, cellSize);
+    // a view of more cells than bodies is cheaper to check body by body
+    if (gridBalls < 0 || (double)(maxCellX - minCellX + 1) * (maxCellY - minCellY + 1) > gridBalls + broadphase->gridRects)
+    {
+        AddViewRange(world, view, visible, 0, 0);
+        return;
+    }
+    for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+    {
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+        {
+            unsigned int bucket = GetGridBucket(cellX, cellY, broadphase->bucketCount);
+            for (int i = broadphase->bucketStarts[bucket]; i < broadphase->bucketStarts[bucket + 1]; i++)
+            {
+                grid_entry_t entry = broadphase->sortedEntries[i];
+                if (entry.cellX != cellX || entry.cellY != cellY)
+                {
+                    continue;
+                }
+                bounds_t bounds = broadphase->bounds[entry.body];
+                // a body in several of the cells is only taken from the one holding the corner of the overlap
+                if (!CheckBoundsOverlap(bounds, region) || GetGridCell(fmax(bounds.minX, region.minX), cellSize) != cellX ||
+                    GetGridCell(fmax(bounds.minY, region.minY), cellSize) != cellY)
+                {
+                    continue;
+                }
+                if (entry.body < gridBalls)
+                {
+                    if (CheckBoundsOverlap(GetBallBounds(&world->balls, entry.body), view))
+                    {
+                        AddViewBody(&visible->balls, &visible->ballsCount, &visible->ballsMax, entry.body);
+                    }
+                }
+                else if (CheckBoundsOverlap(GetRectBounds(&world->rects, entry.body - gridBalls), view))
+                {
+                    AddViewBody(&visible->rects, &visible->rectsCount, &visible->rectsMax, entry.body - gridBalls);
+                }
+            }
+        }
+    }
+    AddViewRange(world, view, visible, gridBalls, broadphase->gridRects);
+}
+
+void FreeViewList(view_list_t *visible)
+{
+    free(visible->balls);
+    free(visible->rects);
+    *visible = (view_list_t){0};
+}
@@ -0,0 +1,381 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <stdbool.h>
+#include "real.h"
+#include "aabbtree.h"
+#include "threadpool.h"
+#include "profile.h"
+
+#define BROADPHASE_CHUNKS 64 // the bucket scan is split into this many ranges, independent of the thread count
+#define MAX_BATCHES 64       // contacts that don't fit any of these go into one extra batch that is resolved serially
+#define SLEEP_BLOCK_SIZE 64  // bodies per entry of shapes_t.blockAwake
+#define MAX_CONTACT_POINTS 2 // two boxes lying face to face touch along a segment, its ends are the contact points
+
+typedef struct VReal_t
+{
+    real_t x;
+    real_t y;
+} VReal_t;
+typedef struct shape_t
+{
+    VReal_t position; // center in circle, upper left corner for rects
+    real_t mass;
+    real_t radian; // rects turn around their center
+    VReal_t velocity;        // units/second
+    real_t spinningVelocity; // the speed the shape is spinning in radians/second
+    bool isGrabbed;
+} shape_t;
+
+typedef struct ball_t
+{
+    shape_t base;
+    real_t radius;
+} ball_t;
+
+typedef struct rect_t
+{
+    shape_t base;
+    VReal_t size;
+} rect_t;
+
+// structure of arrays version of shape_t, one contiguous array per field so the per-step passes only touch what they update
+typedef struct shapes_t
+{
+    real_t *positionX;
+    real_t *positionY;
+    real_t *velocityX;
+    real_t *velocityY;
+    real_t *mass;
+    real_t *radian;
+    real_t *spinningVelocity;
+    bool *isGrabbed;
+    real_t *awake;               // 1 while simulated, 0 while sleeping, a real_t so kernels can multiply by it
+    real_t *sleepTime;           // seconds the shape has been slow enough to sleep
+    unsigned char *blockAwake;   // per SLEEP_BLOCK_SIZE shapes, 0 when the integration passes can skip the whole block
+    unsigned char *blockMoved;   // per block, set once a shape in it moved and cleared when the query tree caught up
+    int *slot;                   // handle slot of the shape, see body_slots_t
+} shapes_t;
+
+typedef enum body_kind_t
+{
+    BODY_BALL,
+    BODY_RECT,
+} body_kind_t;
+
+// names a body for as long as it exists, unlike its index which another body takes over once it is removed
+// generation 0 is never handed out, so a zeroed handle names nothing
+typedef struct body_handle_t
+{
+    body_kind_t kind;
+    int slot;
+    unsigned int generation;
+} body_handle_t;
+
+// handle slot -> index in the list, freed slots are reused newest first
+typedef struct body_slots_t
+{
+    int *indices;              // the body's index while the slot is used, -2 - the next free slot while it's free, -1 ends the chain
+    unsigned int *generations; // bumped whenever the slot is handed out or freed so old handles stop matching
+    int *treeLeaves;           // leaf of the body in world_t.queryTree, AABB_TREE_NULL until the tree caught up with it
+    int freeSlot;              // -1 when every slot is used
+    int count;                 // slots handed out so far, used or free
+    int max;
+} body_slots_t;
+
+typedef struct balls_list_t
+{
+    shapes_t base;
+    real_t *radius;
+    body_slots_t slots;
+    int max;
+    int pointer;
+} balls_list_t;
+
+typedef struct rects_list_t
+{
+    shapes_t base;
+    real_t *sizeX;
+    real_t *sizeY;
+    real_t *cosRadian; // refreshed once per step for awake rects, the narrow phase never calls cos/sin itself
+    real_t *sinRadian;
+    body_slots_t slots;
+    int max;
+    int pointer;
+} rects_list_t;
+
+typedef struct pair_t
+{
+    int first; // always the lower index
+    int second;
+} pair_t;
+
+typedef struct pairs_list_t
+{
+    pair_t *pairs;
+    int max;
+    int pointer;
+} pairs_list_t;
+
+typedef struct grid_entry_t
+{
+    int cellX;
+    int cellY;
+    int body;
+} grid_entry_t;
+
+// uniform grid stored as a spatial hash, rebuilt every step with a counting sort over the buckets
+typedef struct broadphase_t
+{
+    real_t cellSize;
+    bounds_t *bounds; // scratch for the bounding boxes of every body, balls first and rects after them
+    int boundsMax;
+    grid_entry_t *entries;
+    grid_entry_t *sortedEntries;
+    int entriesMax;
+    int *bucketStarts; // bucketCount + 1 prefix sums into sortedEntries
+    int bucketCount;
+    const real_t *awake; // pairs where both bodies sleep are skipped
+    // the grid holds these first balls and rects as they were before the last step moved them
+    // gridBalls is -1 once bodies were removed or replaced since, the grid is useless until the next step
+    int gridBalls;
+    int gridRects;
+    pairs_list_t chunkPairs[BROADPHASE_CHUNKS];
+    pairs_list_t pairs;
+} broadphase_t;
+
+// touching pairs split into batches where no body appears twice, so every pair in a batch can be resolved at the same time
+typedef struct batches_t
+{
+    bool *touching; // per broad phase pair, set by the narrow phase
+    int touchingMax;
+    unsigned long long *bodyBatches; // per body mask of the batches it is already in
+    int bodyBatchesMax;
+    unsigned char *pairBatch; // batch of every touching pair, in broad phase order
+    pairs_list_t pairs;       // touching pairs grouped by batch
+    int *candidates;          // broad phase index of every pair in pairs
+    int candidatesMax;
+    int batchStarts[MAX_BATCHES + 2];
+} batches_t;
+
+// what the narrow phase found for one pair, the normal points from the second body towards the first
+typedef struct manifold_t
+{
+    VReal_t normal;
+    VReal_t points[MAX_CONTACT_POINTS]; // world space
+    real_t penetrations[MAX_CONTACT_POINTS];
+    int pointsCount; // 0 when the pair doesn't touch
+} manifold_t;
+
+// per step copy of what the solver changes on every body, balls first and rects after them
+// all contact kinds index into it, so ball-rect contacts are solved together with the rest
+typedef struct solver_bodies_t
+{
+    real_t *positionX;
+    real_t *positionY;
+    real_t *velocityX;
+    real_t *velocityY;
+    real_t *spinningVelocity;
+    real_t *inverseMass;
+    real_t *inverseInertia; // 0 for balls, they don't spin
+    real_t *awake;
+    int max;
+} solver_bodies_t;
+
+// the touching pairs in batch order, structure of arrays so the solver can work on SIMD_WIDTH of them at once
+// unused points have a normalMass of 0, so a SIMD lane running over one never applies an impulse
+typedef struct contacts_list_t
+{
+    int *body1;
+    int *body2;
+    real_t *normalX;
+    real_t *normalY;
+    int *pointsCount;
+    real_t *penetration[MAX_CONTACT_POINTS];
+    real_t *armCross1[MAX_CONTACT_POINTS]; // cross product of the arm from body1's center to the point and the normal
+    real_t *armCross2[MAX_CONTACT_POINTS];
+    real_t *bounceVelocity[MAX_CONTACT_POINTS]; // separating normal velocity the solver aims for, from the restitution
+    real_t *normalImpulse[MAX_CONTACT_POINTS];  // accumulated, starts from last step's value when the pair was cached
+    real_t *normalMass[MAX_CONTACT_POINTS];     // the impulse that changes the normal velocity at the point by 1
+    int max;
+    int pointer;
+} contacts_list_t;
+
+// open addressing table from body pair to the normal impulse the pair ended its last step with
+// bodies are keyed by kind and handle slot, so adding or removing bodies doesn't move another pair's entry
+// pairs that stopped touching are simply not carried over into the next step's table
+typedef struct contact_cache_t
+{
+    unsigned long long *keys; // 0 marks an empty slot
+    real_t *normalImpulses;   // MAX_CONTACT_POINTS per slot
+    int capacity; // power of 2
+    int count;
+} contact_cache_t;
+
+// bodies joined by this step's contacts, an island only falls asleep or wakes up as a whole
+// balls use indices [0, balls.pointer) and rects follow after them
+typedef struct islands_t
+{
+    pairs_list_t edges;
+    int *parent; // union find forest
+    real_t *islandSleepTime; // per root, the lowest sleep time of its awake bodies
+    int max;
+} islands_t;
+
+// the bodies that move far enough in one step to skip past something, and how far they get before they hit it
+typedef struct continuous_t
+{
+    int *fastIndices; // per body, balls first and rects after them, its index in bodies or -1 when it's slow
+    int fastIndicesMax;
+    int *bodies;
+    real_t *impacts; // per fast body, the share of the step it moves before its first hit, 1 when it hits nothing
+    int max;
+    int count;
+    real_t deltaTime; // of the step being swept, a body's motion is its velocity times this
+    aabb_tree_t tree; // swept bounds of the fast bodies, rebuilt by every step that has any
+} continuous_t;
+
+// running totals since the world was created, reset them by assigning (world_stats_t){0}
+typedef struct world_stats_t
+{
+    long long steps;
+    long long candidatePairs; // pairs handed to the narrow phase by the broad phase
+    long long collisions;     // candidate pairs that actually touched and were solved
+    long long warmStarts;     // touching pairs that found last step's impulse in the contact cache
+    long long sweptBodies;    // bodies fast enough to be swept for their time of impact
+    long long impacts;        // swept bodies that were stopped where they first hit something
+    int awakeBodies;          // not a total, how many bodies were awake after the last step
+} world_stats_t;
+
+// what a world is tuned with, WorldCreate starts every world with GetDefaultWorldParams
+// each world has its own, so differently tuned worlds can run side by side in one process
+typedef struct world_params_t
+{
+    real_t gravity;         // units/second^2, downwards
+    real_t ballWallBounce;  // share of the speed a ball keeps off a wall, 1 is elastic
+    real_t rectWallBounce;
+    real_t ballRestitution; // between two balls
+    real_t rectRestitution; // between anything and a rect
+} world_params_t;
+
+typedef struct world_t
+{
+    balls_list_t balls;
+    rects_list_t rects;
+    broadphase_t broadphase;
+    batches_t batches;
+    islands_t islands;
+    manifold_t *manifolds; // per broad phase pair
+    int manifoldsMax;
+    solver_bodies_t solverBodies;
+    contacts_list_t contacts;
+    contact_cache_t contactCache;        // filled during this step
+    contact_cache_t previousContactCache; // read for warm starting
+    int velocityIterations; // solver passes over all contacts per step, more converges piles faster
+    thread_pool_t *pool; // NULL when running single threaded
+    continuous_t continuous;
+    aabb_tree_t queryTree; // fattened bounds of every body, only brought up to date when it's queried
+    bool queryTreeStale;   // set by whatever moves bodies behind WorldStep's back, the tree is rebuilt before its next use
+    bounds_t mapBounds;    // shapes are kept inside, [0, screenWidth] x [0, screenHeight] unless changed
+    world_params_t params;
+    world_stats_t stats;
+    profile_t profile; // filled by every WorldStep, the frontend adds its own phases
+} world_t;
+
+// indices of the bodies in a view, into the balls and rects lists
+typedef struct view_list_t
+{
+    int *balls;
+    int ballsCount;
+    int ballsMax;
+    int *rects;
+    int rectsCount;
+    int rectsMax;
+} view_list_t;
+
+typedef struct raycast_hit_t
+{
+    body_handle_t body;
+    VReal_t point;
+    VReal_t normal; // points out of the body, against the ray
+    real_t distance;
+} raycast_hit_t;
+
+// size of the window and of the map new worlds start with
+extern const int screenWidth;
+extern const int screenHeight;
+
+shape_t GetShape(const shapes_t *shapes, int index);
+void SetShape(shapes_t *shapes, int index, shape_t shape);
+ball_t GetBall(const balls_list_t *balls, int index);
+void SetBall(balls_list_t *balls, int index, ball_t ball);
+rect_t GetRect(const rects_list_t *rects, int index);
+void SetRect(rects_list_t *rects, int index, rect_t rect);
+// both return the handle slot of the new body, -1 if the list couldn't grow to hold it
+int HandleAddingBallToList(balls_list_t *balls, ball_t newBall);
+int HandleAddingRectToList(rects_list_t *rects, rect_t newRect);
+// false if the memory can't be had, the slots keep their old size then
+bool ReserveBodySlots(body_slots_t *slots, int count);
+// a free slot's entry in body_slots_t.indices from the next free slot, and the next free slot back from the entry
+int GetFreeSlotLink(int slot);
+
+// the step phases, in the order WorldStep runs them
+void HandleCollision(world_t *world);
+void Gravity(world_t *world, real_t deltaTime);
+// stops fast bodies where they first hit something during the step, so nothing skips past what's in its way
+void HandleContinuousCollision(world_t *world, real_t deltaTime);
+void MoveShapes(world_t *world, real_t deltaTime);
+void HandleMapWallCollision(world_t *world);
+void HandleSleeping(world_t *world, real_t deltaTime);
+// puts a sleeping shape back into the simulation, its island wakes up with it on the next step
+void WakeShape(shapes_t *shapes, int index);
+void ClearContactCache(contact_cache_t *cache);
+void SetContactCacheCapacity(contact_cache_t *cache, int capacity);
+
+// the world owns every body and all per-step scratch memory, it never touches raylib so it can run without a window
+// NULL if the world or its body arrays can't be allocated
+world_t *WorldCreate(void);
+world_params_t GetDefaultWorldParams(void);
+// the instruction set the array loops were picked for, see kernels.h
+const char *GetPhysicsKernelsName(void);
+void WorldDestroy(world_t *world);
+// a handle of generation 0, which names nothing, if the body arrays couldn't grow to hold the body
+body_handle_t WorldAddBall(world_t *world, ball_t ball);
+body_handle_t WorldAddRect(world_t *world, rect_t rect);
+// index of the body in its list, -1 once it has been removed
+int WorldGetBodyIndex(const world_t *world, body_handle_t body);
+// O(1), the last body of the list moves into the freed index, returns false if the body was already gone
+bool WorldRemoveBody(world_t *world, body_handle_t body);
+// for whatever moves or replaces bodies behind WorldStep's back, like restoring a snapshot
+void WorldBodiesMoved(world_t *world);
+// grows the body arrays and handle slots to hold at least this many bodies, the counts stay as they are
+// the arrays never move when they grow, reserving only saves the growth steps
+// false if the memory can't be had, whatever grew before that stays grown
+bool WorldReserve(world_t *world, int balls, int rects);
+// threads includes the calling thread, 1 runs everything on the caller
+// results only depend on the scene, not on the thread count
+void WorldSetThreads(world_t *world, int threads);
+// adds impulse / mass to the velocity and wakes the shape, returns false if the body was already gone
+bool WorldApplyImpulse(world_t *world, body_handle_t body, VReal_t impulse);
+// sets the velocity that takes the body's position to target within deltaTime and wakes it, for a body held by the mouse
+// both frontends call it before every step, returns false if the body was already gone
+bool WorldDragBody(world_t *world, body_handle_t body, VReal_t target, real_t deltaTime);
+// advances the simulation by one step, deltaTime is in seconds
+void WorldStep(world_t *world, real_t deltaTime);
+
+// scene queries, O(log n) in the body count plus the bodies found
+// they fill in up to max handles and return how many bodies matched, which can be more than max
+// bodies containing the point
+int WorldQueryPoint(world_t *world, VReal_t point, body_handle_t *bodies, int max);
+// bodies whose bounding box overlaps the region
+int WorldQueryRegion(world_t *world, bounds_t region, body_handle_t *bodies, int max);
+// the first body along the ray, direction doesn't have to be normalized, a ray starting inside a body hits it at distance 0
+bool WorldRaycast(world_t *world, VReal_t origin, VReal_t direction, real_t maxDistance, raycast_hit_t *hit);
+
+// the bodies whose bounding box overlaps the view, for drawing
+// walks the cells of the last step's broad phase grid, so it costs what the view holds and keeps nothing up to date
+// bodies that moved into the view by more than a grid cell during the last step are only found after the next one
+void WorldQueryView(const world_t *world, bounds_t view, view_list_t *visible);
+void FreeViewList(view_list_t *visible);
+
+#endif
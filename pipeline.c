@@ -0,0 +1,277 @@
+#include "pipeline.h"
+#include <stdlib.h>
+#include <time.h>
+
+// the views drawing sends are grown by this share of their size on every side, so panning between two steps shows no gaps
+const real_t pipelineViewMargin = 0.25;
+
+double GetPipelineSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool InputQueuePush(input_queue_t *queue, input_command_t command)
+{
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&queue->tail, memory_order_acquire) >= INPUT_QUEUE_SIZE)
+    {
+        return false;
+    }
+    queue->commands[head & (INPUT_QUEUE_SIZE - 1)] = command;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool InputQueuePop(input_queue_t *queue, input_command_t *command)
+{
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&queue->head, memory_order_acquire))
+    {
+        return false;
+    }
+    *command = queue->commands[tail & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void EnsureSnapshotShapesSize(snapshot_shapes_t *shapes, int count)
+{
+    if (count <= shapes->max)
+    {
+        return;
+    }
+    shapes->max = count;
+    real_t **arrays[] = {&shapes->previousX, &shapes->previousY, &shapes->previousRadian, &shapes->positionX,
+                         &shapes->positionY, &shapes->radian, &shapes->sizeX, &shapes->sizeY};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+    {
+        *arrays[i] = realloc(*arrays[i], sizeof(real_t) * count);
+    }
+}
+
+void FreeSnapshotShapes(snapshot_shapes_t *shapes)
+{
+    free(shapes->previousX);
+    free(shapes->previousY);
+    free(shapes->previousRadian);
+    free(shapes->positionX);
+    free(shapes->positionY);
+    free(shapes->radian);
+    free(shapes->sizeX);
+    free(shapes->sizeY);
+    *shapes = (snapshot_shapes_t){0};
+}
+
+// copies the shapes at indices, all count of them if indices is NULL
+// previous holds the first previousCount shapes from before the last step, shapes past it didn't exist then
+void CopySnapshotShapes(snapshot_shapes_t *snapshot, const shapes_t *shapes, const real_t *sizeX, const real_t *sizeY, const int *indices, int count,
+                        const real_t *previousX, const real_t *previousY, const real_t *previousRadian, int previousCount)
+{
+    EnsureSnapshotShapesSize(snapshot, count);
+    snapshot->count = count;
+    for (int i = 0; i < count; i++)
+    {
+        int index = indices != NULL ? indices[i] : i;
+        snapshot->positionX[i] = shapes->positionX[index];
+        snapshot->positionY[i] = shapes->positionY[index];
+        snapshot->radian[i] = shapes->radian[index];
+        snapshot->sizeX[i] = sizeX[index];
+        snapshot->sizeY[i] = sizeY[index];
+        bool existed = index < previousCount;
+        snapshot->previousX[i] = existed ? previousX[index] : shapes->positionX[index];
+        snapshot->previousY[i] = existed ? previousY[index] : shapes->positionY[index];
+        snapshot->previousRadian[i] = existed ? previousRadian[index] : shapes->radian[index];
+    }
+}
+
+// fills the back snapshot and swaps it with the shared one, marking it fresh for the drawing thread
+void PublishSnapshot(pipeline_t *pipeline, double stepEndTime)
+{
+    world_t *world = pipeline->world;
+    const scheduler_t *scheduler = &pipeline->scheduler;
+    render_snapshot_t *snapshot = &pipeline->snapshots[pipeline->back];
+    const int *balls = NULL;
+    const int *rects = NULL;
+    int ballsCount = world->balls.pointer;
+    int rectsCount = world->rects.pointer;
+    if (pipeline->hasView)
+    {
+        WorldQueryView(world, pipeline->view, &pipeline->visible);
+        balls = pipeline->visible.balls;
+        rects = pipeline->visible.rects;
+        ballsCount = pipeline->visible.ballsCount;
+        rectsCount = pipeline->visible.rectsCount;
+    }
+    int previousBalls = scheduler->previousBalls;
+    CopySnapshotShapes(&snapshot->balls, &world->balls.base, world->balls.radius, world->balls.radius, balls, ballsCount,
+                       scheduler->previousX, scheduler->previousY, scheduler->previousRadian, previousBalls);
+    CopySnapshotShapes(&snapshot->rects, &world->rects.base, world->rects.sizeX, world->rects.sizeY, rects, rectsCount,
+                       scheduler->previousX + previousBalls, scheduler->previousY + previousBalls,
+                       scheduler->previousRadian + previousBalls, scheduler->previousRects);
+    snapshot->mapBounds = world->mapBounds;
+    snapshot->stepEndTime = stepEndTime;
+    snapshot->stepTime = scheduler->stepTime;
+    snapshot->steps = pipeline->steps;
+    snapshot->substeps = scheduler->lastSubsteps;
+    snapshot->awakeBodies = world->stats.awakeBodies;
+    pipeline->back = atomic_exchange(&pipeline->shared, pipeline->back | PIPELINE_FRESH) & ~PIPELINE_FRESH;
+}
+
+const render_snapshot_t *PipelineAcquire(pipeline_t *pipeline)
+{
+    if (atomic_load(&pipeline->shared) & PIPELINE_FRESH)
+    {
+        pipeline->front = atomic_exchange(&pipeline->shared, pipeline->front) & ~PIPELINE_FRESH;
+    }
+    return &pipeline->snapshots[pipeline->front];
+}
+
+real_t GetSnapshotAlpha(const render_snapshot_t *snapshot, double now)
+{
+    if (snapshot->stepTime <= 0)
+    {
+        return 1;
+    }
+    real_t alpha = (real_t)((now - snapshot->stepEndTime) / snapshot->stepTime);
+    alpha = alpha > 0 ? alpha : 0;
+    return alpha < 1 ? alpha : 1;
+}
+
+// the velocity that takes the held shape to the mouse within one step
+void PipelineBeforeStep(void *context, world_t *world, real_t deltaTime)
+{
+    pipeline_t *pipeline = context;
+    VReal_t target = {pipeline->dragTarget.x + pipeline->dragOffset.x, pipeline->dragTarget.y + pipeline->dragOffset.y};
+    WorldDragBody(world, pipeline->dragged, target, deltaTime);
+}
+
+// returns true if bodies were removed or moved, which has to be drawn even without a step
+bool HandlePipelineInput(pipeline_t *pipeline)
+{
+    world_t *world = pipeline->world;
+    bool changed = false;
+    input_command_t command;
+    while (InputQueuePop(&pipeline->input, &command))
+    {
+        switch (command.kind)
+        {
+        case INPUT_MOUSE_DOWN:
+            if (WorldGetBodyIndex(world, pipeline->dragged) < 0)
+            {
+                body_handle_t body = {0};
+                WorldQueryPoint(world, command.position, &body, 1);
+                int index = WorldGetBodyIndex(world, body);
+                if (index >= 0)
+                {
+                    const shapes_t *shapes = body.kind == BODY_BALL ? &world->balls.base : &world->rects.base;
+                    pipeline->dragOffset = (VReal_t){shapes->positionX[index] - command.position.x, shapes->positionY[index] - command.position.y};
+                }
+                pipeline->dragged = body;
+            }
+            pipeline->dragTarget = command.position;
+            break;
+        case INPUT_MOUSE_UP:
+            pipeline->dragged = (body_handle_t){0};
+            break;
+        case INPUT_REMOVE:
+        {
+            body_handle_t body = {0};
+            WorldQueryPoint(world, command.position, &body, 1);
+            changed |= WorldRemoveBody(world, body);
+            break;
+        }
+        case INPUT_RESTORE:
+            changed |= pipeline->restoreSnapshot != NULL && WorldRestore(world, pipeline->restoreSnapshot);
+            break;
+        case INPUT_VIEW:
+        {
+            real_t marginX = (command.view.maxX - command.view.minX) * pipelineViewMargin;
+            real_t marginY = (command.view.maxY - command.view.minY) * pipelineViewMargin;
+            pipeline->view = (bounds_t){command.view.minX - marginX, command.view.minY - marginY, command.view.maxX + marginX, command.view.maxY + marginY};
+            pipeline->hasView = true;
+            break;
+        }
+        }
+    }
+    // removing and restoring move bodies between steps, there is nothing to blend from
+    if (changed)
+    {
+        ResetSchedulerInterpolation(&pipeline->scheduler);
+    }
+    return changed;
+}
+
+void *RunPipeline(void *argument)
+{
+    pipeline_t *pipeline = argument;
+    scheduler_t *scheduler = &pipeline->scheduler;
+    double last = GetPipelineSeconds();
+    PublishSnapshot(pipeline, last);
+    while (!atomic_load(&pipeline->quit))
+    {
+        bool changed = HandlePipelineInput(pipeline);
+        double now = GetPipelineSeconds();
+        int steps = SchedulerAdvance(scheduler, pipeline->world, now - last, PipelineBeforeStep, pipeline);
+        pipeline->steps += steps;
+        last = now;
+        if (steps > 0 || changed)
+        {
+            PublishSnapshot(pipeline, now - scheduler->accumulator);
+        }
+        // nothing to do until the next step is due, input waits at most that long
+        double wait = scheduler->stepTime - scheduler->accumulator - (GetPipelineSeconds() - now);
+        if (wait > 0)
+        {
+            struct timespec duration = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+            nanosleep(&duration, NULL);
+        }
+    }
+    return NULL;
+}
+
+pipeline_t *PipelineStart(world_t *world, real_t stepTime, int maxSubsteps, const world_snapshot_t *restoreSnapshot)
+{
+    pipeline_t *pipeline = calloc(1, sizeof(pipeline_t));
+    if (pipeline == NULL)
+    {
+        return NULL;
+    }
+    pipeline->world = world;
+    pipeline->restoreSnapshot = restoreSnapshot;
+    InitScheduler(&pipeline->scheduler, stepTime);
+    pipeline->scheduler.maxSubsteps = maxSubsteps;
+    pipeline->back = 0;
+    atomic_init(&pipeline->shared, 1);
+    pipeline->front = 2;
+    atomic_init(&pipeline->input.head, 0);
+    atomic_init(&pipeline->input.tail, 0);
+    atomic_init(&pipeline->quit, false);
+    if (pthread_create(&pipeline->thread, NULL, RunPipeline, pipeline) != 0)
+    {
+        FreeScheduler(&pipeline->scheduler);
+        free(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+void PipelineStop(pipeline_t *pipeline)
+{
+    atomic_store(&pipeline->quit, true);
+    pthread_join(pipeline->thread, NULL);
+    FreeScheduler(&pipeline->scheduler);
+    for (int i = 0; i < PIPELINE_SNAPSHOTS; i++)
+    {
+        FreeSnapshotShapes(&pipeline->snapshots[i].balls);
+        FreeSnapshotShapes(&pipeline->snapshots[i].rects);
+    }
+    FreeViewList(&pipeline->visible);
+    free(pipeline);
+}
+
+bool PipelineSend(pipeline_t *pipeline, input_command_t command)
+{
+    return InputQueuePush(&pipeline->input, command);
+}
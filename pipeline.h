@@ -0,0 +1,109 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "physics.h"
+#include "scheduler.h"
+#include "scene.h"
+#include <stdatomic.h>
+#include <pthread.h>
+
+// runs a world on its own thread at the scheduler's fixed rate while the thread that owns the window draws it
+// after every advance the physics thread copies what drawing needs into one of three snapshots and swaps it in, drawing
+// takes the newest one, so neither side ever waits for the other and a slow frame never holds up the solver
+// input goes the other way through a lock-free queue, the world itself is only ever touched by the physics thread
+
+#define PIPELINE_SNAPSHOTS 3
+#define PIPELINE_FRESH 4 // set on the shared snapshot index while drawing hasn't taken it yet
+#define INPUT_QUEUE_SIZE 256 // commands, a power of 2
+
+// one list of shapes as of the last step and the step before it, balls keep their radius in both sizes
+typedef struct snapshot_shapes_t
+{
+    real_t *previousX;
+    real_t *previousY;
+    real_t *previousRadian;
+    real_t *positionX;
+    real_t *positionY;
+    real_t *radian;
+    real_t *sizeX;
+    real_t *sizeY;
+    int count;
+    int max;
+} snapshot_shapes_t;
+
+typedef struct render_snapshot_t
+{
+    snapshot_shapes_t balls;
+    snapshot_shapes_t rects;
+    double stepEndTime; // GetPipelineSeconds the last step caught up to, drawing blends by how long ago that was
+    real_t stepTime;
+    bounds_t mapBounds;
+    long long steps;   // taken since the start
+    int substeps;      // of the last step
+    int awakeBodies;
+} render_snapshot_t;
+
+typedef enum input_command_kind_t
+{
+    INPUT_MOUSE_DOWN, // grabs the shape under position if none is held, otherwise drags the held one there
+    INPUT_MOUSE_UP,
+    INPUT_REMOVE,  // the shape under position
+    INPUT_RESTORE, // back to the snapshot the pipeline was started with
+    INPUT_VIEW,    // snapshots only carry the bodies around view from now on
+} input_command_kind_t;
+
+typedef struct input_command_t
+{
+    input_command_kind_t kind;
+    VReal_t position;
+    bounds_t view;
+} input_command_t;
+
+// single producer (the drawing thread) and single consumer (the physics thread)
+typedef struct input_queue_t
+{
+    input_command_t commands[INPUT_QUEUE_SIZE];
+    atomic_ulong head; // next command the producer writes
+    atomic_ulong tail; // next command the consumer reads
+} input_queue_t;
+
+typedef struct pipeline_t
+{
+    world_t *world;
+    scheduler_t scheduler;
+    const world_snapshot_t *restoreSnapshot; // NULL ignores INPUT_RESTORE
+    render_snapshot_t snapshots[PIPELINE_SNAPSHOTS];
+    atomic_int shared; // the snapshot between the two threads, or'ed with PIPELINE_FRESH
+    int back;          // only used by the physics thread
+    int front;         // only used by the drawing thread
+    input_queue_t input;
+    atomic_bool quit;
+    pthread_t thread;
+    long long steps;
+    // physics thread only, every body goes into the snapshots until a view was sent
+    bool hasView;
+    bounds_t view;
+    view_list_t visible;
+    // physics thread only, zeroed while no shape is held
+    body_handle_t dragged;
+    VReal_t dragOffset;
+    VReal_t dragTarget;
+} pipeline_t;
+
+double GetPipelineSeconds(void);
+
+bool InputQueuePush(input_queue_t *queue, input_command_t command);
+bool InputQueuePop(input_queue_t *queue, input_command_t *command);
+
+// the world belongs to the physics thread until PipelineStop, restoreSnapshot has to outlive the pipeline
+pipeline_t *PipelineStart(world_t *world, real_t stepTime, int maxSubsteps, const world_snapshot_t *restoreSnapshot);
+void PipelineStop(pipeline_t *pipeline);
+// false if the queue is full and the command was dropped
+bool PipelineSend(pipeline_t *pipeline, input_command_t command);
+// the newest snapshot, it stays the same until the next call
+const render_snapshot_t *PipelineAcquire(pipeline_t *pipeline);
+
+// how far between the last two steps a frame drawn at now is, in [0, 1]
+real_t GetSnapshotAlpha(const render_snapshot_t *snapshot, double now);
+
+#endif
@@ -0,0 +1,160 @@
+#include "pool.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// lives right in front of the items, at the end of the page in front of them for arrays with a reservation of their own
+typedef struct pool_array_t
+{
+    size_t reservedBytes; // items only
+    size_t committedBytes;
+    pool_arena_t *arena;  // NULL for a reservation of its own
+    unsigned char padding[POOL_ARENA_ALIGNMENT - 2 * sizeof(size_t) - sizeof(pool_arena_t *)];
+} pool_array_t;
+
+_Thread_local pool_arena_t *threadArena = NULL;
+
+size_t GetPoolPageSize(void)
+{
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+size_t GetPoolRoundedSize(size_t size, size_t multiple)
+{
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+pool_array_t *GetPoolArray(void *array)
+{
+    return (pool_array_t *)array - 1;
+}
+
+void *ReservePoolArray(size_t reservedBytes)
+{
+    size_t pageSize = GetPoolPageSize();
+    reservedBytes = GetPoolRoundedSize(reservedBytes, pageSize);
+    // nothing is backed by memory until it's committed
+    unsigned char *base = mmap(NULL, pageSize + reservedBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (mprotect(base, pageSize, PROT_READ | PROT_WRITE) != 0)
+    {
+        munmap(base, pageSize + reservedBytes);
+        return NULL;
+    }
+    unsigned char *array = base + pageSize;
+    *GetPoolArray(array) = (pool_array_t){reservedBytes, 0, NULL, {0}};
+    return array;
+}
+
+// NULL if the arena is full, the caller falls back to a reservation
+void *CarveArenaArray(pool_arena_t *arena, size_t bytes)
+{
+    bytes = GetPoolRoundedSize(bytes, POOL_ARENA_ALIGNMENT);
+    if (arena->used + sizeof(pool_array_t) + bytes > arena->size)
+    {
+        return NULL;
+    }
+    unsigned char *array = arena->base + arena->used + sizeof(pool_array_t);
+    *GetPoolArray(array) = (pool_array_t){bytes, bytes, arena, {0}};
+    arena->used += sizeof(pool_array_t) + bytes;
+    return array;
+}
+
+void *PoolArrayResize(void *array, size_t count, size_t itemSize)
+{
+    size_t bytes = count * itemSize;
+    void *carved = array == NULL && threadArena != NULL ? CarveArenaArray(threadArena, bytes) : NULL;
+    if (carved != NULL)
+    {
+        return carved;
+    }
+    if (array == NULL)
+    {
+        size_t reservedBytes = (size_t)POOL_MAX_ITEMS * itemSize;
+        array = ReservePoolArray(bytes > reservedBytes ? bytes * 2 : reservedBytes);
+        if (array == NULL)
+        {
+            return NULL;
+        }
+    }
+    pool_array_t *pool = GetPoolArray(array);
+    if (bytes <= pool->committedBytes)
+    {
+        return array;
+    }
+    if (pool->arena != NULL && pool->arena == threadArena && (carved = CarveArenaArray(pool->arena, bytes)) != NULL)
+    {
+        // the old items stay behind as a hole in the arena
+        memcpy(carved, array, pool->committedBytes);
+        return carved;
+    }
+    if (bytes > pool->reservedBytes)
+    {
+        // the one case that moves, into a reservation twice as big
+        void *moved = ReservePoolArray(bytes * 2);
+        if (moved == NULL || PoolArrayResize(moved, count, itemSize) == NULL)
+        {
+            PoolArrayFree(moved);
+            return NULL;
+        }
+        memcpy(moved, array, pool->committedBytes);
+        PoolArrayFree(array);
+        return moved;
+    }
+    size_t committedBytes = GetPoolRoundedSize(bytes, POOL_CHUNK_BYTES);
+    committedBytes = committedBytes < pool->reservedBytes ? committedBytes : pool->reservedBytes;
+    if (mprotect((unsigned char *)array + pool->committedBytes, committedBytes - pool->committedBytes, PROT_READ | PROT_WRITE) != 0)
+    {
+        return NULL;
+    }
+    pool->committedBytes = committedBytes;
+    return array;
+}
+
+bool PoolArrayGrow(void *arrayPointer, size_t count, size_t itemSize)
+{
+    // copied in and out, the pointer is a real_t * or an int * and not a void *
+    void *array;
+    memcpy(&array, arrayPointer, sizeof(void *));
+    void *resized = PoolArrayResize(array, count, itemSize);
+    if (resized == NULL)
+    {
+        return false;
+    }
+    memcpy(arrayPointer, &resized, sizeof(void *));
+    return true;
+}
+
+void PoolArrayFree(void *array)
+{
+    if (array != NULL && GetPoolArray(array)->arena == NULL)
+    {
+        munmap((unsigned char *)array - GetPoolPageSize(), GetPoolPageSize() + GetPoolArray(array)->reservedBytes);
+    }
+}
+
+bool InitPoolArena(pool_arena_t *arena, size_t bytes)
+{
+    bytes = GetPoolRoundedSize(bytes, GetPoolPageSize());
+    // no PROT_NONE and committing here, untouched pages cost nothing anyway
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    *arena = (pool_arena_t){base != MAP_FAILED ? base : NULL, base != MAP_FAILED ? bytes : 0, 0};
+    return base != MAP_FAILED;
+}
+
+void FreePoolArena(pool_arena_t *arena)
+{
+    if (arena->base != NULL)
+    {
+        munmap(arena->base, arena->size);
+    }
+    *arena = (pool_arena_t){0};
+}
+
+void PoolSetArena(pool_arena_t *arena)
+{
+    threadArena = arena;
+}
@@ -0,0 +1,43 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// arrays that grow in place: room for POOL_MAX_ITEMS items is reserved as address space when the array is made,
+// and memory is committed POOL_CHUNK_BYTES at a time as it grows
+// growing never copies or moves the items, so pointers into the array stay valid and there are no realloc spikes
+// only an array outgrowing its reservation is moved, like realloc would
+
+#define POOL_MAX_ITEMS (1 << 24)
+#define POOL_CHUNK_BYTES (256 << 10)
+#define POOL_ARENA_ALIGNMENT 64 // arena arrays start on a cache line
+
+// a reservation each is far too much for a small world and thousands of them run out of mappings,
+// an arena instead hands out arrays one after the other from a single reservation, so the bodies of many small worlds
+// sit next to each other in memory
+// while an arena is set on a thread every array that thread makes comes out of it, and its arrays grow by moving further
+// into it; an arena array that grows once its arena isn't set anymore moves into a reservation of its own
+typedef struct pool_arena_t
+{
+    unsigned char *base;
+    size_t size;
+    size_t used;
+} pool_arena_t;
+
+// NULL makes a new array, the items are page aligned (arena arrays only to POOL_ARENA_ALIGNMENT),
+// returns NULL if the memory can't be had, the old array is left as it was
+void *PoolArrayResize(void *array, size_t count, size_t itemSize);
+// PoolArrayResize for an array kept in a pointer, arrayPointer is that pointer's address
+// the pointer is only replaced once the array grew, returns false and leaves it pointing at the old items otherwise
+bool PoolArrayGrow(void *arrayPointer, size_t count, size_t itemSize);
+// arena arrays are only given back with their arena
+void PoolArrayFree(void *array);
+
+// reserves bytes of address space, backed by memory as it's first touched
+bool InitPoolArena(pool_arena_t *arena, size_t bytes);
+void FreePoolArena(pool_arena_t *arena);
+// NULL goes back to a reservation per array, only affects the calling thread
+void PoolSetArena(pool_arena_t *arena);
+
+#endif
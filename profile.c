@@ -0,0 +1,123 @@
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+const char *profilePhaseNames[PROFILE_PHASE_COUNT] = {"step", "broadphase", "solve", "gravity", "continuous", "move", "walls", "sleep", "draw"};
+const char *profileCounterNames[PROFILE_COUNTER_COUNT] = {"pairs", "contacts", "bodies"};
+
+uint64_t ProfileBegin(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void ProfileEnd(profile_t *profile, profile_phase_t phase, uint64_t start)
+{
+    AddProfileSample(&profile->phases[phase], (ProfileBegin() - start) * 1e-3);
+}
+
+void ProfileCount(profile_t *profile, profile_counter_t counter, double value)
+{
+    AddProfileSample(&profile->counters[counter], value);
+}
+
+void AddProfileSample(profile_series_t *series, double sample)
+{
+    series->samples[series->count % PROFILE_WINDOW] = sample;
+    series->count++;
+    series->total += sample;
+    series->max = series->count == 1 || sample > series->max ? sample : series->max;
+}
+
+void ResetProfile(profile_t *profile)
+{
+    memset(profile, 0, sizeof(profile_t));
+}
+
+int CompareProfileSamples(const void *a, const void *b)
+{
+    double first = *(const double *)a;
+    double second = *(const double *)b;
+    return (first > second) - (first < second);
+}
+
+// nearest rank, so p99 of a full window is the 11th slowest sample
+double GetProfilePercentile(const profile_series_t *series, double percentile)
+{
+    int count = series->count < PROFILE_WINDOW ? (int)series->count : PROFILE_WINDOW;
+    if (count == 0)
+    {
+        return 0;
+    }
+    double sorted[PROFILE_WINDOW];
+    memcpy(sorted, series->samples, sizeof(double) * count);
+    qsort(sorted, count, sizeof(double), CompareProfileSamples);
+    int rank = (int)ceil(percentile * count);
+    rank = rank < 1 ? 1 : rank;
+    return sorted[rank - 1];
+}
+
+double GetProfileMean(const profile_series_t *series)
+{
+    return series->count > 0 ? series->total / series->count : 0;
+}
+
+const char *GetProfilePhaseName(profile_phase_t phase)
+{
+    return profilePhaseNames[phase];
+}
+
+const char *GetProfileCounterName(profile_counter_t counter)
+{
+    return profileCounterNames[counter];
+}
+
+void WriteProfileRow(FILE *output, const char *kind, const char *name, const profile_series_t *series, bool csv, bool first)
+{
+    if (csv)
+    {
+        fprintf(output, "%s,%s,%lld,%.3f,%.3f,%.3f,%.3f,%.3f\n", kind, name, series->count, GetProfileMean(series),
+                GetProfilePercentile(series, 0.5), GetProfilePercentile(series, 0.99), series->max, series->total);
+        return;
+    }
+    fprintf(output, "%s    {\"kind\": \"%s\", \"name\": \"%s\", \"samples\": %lld, \"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"total\": %.3f}",
+            first ? "" : ",\n", kind, name, series->count, GetProfileMean(series),
+            GetProfilePercentile(series, 0.5), GetProfilePercentile(series, 0.99), series->max, series->total);
+}
+
+// phase values are microseconds, counter values are per step, p50 and p99 only cover the last PROFILE_WINDOW samples
+void WriteProfile(FILE *output, const profile_t *profile, bool csv)
+{
+    if (csv)
+    {
+        fprintf(output, "kind,name,samples,mean,p50,p99,max,total\n");
+    }
+    else
+    {
+        fprintf(output, "{\"window\": %d, \"profile\": [\n", PROFILE_WINDOW);
+    }
+    bool first = true;
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+    {
+        if (profile->phases[i].count > 0)
+        {
+            WriteProfileRow(output, "phase_us", profilePhaseNames[i], &profile->phases[i], csv, first);
+            first = false;
+        }
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+    {
+        if (profile->counters[i].count > 0)
+        {
+            WriteProfileRow(output, "counter", profileCounterNames[i], &profile->counters[i], csv, first);
+            first = false;
+        }
+    }
+    if (!csv)
+    {
+        fprintf(output, "\n]}\n");
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// per phase timings and per step counters, each kept as a rolling window for p50/p99 plus totals over the whole run
+
+#define PROFILE_WINDOW 1024 // samples kept per series, a few seconds at the frontend frame rate
+
+typedef enum profile_phase_t
+{
+    PROFILE_PHASE_STEP, // all of WorldStep, the phases below except draw add up to roughly this
+    PROFILE_PHASE_BROADPHASE,
+    PROFILE_PHASE_SOLVE, // narrow phase, contact solving and the per step setup around it
+    PROFILE_PHASE_GRAVITY,
+    PROFILE_PHASE_CONTINUOUS, // sweeping the fast bodies
+    PROFILE_PHASE_MOVE,
+    PROFILE_PHASE_WALLS,
+    PROFILE_PHASE_SLEEP,
+    PROFILE_PHASE_DRAW, // frontend only
+    PROFILE_PHASE_COUNT
+} profile_phase_t;
+
+typedef enum profile_counter_t
+{
+    PROFILE_COUNTER_PAIRS,    // pairs tested by the narrow phase
+    PROFILE_COUNTER_CONTACTS, // pairs that touched and were solved
+    PROFILE_COUNTER_BODIES,   // bodies integrated, sleeping ones are skipped
+    PROFILE_COUNTER_COUNT
+} profile_counter_t;
+
+typedef struct profile_series_t
+{
+    double samples[PROFILE_WINDOW]; // ring, the newest sample is at (count - 1) % PROFILE_WINDOW
+    long long count;
+    double total;
+    double max;
+} profile_series_t;
+
+typedef struct profile_t
+{
+    profile_series_t phases[PROFILE_PHASE_COUNT]; // microseconds
+    profile_series_t counters[PROFILE_COUNTER_COUNT];
+} profile_t;
+
+// a phase is timed by keeping ProfileBegin's value and handing it to ProfileEnd once the phase is done
+uint64_t ProfileBegin(void);
+void ProfileEnd(profile_t *profile, profile_phase_t phase, uint64_t start);
+void ProfileCount(profile_t *profile, profile_counter_t counter, double value);
+void AddProfileSample(profile_series_t *series, double sample);
+void ResetProfile(profile_t *profile);
+
+// percentile in [0, 1] over the rolling window, 0 for an empty series
+double GetProfilePercentile(const profile_series_t *series, double percentile);
+double GetProfileMean(const profile_series_t *series);
+const char *GetProfilePhaseName(profile_phase_t phase);
+const char *GetProfileCounterName(profile_counter_t counter);
+
+// one row per phase and counter, phases that never ran are left out
+void WriteProfile(FILE *output, const profile_t *profile, bool csv);
+
+#endif
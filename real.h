@@ -0,0 +1,16 @@
+#ifndef REAL_H
+#define REAL_H
+
+// scalar of the whole simulation: storage, collision and integration
+// double unless built with -DPHYSICS_FLOAT32, which halves the memory traffic and doubles the SIMD width
+// physics.c uses tgmath.h so sqrt, fabs and friends follow the type instead of going through double
+
+#ifdef PHYSICS_FLOAT32
+typedef float real_t;
+#define REAL_NAME "float32"
+#else
+typedef double real_t;
+#define REAL_NAME "float64"
+#endif
+
+#endif
@@ -0,0 +1,619 @@
+#include "physics.h"
+#include "scenarios.h"
+#include "particles.h"
+#include "scene.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// steps canned scenes and compares every body with the golden files recorded from them, or times reference scenes
+// against a recorded baseline, exits with 1 if anything changed or got too slow
+// usage: regress [--golden DIR] [--case NAME] [--threads N] [--tolerance X] [--update]
+//        regress --perf FILE [--max-slowdown FRACTION] [--repeats N] [--update]
+// golden files are DIR/PRECISION/CASE.txt with every value as a hex float, so without a tolerance only identical bits
+// pass, --tolerance X lets a value be off by X * (1 + |golden value|), for builds that are allowed to round differently
+// the kernels come from PHYSICS_KERNELS (see kernels.h), so the same files check scalar, SIMD and multithreaded runs
+// --update writes the golden files or this precision's lines of the baseline from this run instead of comparing
+
+#define REGRESS_COLUMNS 6
+#define REGRESS_MAX_REPORTED 8 // mismatches printed per case, the rest are only counted
+#define REGRESS_MAX_PERF_LINES 64
+#define REGRESS_LINE_SIZE 512
+#define REGRESS_MAX_HANDLES 256
+
+typedef enum regress_scene_t
+{
+    REGRESS_SCENARIO,   // GenerateScenario
+    REGRESS_RECT_PAIRS, // AddRectPairs
+    REGRESS_PARTICLES,  // CreateParticleScenario
+    REGRESS_HANDLES,    // GenerateScenario, then StepHandleChurn instead of plain steps
+} regress_scene_t;
+
+typedef struct regress_case_t
+{
+    const char *name;
+    regress_scene_t scene;
+    scenario_kind_t scenario;
+    int bodies;
+    int steps;
+    real_t gravity; // worlds only, the particle scenario sets its own
+} regress_case_t;
+
+typedef struct regress_row_t
+{
+    char kind[16];
+    int index;
+    int columns;
+    double values[REGRESS_COLUMNS];
+} regress_row_t;
+
+typedef struct regress_state_t
+{
+    regress_row_t *rows;
+    int count;
+    int max;
+} regress_state_t;
+
+typedef struct regress_options_t
+{
+    const char *goldenDir;
+    const char *caseName; // NULL runs every case
+    int threads;
+    double tolerance;
+    const char *perfPath; // switches to timing the reference scenes
+    double maxSlowdown;
+    int repeats;
+    bool update;
+} regress_options_t;
+
+// small enough to step in a blink on one thread, long enough for piles to settle and sleep, contacts to warm start
+// and fast bodies to be swept
+const regress_case_t regressCases[] = {
+    {"random_balls", REGRESS_SCENARIO, SCENARIO_RANDOM_BALLS, 120, 360, 0},
+    {"packed_pile", REGRESS_SCENARIO, SCENARIO_PACKED_PILE, 120, 360, 400},
+    {"rect_stacks", REGRESS_SCENARIO, SCENARIO_RECT_STACKS, 120, 360, 400},
+    {"mixed", REGRESS_SCENARIO, SCENARIO_MIXED, 120, 360, 0},
+    {"rect_pairs", REGRESS_RECT_PAIRS, 0, 0, 600, 0},
+    {"particles", REGRESS_PARTICLES, 0, 600, 120, 0},
+    {"handles", REGRESS_HANDLES, SCENARIO_MIXED, 60, 360, 400},
+};
+// timed by --perf, big enough that a step is mostly the solver and not overhead
+const regress_case_t regressPerfCases[] = {
+    {"mixed", REGRESS_SCENARIO, SCENARIO_MIXED, 2000, 300, 0},
+    {"particles", REGRESS_PARTICLES, 0, 10000, 60, 0},
+};
+const double regressDeltaTime = 1 / 360.0;
+const double regressParticleDeltaTime = 1 / 60.0; // particles substep on their own, they're stepped once a frame
+const int regressPerfWarmupSteps = 10;
+const char *worldColumnNames[REGRESS_COLUMNS] = {"positionX", "positionY", "velocityX", "velocityY", "radian", "spinningVelocity"};
+
+double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool ParseRegressOptions(int argc, char **argv, regress_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--update") == 0)
+        {
+            options->update = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (strcmp(argv[i], "--golden") == 0)
+        {
+            options->goldenDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--case") == 0)
+        {
+            options->caseName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            options->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0)
+        {
+            options->tolerance = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--perf") == 0)
+        {
+            options->perfPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--max-slowdown") == 0)
+        {
+            options->maxSlowdown = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--repeats") == 0)
+        {
+            options->repeats = atoi(argv[++i]);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options->threads > 0 && options->tolerance >= 0 && options->maxSlowdown >= 0 && options->maxSlowdown < 1 && options->repeats > 0;
+}
+
+void AddRegressRow(regress_state_t *state, const char *kind, int index, const double *values, int columns)
+{
+    if (state->count == state->max)
+    {
+        state->max = state->max > 0 ? state->max * 2 : 256;
+        state->rows = realloc(state->rows, sizeof(regress_row_t) * state->max);
+    }
+    regress_row_t *row = &state->rows[state->count++];
+    snprintf(row->kind, sizeof(row->kind), "%s", kind);
+    row->index = index;
+    row->columns = columns;
+    memcpy(row->values, values, sizeof(double) * columns);
+}
+
+void AddShapesRows(regress_state_t *state, const char *kind, const shapes_t *shapes, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double values[REGRESS_COLUMNS] = {shapes->positionX[i], shapes->positionY[i], shapes->velocityX[i],
+                                          shapes->velocityY[i], shapes->radian[i], shapes->spinningVelocity[i]};
+        AddRegressRow(state, kind, i, values, REGRESS_COLUMNS);
+    }
+}
+
+// rects thrown at each other at different angles, spins, masses and sizes, and balls thrown at turned rects,
+// the contacts whose points and relative velocities are easiest to get wrong
+void AddRectPairs(world_t *world)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        real_t y = 60 + i * 80;
+        real_t radian = (real_t)0.37 * i;
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){200, y}, 10 + i, radian, (VReal_t){120, 0}, (real_t)1.5 - (real_t)0.4 * i, false}, (VReal_t){40 + 5 * i, 20}});
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){400, y + 10 * (i % 3)}, 10, -radian, (VReal_t){-90, 10 * (i % 2)}, (real_t)-0.5, false}, (VReal_t){30, 30 + 4 * i}});
+        WorldAddRect(world, (rect_t){(shape_t){(VReal_t){560, y - 10}, 20, 2 * radian, (VReal_t){0, 0}, 2, false}, (VReal_t){50, 25}});
+        WorldAddBall(world, (ball_t){(shape_t){(VReal_t){760, y}, 5, 0, (VReal_t){-150, 20 * (i % 2)}, 0, false}, 12});
+    }
+}
+
+body_handle_t GetRegressHandle(const world_t *world, body_kind_t kind, int index)
+{
+    const body_slots_t *slots = kind == BODY_BALL ? &world->balls.slots : &world->rects.slots;
+    int slot = kind == BODY_BALL ? world->balls.base.slot[index] : world->rects.base.slot[index];
+    return (body_handle_t){kind, slot, slots->generations[slot]};
+}
+
+// a row per handle with the index it resolves to
+void AddHandleRows(regress_state_t *state, const world_t *world, const body_handle_t *handles, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double index = WorldGetBodyIndex(world, handles[i]);
+        AddRegressRow(state, "handle", i, &index, 1);
+    }
+}
+
+// bodies are removed, a snapshot is taken, bodies are added and removed and the snapshot is restored, all while every
+// handle is held on to: handles of bodies the restore took away have to stop resolving instead of naming a free slot,
+// and removing through them has to leave the world alone
+void StepHandleChurn(world_t *world, const regress_case_t *regressCase, regress_state_t *state)
+{
+    body_handle_t handles[REGRESS_MAX_HANDLES];
+    int count = 0;
+    for (int i = 0; i < world->balls.pointer; i++)
+    {
+        handles[count++] = GetRegressHandle(world, BODY_BALL, i);
+    }
+    for (int i = 0; i < world->rects.pointer; i++)
+    {
+        handles[count++] = GetRegressHandle(world, BODY_RECT, i);
+    }
+    world_snapshot_t snapshot = {0};
+    int snapshotCount = 0;
+    for (int step = 0; step < regressCase->steps; step++)
+    {
+        if (step == 60)
+        {
+            for (int i = 0; i < count; i += 3)
+            {
+                WorldRemoveBody(world, handles[i]);
+            }
+        }
+        if (step == 120)
+        {
+            WorldSnapshot(world, &snapshot);
+            snapshotCount = count;
+        }
+        if (step == 180)
+        {
+            // the new bodies take the slots freed at step 60, then some of them and some old ones go again
+            for (int i = 0; i < 8; i++)
+            {
+                handles[count++] = WorldAddBall(world, (ball_t){(shape_t){(VReal_t){100 + i * 60, 50}, 5, 0, (VReal_t){0, 0}, 0, false}, 10});
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                handles[count++] = WorldAddRect(world, (rect_t){(shape_t){(VReal_t){100 + i * 120, 100}, 10, 0, (VReal_t){0, 0}, 0, false}, (VReal_t){30, 20}});
+            }
+            for (int i = 1; i < count; i += 5)
+            {
+                WorldRemoveBody(world, handles[i]);
+            }
+        }
+        if (step == 240)
+        {
+            WorldRestore(world, &snapshot);
+            AddHandleRows(state, world, handles, count);
+            for (int i = snapshotCount; i < count; i++)
+            {
+                WorldRemoveBody(world, handles[i]);
+            }
+        }
+        WorldStep(world, regressDeltaTime);
+    }
+    FreeSnapshot(&snapshot);
+    AddHandleRows(state, world, handles, count);
+}
+
+// the state after the case's steps, every body or particle in the order the lists keep them
+void RunRegressCase(const regress_case_t *regressCase, int threads, regress_state_t *state)
+{
+    state->count = 0;
+    if (regressCase->scene == REGRESS_PARTICLES)
+    {
+        particles_t *particles = CreateParticleScenario(regressCase->bodies, 1);
+        ParticlesSetThreads(particles, threads);
+        for (int step = 0; step < regressCase->steps; step++)
+        {
+            ParticlesStep(particles, regressParticleDeltaTime);
+        }
+        for (int i = 0; i < particles->count; i++)
+        {
+            double values[] = {particles->positionX[i], particles->positionY[i], particles->velocityX[i], particles->velocityY[i]};
+            AddRegressRow(state, "particle", i, values, 4);
+        }
+        ParticlesDestroy(particles);
+        return;
+    }
+    world_t *world = WorldCreate();
+    if (regressCase->scene == REGRESS_RECT_PAIRS)
+    {
+        AddRectPairs(world);
+    }
+    else
+    {
+        GenerateScenario(world, regressCase->scenario, regressCase->bodies, 1);
+    }
+    world->params.gravity = regressCase->gravity;
+    WorldSetThreads(world, threads);
+    if (regressCase->scene == REGRESS_HANDLES)
+    {
+        StepHandleChurn(world, regressCase, state);
+    }
+    else
+    {
+        for (int step = 0; step < regressCase->steps; step++)
+        {
+            WorldStep(world, regressDeltaTime);
+        }
+    }
+    AddShapesRows(state, "ball", &world->balls.base, world->balls.pointer);
+    AddShapesRows(state, "rect", &world->rects.base, world->rects.pointer);
+    WorldDestroy(world);
+}
+
+void GetGoldenPath(char *path, size_t size, const char *dir, const regress_case_t *regressCase)
+{
+    snprintf(path, size, "%s/%s/%s.txt", dir, REAL_NAME, regressCase->name);
+}
+
+bool WriteGolden(const char *path, const regress_case_t *regressCase, const regress_state_t *state)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fprintf(file, "# %s, %s, %d steps, written by regress --update\n", regressCase->name, REAL_NAME, regressCase->steps);
+    fprintf(file, "# kind index positionX positionY velocityX velocityY [radian spinningVelocity], or handle index bodyIndex\n");
+    for (int i = 0; i < state->count; i++)
+    {
+        const regress_row_t *row = &state->rows[i];
+        fprintf(file, "%s %d", row->kind, row->index);
+        for (int column = 0; column < row->columns; column++)
+        {
+            fprintf(file, " %a", row->values[column]);
+        }
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+
+bool ReadGolden(const char *path, regress_state_t *state)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+    state->count = 0;
+    char line[REGRESS_LINE_SIZE];
+    bool valid = true;
+    while (valid && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+        char kind[16];
+        int index;
+        int consumed;
+        valid = sscanf(line, "%15s %d%n", kind, &index, &consumed) == 2;
+        double values[REGRESS_COLUMNS];
+        int columns = 0;
+        const char *text = line + consumed;
+        while (valid && columns < REGRESS_COLUMNS)
+        {
+            char *end;
+            double value = strtod(text, &end);
+            if (end == text)
+            {
+                break;
+            }
+            values[columns++] = value;
+            text = end;
+        }
+        if (valid)
+        {
+            AddRegressRow(state, kind, index, values, columns);
+        }
+    }
+    fclose(file);
+    return valid;
+}
+
+// prints the first differences and returns false if there are any
+bool CompareRegressState(const regress_case_t *regressCase, const regress_state_t *golden, const regress_state_t *state, double tolerance)
+{
+    if (golden->count != state->count)
+    {
+        printf("%s: %d rows, the golden file has %d\n", regressCase->name, state->count, golden->count);
+        return false;
+    }
+    int mismatches = 0;
+    double largest = 0;
+    for (int i = 0; i < state->count; i++)
+    {
+        const regress_row_t *expected = &golden->rows[i];
+        const regress_row_t *row = &state->rows[i];
+        if (strcmp(expected->kind, row->kind) != 0 || expected->index != row->index || expected->columns != row->columns)
+        {
+            printf("%s: row %d is %s %d, the golden file has %s %d\n", regressCase->name, i, row->kind, row->index, expected->kind, expected->index);
+            return false;
+        }
+        for (int column = 0; column < row->columns; column++)
+        {
+            double value = row->values[column];
+            double expectedValue = expected->values[column];
+            double difference = fabs(value - expectedValue);
+            // bit for bit without a tolerance, so even a sign of zero or a different NaN counts
+            bool same = tolerance > 0 ? difference <= tolerance * (1 + fabs(expectedValue)) : memcmp(&value, &expectedValue, sizeof(double)) == 0;
+            if (same)
+            {
+                continue;
+            }
+            largest = isnan(difference) || difference > largest ? difference : largest;
+            if (mismatches++ < REGRESS_MAX_REPORTED)
+            {
+                const char *columnName = strcmp(row->kind, "handle") == 0 ? "bodyIndex" : worldColumnNames[column];
+                printf("%s: %s %d %s is %a (%.17g), golden %a (%.17g)\n", regressCase->name, row->kind, row->index, columnName,
+                       value, value, expectedValue, expectedValue);
+            }
+        }
+    }
+    if (mismatches > 0)
+    {
+        printf("%s: %d values differ, the largest by %g\n", regressCase->name, mismatches, largest);
+    }
+    return mismatches == 0;
+}
+
+int RunGolden(const regress_options_t *options)
+{
+    regress_state_t state = {0};
+    regress_state_t golden = {0};
+    int failed = 0;
+    int ran = 0;
+    for (size_t i = 0; i < sizeof(regressCases) / sizeof(regressCases[0]); i++)
+    {
+        const regress_case_t *regressCase = &regressCases[i];
+        if (options->caseName != NULL && strcmp(options->caseName, regressCase->name) != 0)
+        {
+            continue;
+        }
+        ran++;
+        char path[REGRESS_LINE_SIZE];
+        GetGoldenPath(path, sizeof(path), options->goldenDir, regressCase);
+        RunRegressCase(regressCase, options->threads, &state);
+        if (options->update)
+        {
+            bool written = WriteGolden(path, regressCase, &state);
+            printf("%s: %s %s\n", regressCase->name, written ? "wrote" : "can't write", path);
+            failed += !written;
+            continue;
+        }
+        if (!ReadGolden(path, &golden))
+        {
+            printf("%s: can't read %s, regress --update records it\n", regressCase->name, path);
+            failed++;
+            continue;
+        }
+        bool same = CompareRegressState(regressCase, &golden, &state, options->tolerance);
+        printf("%s: %s\n", regressCase->name, same ? "ok" : "changed");
+        failed += !same;
+    }
+    free(state.rows);
+    free(golden.rows);
+    printf("%s, %s kernels, %d threads: %d of %d cases %s\n", REAL_NAME, GetPhysicsKernelsName(), options->threads,
+           options->update ? ran - failed : failed, ran, options->update ? "written" : "failed");
+    return failed > 0 || ran == 0 ? 1 : 0;
+}
+
+int CompareDoubles(const void *a, const void *b)
+{
+    double first = *(const double *)a;
+    double second = *(const double *)b;
+    return (first > second) - (first < second);
+}
+
+// the median steps/sec of repeats runs, a machine that is busy or changes its clock for a run doesn't move it
+double TimeRegressCase(const regress_case_t *regressCase, int threads, int repeats)
+{
+    double *runs = malloc(sizeof(double) * repeats);
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        double seconds;
+        if (regressCase->scene == REGRESS_PARTICLES)
+        {
+            particles_t *particles = CreateParticleScenario(regressCase->bodies, 1);
+            ParticlesSetThreads(particles, threads);
+            for (int step = 0; step < regressPerfWarmupSteps; step++)
+            {
+                ParticlesStep(particles, regressParticleDeltaTime);
+            }
+            double start = GetSeconds();
+            for (int step = 0; step < regressCase->steps; step++)
+            {
+                ParticlesStep(particles, regressParticleDeltaTime);
+            }
+            seconds = GetSeconds() - start;
+            ParticlesDestroy(particles);
+        }
+        else
+        {
+            world_t *world = WorldCreate();
+            GenerateScenario(world, regressCase->scenario, regressCase->bodies, 1);
+            world->params.gravity = regressCase->gravity;
+            WorldSetThreads(world, threads);
+            for (int step = 0; step < regressPerfWarmupSteps; step++)
+            {
+                WorldStep(world, regressDeltaTime);
+            }
+            double start = GetSeconds();
+            for (int step = 0; step < regressCase->steps; step++)
+            {
+                WorldStep(world, regressDeltaTime);
+            }
+            seconds = GetSeconds() - start;
+            WorldDestroy(world);
+        }
+        runs[repeat] = seconds > 0 ? regressCase->steps / seconds : 0;
+    }
+    qsort(runs, repeats, sizeof(double), CompareDoubles);
+    double median = repeats % 2 == 1 ? runs[repeats / 2] : (runs[repeats / 2 - 1] + runs[repeats / 2]) / 2;
+    free(runs);
+    return median;
+}
+
+// the baseline has a line "PRECISION SCENE STEPS_PER_SEC" per reference scene, comments start with #
+// a scene without a line for this precision is timed and reported but can't fail
+int RunPerf(const regress_options_t *options)
+{
+    char lines[REGRESS_MAX_PERF_LINES][REGRESS_LINE_SIZE];
+    int linesCount = 0;
+    FILE *file = fopen(options->perfPath, "r");
+    while (file != NULL && linesCount < REGRESS_MAX_PERF_LINES && fgets(lines[linesCount], REGRESS_LINE_SIZE, file) != NULL)
+    {
+        linesCount++;
+    }
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    else if (!options->update)
+    {
+        perror(options->perfPath);
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(regressPerfCases) / sizeof(regressPerfCases[0]); i++)
+    {
+        const regress_case_t *regressCase = &regressPerfCases[i];
+        double stepsPerSecond = TimeRegressCase(regressCase, options->threads, options->repeats);
+        int baselineLine = -1;
+        double baseline = 0;
+        for (int line = 0; line < linesCount; line++)
+        {
+            char precision[32];
+            char scene[64];
+            double value;
+            if (sscanf(lines[line], "%31s %63s %lf", precision, scene, &value) == 3 && precision[0] != '#' &&
+                strcmp(precision, REAL_NAME) == 0 && strcmp(scene, regressCase->name) == 0)
+            {
+                baselineLine = line;
+                baseline = value;
+            }
+        }
+        if (options->update)
+        {
+            baselineLine = baselineLine >= 0 ? baselineLine : linesCount++;
+            if (baselineLine >= REGRESS_MAX_PERF_LINES)
+            {
+                fprintf(stderr, "%s: more than %d lines\n", options->perfPath, REGRESS_MAX_PERF_LINES);
+                return 1;
+            }
+            snprintf(lines[baselineLine], REGRESS_LINE_SIZE, "%s %s %.1f\n", REAL_NAME, regressCase->name, stepsPerSecond);
+            printf("%s: %.1f steps/sec recorded\n", regressCase->name, stepsPerSecond);
+            continue;
+        }
+        if (baselineLine < 0)
+        {
+            printf("%s: %.1f steps/sec, no %s baseline to compare with\n", regressCase->name, stepsPerSecond, REAL_NAME);
+            continue;
+        }
+        bool slow = stepsPerSecond < baseline * (1 - options->maxSlowdown);
+        printf("%s: %.1f steps/sec, baseline %.1f, %+.1f%%%s\n", regressCase->name, stepsPerSecond, baseline,
+               baseline > 0 ? (stepsPerSecond / baseline - 1) * 100 : 0, slow ? ", too slow" : "");
+        failed += slow;
+    }
+    if (options->update)
+    {
+        file = fopen(options->perfPath, "w");
+        if (file == NULL)
+        {
+            perror(options->perfPath);
+            return 1;
+        }
+        for (int line = 0; line < linesCount; line++)
+        {
+            fputs(lines[line], file);
+        }
+        fclose(file);
+        return 0;
+    }
+    printf("%s, %s kernels, %d threads: %d scenes more than %.0f%% slower than the baseline\n", REAL_NAME, GetPhysicsKernelsName(),
+           options->threads, failed, options->maxSlowdown * 100);
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    regress_options_t options = {"golden", NULL, 1, 0, NULL, 0.35, 5, false};
+    if (!ParseRegressOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "usage: %s [--golden DIR] [--case NAME] [--threads N] [--tolerance X] [--update]\n"
+                        "       %s --perf FILE [--max-slowdown FRACTION] [--repeats N] [--update]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    return options.perfPath != NULL ? RunPerf(&options) : RunGolden(&options);
+}
@@ -0,0 +1,536 @@
+#include "replay.h"
+#include "scene.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REPLAY_COLUMNS 3 // position x, position y, radian
+#define REPLAY_GROUP 64
+
+const double replayPositionScale = 1024;
+const double replayRadianScale = 65536;
+const size_t replayMaxQueuedBytes = 64 << 20; // the stepping thread waits for the writer past this
+
+typedef struct replay_block_t
+{
+    unsigned char *data;
+    size_t size;
+    size_t max;
+    struct replay_block_t *next;
+} replay_block_t;
+
+struct replay_recorder_t
+{
+    FILE *file;
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t blockQueued;
+    pthread_cond_t blockWritten;
+    replay_block_t *queueHead;
+    replay_block_t *queueTail;
+    replay_block_t *freeBlocks; // written blocks are reused instead of freed
+    size_t queuedBytes;
+    long long writtenBytes;
+    bool failed;
+    bool quit;
+
+    int keyframeInterval;
+    long long frames;
+    int ballsCount; // of the last frame, -1 before the first
+    int rectsCount;
+    world_snapshot_t snapshot; // keyframes are taken into this, then copied into their block
+
+    // only touched by the writer
+    long long *quantized; // last frame's values, REPLAY_COLUMNS per body
+    int quantizedMax;
+    long long *currentQuantized; // this frame's values while its deltas are encoded
+    int currentQuantizedMax;
+    replay_block_t encoded;
+};
+
+struct replay_t
+{
+    unsigned char *mapping;
+    size_t size;
+    replay_file_header_t header;
+    size_t *frameOffsets;
+    long long framesCount;
+    long long currentFrame; // -1 until the first seek
+    long long *quantized;
+    int quantizedMax;
+    real_t *columns; // the world's positions and rotations while they are quantized
+    int columnsMax;
+};
+
+void ReserveReplayBytes(replay_block_t *block, size_t size)
+{
+    if (block->size + size > block->max)
+    {
+        block->max = block->max > 0 ? block->max : 4096;
+        while (block->size + size > block->max)
+        {
+            block->max *= 2;
+        }
+        block->data = realloc(block->data, block->max);
+    }
+}
+
+void AppendReplayBytes(replay_block_t *block, const void *data, size_t size)
+{
+    ReserveReplayBytes(block, size);
+    memcpy(&block->data[block->size], data, size);
+    block->size += size;
+}
+
+// small signed deltas of either sign become small unsigned values
+unsigned long long GetZigZag(long long value)
+{
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+long long GetFromZigZag(unsigned long long value)
+{
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+void EnsureQuantizedSize(long long **quantized, int *max, int count)
+{
+    if (*max < count)
+    {
+        *max = count;
+        *quantized = realloc(*quantized, sizeof(long long) * REPLAY_COLUMNS * count);
+    }
+}
+
+// rounds half away from zero without a libm call, recorder and player only have to agree with each other
+long long GetQuantized(double value, double scale)
+{
+    double scaled = value * scale;
+    return (long long)(scaled + (scaled >= 0 ? 0.5 : -0.5));
+}
+
+// position x, position y and radian of the balls, then the same for the rects, each column contiguous
+// the recorder and the player both quantize this layout so their deltas line up
+void CopyReplayColumns(const world_t *world, real_t *columns)
+{
+    const shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    for (int list = 0; list < 2; list++)
+    {
+        memcpy(columns, lists[list]->positionX, sizeof(real_t) * counts[list]);
+        memcpy(&columns[counts[list]], lists[list]->positionY, sizeof(real_t) * counts[list]);
+        memcpy(&columns[2 * counts[list]], lists[list]->radian, sizeof(real_t) * counts[list]);
+        columns += REPLAY_COLUMNS * counts[list];
+    }
+}
+
+void QuantizeColumns(const real_t *columns, long long *quantized, int ballsCount, int rectsCount, double positionScale, double radianScale)
+{
+    int counts[2] = {ballsCount, rectsCount};
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < 2 * counts[list]; i++)
+        {
+            quantized[i] = GetQuantized(columns[i], positionScale);
+        }
+        for (int i = 2 * counts[list]; i < REPLAY_COLUMNS * counts[list]; i++)
+        {
+            quantized[i] = GetQuantized(columns[i], radianScale);
+        }
+        columns += REPLAY_COLUMNS * counts[list];
+        quantized += REPLAY_COLUMNS * counts[list];
+    }
+}
+
+void DequantizeWorld(world_t *world, const long long *quantized, double positionScale, double radianScale)
+{
+    shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < counts[list]; i++)
+        {
+            lists[list]->positionX[i] = quantized[i] / positionScale;
+            lists[list]->positionY[i] = quantized[counts[list] + i] / positionScale;
+            lists[list]->radian[i] = quantized[2 * counts[list] + i] / radianScale;
+        }
+        quantized += REPLAY_COLUMNS * counts[list];
+    }
+    for (int i = 0; i < world->rects.pointer; i++)
+    {
+        world->rects.cosRadian[i] = cos(world->rects.base.radian[i]);
+        world->rects.sinRadian[i] = sin(world->rects.base.radian[i]);
+    }
+    WorldBodiesMoved(world);
+}
+
+// deltas go in groups of REPLAY_GROUP values, each stored with as many bytes as the largest one in its group needs
+// no per value branching, and a group of sleeping bodies is a single zero byte
+void AppendReplayDeltas(replay_block_t *block, const long long *current, long long *previous, int count)
+{
+    ReserveReplayBytes(block, (size_t)count * sizeof(long long) + (count + REPLAY_GROUP - 1) / REPLAY_GROUP);
+    unsigned char *bytes = &block->data[block->size];
+    for (int group = 0; group < count; group += REPLAY_GROUP)
+    {
+        int groupEnd = group + REPLAY_GROUP < count ? group + REPLAY_GROUP : count;
+        unsigned long long deltas[REPLAY_GROUP];
+        unsigned long long used = 0;
+        for (int i = group; i < groupEnd; i++)
+        {
+            deltas[i - group] = GetZigZag(current[i] - previous[i]);
+            used |= deltas[i - group];
+            previous[i] = current[i];
+        }
+        int width = 0;
+        while (width < 8 && (used >> (8 * width)) != 0)
+        {
+            width++;
+        }
+        *bytes++ = (unsigned char)width;
+        for (int i = 0; i < groupEnd - group; i++)
+        {
+            for (int byte = 0; byte < width; byte++)
+            {
+                *bytes++ = (unsigned char)(deltas[i] >> (8 * byte));
+            }
+        }
+    }
+    block->size = bytes - block->data;
+}
+
+bool ApplyReplayDeltas(const unsigned char *bytes, const unsigned char *end, long long *values, int count)
+{
+    for (int group = 0; group < count; group += REPLAY_GROUP)
+    {
+        int groupEnd = group + REPLAY_GROUP < count ? group + REPLAY_GROUP : count;
+        if (bytes >= end)
+        {
+            return false;
+        }
+        int width = *bytes++;
+        if (width > 8 || end - bytes < (long)width * (groupEnd - group))
+        {
+            return false;
+        }
+        for (int i = group; i < groupEnd && width > 0; i++)
+        {
+            unsigned long long delta = 0;
+            for (int byte = 0; byte < width; byte++)
+            {
+                delta |= (unsigned long long)*bytes++ << (8 * byte);
+            }
+            values[i] += GetFromZigZag(delta);
+        }
+    }
+    return true;
+}
+
+// turns a queued frame into its file form, keyframes are written as they are and only reset the delta reference
+bool WriteReplayFrame(replay_recorder_t *recorder, const replay_block_t *block)
+{
+    replay_frame_header_t header;
+    memcpy(&header, block->data, sizeof(header));
+    int count = REPLAY_COLUMNS * (header.ballsCount + header.rectsCount);
+    const real_t *columns = (const real_t *)&block->data[sizeof(header)];
+    const unsigned char *snapshot = &block->data[sizeof(header) + sizeof(real_t) * count];
+    EnsureQuantizedSize(&recorder->quantized, &recorder->quantizedMax, header.ballsCount + header.rectsCount);
+    EnsureQuantizedSize(&recorder->currentQuantized, &recorder->currentQuantizedMax, header.ballsCount + header.rectsCount);
+    replay_block_t *encoded = &recorder->encoded;
+    encoded->size = 0;
+    AppendReplayBytes(encoded, &header, sizeof(header));
+    if (header.kind == REPLAY_FRAME_KEY)
+    {
+        QuantizeColumns(columns, recorder->quantized, header.ballsCount, header.rectsCount, replayPositionScale, replayRadianScale);
+        AppendReplayBytes(encoded, snapshot, &block->data[block->size] - snapshot);
+    }
+    else
+    {
+        QuantizeColumns(columns, recorder->currentQuantized, header.ballsCount, header.rectsCount, replayPositionScale, replayRadianScale);
+        AppendReplayDeltas(encoded, recorder->currentQuantized, recorder->quantized, count);
+    }
+    header.payloadSize = encoded->size - sizeof(header);
+    memcpy(encoded->data, &header, sizeof(header));
+    recorder->writtenBytes += encoded->size;
+    return fwrite(encoded->data, 1, encoded->size, recorder->file) == encoded->size;
+}
+
+void *RunReplayWriter(void *argument)
+{
+    replay_recorder_t *recorder = argument;
+    pthread_mutex_lock(&recorder->mutex);
+    while (true)
+    {
+        while (recorder->queueHead == NULL && !recorder->quit)
+        {
+            pthread_cond_wait(&recorder->blockQueued, &recorder->mutex);
+        }
+        replay_block_t *block = recorder->queueHead;
+        if (block == NULL)
+        {
+            break; // quit with nothing left to write
+        }
+        recorder->queueHead = block->next;
+        recorder->queueTail = recorder->queueHead != NULL ? recorder->queueTail : NULL;
+        pthread_mutex_unlock(&recorder->mutex);
+
+        bool written = WriteReplayFrame(recorder, block);
+
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->failed = recorder->failed || !written;
+        recorder->queuedBytes -= block->size;
+        block->next = recorder->freeBlocks;
+        recorder->freeBlocks = block;
+        pthread_cond_signal(&recorder->blockWritten);
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+    return NULL;
+}
+
+replay_recorder_t *ReplayRecorderStart(const char *path, int keyframeInterval)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    replay_recorder_t *recorder = calloc(1, sizeof(replay_recorder_t));
+    recorder->file = file;
+    recorder->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    recorder->ballsCount = -1;
+    recorder->rectsCount = -1;
+    pthread_mutex_init(&recorder->mutex, NULL);
+    pthread_cond_init(&recorder->blockQueued, NULL);
+    pthread_cond_init(&recorder->blockWritten, NULL);
+
+    replay_file_header_t header = {{0}, REPLAY_FILE_VERSION, recorder->keyframeInterval, replayPositionScale, replayRadianScale};
+    memcpy(header.magic, REPLAY_FILE_MAGIC, sizeof(header.magic));
+    recorder->failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    recorder->writtenBytes = sizeof(header);
+    pthread_create(&recorder->writer, NULL, RunReplayWriter, recorder);
+    return recorder;
+}
+
+// the stepping thread only copies, quantizing and encoding happen on the writer
+void ReplayRecord(replay_recorder_t *recorder, const world_t *world)
+{
+    pthread_mutex_lock(&recorder->mutex);
+    while (recorder->queuedBytes > replayMaxQueuedBytes)
+    {
+        pthread_cond_wait(&recorder->blockWritten, &recorder->mutex);
+    }
+    replay_block_t *block = recorder->freeBlocks;
+    recorder->freeBlocks = block != NULL ? block->next : NULL;
+    pthread_mutex_unlock(&recorder->mutex);
+    block = block != NULL ? block : calloc(1, sizeof(replay_block_t));
+    block->size = 0;
+    block->next = NULL;
+
+    int ballsCount = world->balls.pointer;
+    int rectsCount = world->rects.pointer;
+    bool keyframe = recorder->frames % recorder->keyframeInterval == 0 || ballsCount != recorder->ballsCount || rectsCount != recorder->rectsCount;
+    replay_frame_header_t header = {0, recorder->frames, ballsCount, rectsCount, keyframe ? REPLAY_FRAME_KEY : REPLAY_FRAME_DELTA, 0};
+    size_t columnsSize = sizeof(real_t) * REPLAY_COLUMNS * (ballsCount + rectsCount);
+    AppendReplayBytes(block, &header, sizeof(header));
+    ReserveReplayBytes(block, columnsSize);
+    CopyReplayColumns(world, (real_t *)&block->data[block->size]);
+    block->size += columnsSize;
+    if (keyframe)
+    {
+        WorldSnapshot(world, &recorder->snapshot);
+        AppendReplayBytes(block, recorder->snapshot.data, recorder->snapshot.size);
+    }
+    recorder->frames++;
+    recorder->ballsCount = ballsCount;
+    recorder->rectsCount = rectsCount;
+
+    pthread_mutex_lock(&recorder->mutex);
+    if (recorder->queueTail != NULL)
+    {
+        recorder->queueTail->next = block;
+    }
+    else
+    {
+        recorder->queueHead = block;
+    }
+    recorder->queueTail = block;
+    recorder->queuedBytes += block->size;
+    pthread_cond_signal(&recorder->blockQueued);
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+bool ReplayRecorderStop(replay_recorder_t *recorder, long long *recordedBytes)
+{
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->quit = true;
+    pthread_cond_signal(&recorder->blockQueued);
+    pthread_mutex_unlock(&recorder->mutex);
+    pthread_join(recorder->writer, NULL);
+
+    if (recordedBytes != NULL)
+    {
+        *recordedBytes = recorder->writtenBytes;
+    }
+    bool saved = !recorder->failed;
+    saved = fclose(recorder->file) == 0 && saved;
+    while (recorder->freeBlocks != NULL)
+    {
+        replay_block_t *next = recorder->freeBlocks->next;
+        free(recorder->freeBlocks->data);
+        free(recorder->freeBlocks);
+        recorder->freeBlocks = next;
+    }
+    pthread_mutex_destroy(&recorder->mutex);
+    pthread_cond_destroy(&recorder->blockQueued);
+    pthread_cond_destroy(&recorder->blockWritten);
+    free(recorder->quantized);
+    free(recorder->currentQuantized);
+    free(recorder->encoded.data);
+    FreeSnapshot(&recorder->snapshot);
+    free(recorder);
+    return saved;
+}
+
+replay_t *ReplayOpen(const char *path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return NULL;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(replay_file_header_t))
+    {
+        close(file);
+        return NULL;
+    }
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+    replay_t *replay = calloc(1, sizeof(replay_t));
+    replay->mapping = mapping;
+    replay->size = status.st_size;
+    replay->currentFrame = -1;
+    memcpy(&replay->header, mapping, sizeof(replay->header));
+    if (memcmp(replay->header.magic, REPLAY_FILE_MAGIC, sizeof(replay->header.magic)) != 0 || replay->header.version != REPLAY_FILE_VERSION)
+    {
+        ReplayClose(replay);
+        return NULL;
+    }
+
+    // one pass over the frame headers, seeking then jumps straight to any frame
+    // a delta frame is decoded into the buffers its keyframe sized, so its counts have to be the keyframe's
+    long long framesMax = 0;
+    int keyBallsCount = 0;
+    int keyRectsCount = 0;
+    size_t offset = sizeof(replay_file_header_t);
+    while (offset + sizeof(replay_frame_header_t) <= replay->size)
+    {
+        replay_frame_header_t frame;
+        memcpy(&frame, &replay->mapping[offset], sizeof(frame));
+        bool isKey = frame.kind == REPLAY_FRAME_KEY;
+        bool firstIsKey = replay->framesCount > 0 || isKey;
+        bool keyCounts = isKey || (frame.ballsCount == keyBallsCount && frame.rectsCount == keyRectsCount);
+        // compared against what's left instead of added up, a huge payloadSize would wrap around
+        if (frame.frame != replay->framesCount || !firstIsKey || !keyCounts || frame.ballsCount < 0 || frame.rectsCount < 0 ||
+            frame.payloadSize > replay->size - offset - sizeof(frame))
+        {
+            break;
+        }
+        if (isKey)
+        {
+            keyBallsCount = frame.ballsCount;
+            keyRectsCount = frame.rectsCount;
+        }
+        if (replay->framesCount == framesMax)
+        {
+            framesMax = framesMax > 0 ? framesMax * 2 : 1024;
+            replay->frameOffsets = realloc(replay->frameOffsets, sizeof(size_t) * framesMax);
+        }
+        replay->frameOffsets[replay->framesCount++] = offset;
+        offset += sizeof(frame) + frame.payloadSize;
+    }
+    return replay;
+}
+
+void ReplayClose(replay_t *replay)
+{
+    munmap(replay->mapping, replay->size);
+    free(replay->frameOffsets);
+    free(replay->quantized);
+    free(replay->columns);
+    free(replay);
+}
+
+long long GetReplayFrames(const replay_t *replay)
+{
+    return replay->framesCount;
+}
+
+void EnsureColumnsSize(replay_t *replay, int count)
+{
+    if (replay->columnsMax < count)
+    {
+        replay->columnsMax = count;
+        replay->columns = realloc(replay->columns, sizeof(real_t) * REPLAY_COLUMNS * count);
+    }
+}
+
+replay_frame_header_t GetReplayFrameHeader(const replay_t *replay, long long frame)
+{
+    replay_frame_header_t header;
+    memcpy(&header, &replay->mapping[replay->frameOffsets[frame]], sizeof(header));
+    return header;
+}
+
+bool ReplaySeek(replay_t *replay, world_t *world, long long frame)
+{
+    if (frame < 0 || frame >= replay->framesCount)
+    {
+        return false;
+    }
+    long long keyframe = frame;
+    while (GetReplayFrameHeader(replay, keyframe).kind != REPLAY_FRAME_KEY)
+    {
+        keyframe--;
+    }
+    // keep decoding forward when the last seek already got past the keyframe
+    long long next = replay->currentFrame >= keyframe && replay->currentFrame <= frame ? replay->currentFrame + 1 : keyframe;
+    replay->currentFrame = -1;
+    for (long long i = next; i <= frame; i++)
+    {
+        replay_frame_header_t header = GetReplayFrameHeader(replay, i);
+        const unsigned char *payload = &replay->mapping[replay->frameOffsets[i] + sizeof(header)];
+        if (header.kind == REPLAY_FRAME_KEY)
+        {
+            world_snapshot_t snapshot = {(unsigned char *)payload, header.payloadSize, header.payloadSize};
+            // the frame's counts size the buffers the deltas are decoded into, they have to be the snapshot's
+            if (!WorldRestore(world, &snapshot) || world->balls.pointer != header.ballsCount || world->rects.pointer != header.rectsCount)
+            {
+                return false;
+            }
+            EnsureQuantizedSize(&replay->quantized, &replay->quantizedMax, header.ballsCount + header.rectsCount);
+            EnsureColumnsSize(replay, header.ballsCount + header.rectsCount);
+            CopyReplayColumns(world, replay->columns);
+            QuantizeColumns(replay->columns, replay->quantized, header.ballsCount, header.rectsCount, replay->header.positionScale, replay->header.radianScale);
+        }
+        else if (!ApplyReplayDeltas(payload, payload + header.payloadSize, replay->quantized, REPLAY_COLUMNS * (header.ballsCount + header.rectsCount)))
+        {
+            return false;
+        }
+    }
+    if (GetReplayFrameHeader(replay, frame).kind != REPLAY_FRAME_KEY)
+    {
+        DequantizeWorld(world, replay->quantized, replay->header.positionScale, replay->header.radianScale);
+    }
+    replay->currentFrame = frame;
+    return true;
+}
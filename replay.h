@@ -0,0 +1,62 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include "physics.h"
+
+// records a run step by step for post-mortem playback
+// every keyframeInterval frames the full state is stored as a scene snapshot, the frames in between only store
+// positions and rotations, quantized and delta encoded against the frame before
+// encoding runs on the stepping thread, a background thread does the writing
+
+#define REPLAY_FILE_MAGIC "PHYREPLY"
+#define REPLAY_FILE_VERSION 1
+
+typedef enum replay_frame_kind_t
+{
+    REPLAY_FRAME_KEY,   // payload is a scene snapshot, exact
+    REPLAY_FRAME_DELTA, // payload is quantized position x, position y and radian deltas for balls, then rects, packed in groups of 64
+} replay_frame_kind_t;
+
+typedef struct replay_file_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t keyframeInterval;
+    double positionScale; // quantization steps per unit
+    double radianScale;   // quantization steps per radian
+} replay_file_header_t;
+
+typedef struct replay_frame_header_t
+{
+    uint64_t payloadSize; // bytes after this header
+    int64_t frame;
+    int32_t ballsCount;
+    int32_t rectsCount;
+    uint32_t kind;
+    uint32_t reserved;
+} replay_frame_header_t;
+
+typedef struct replay_recorder_t replay_recorder_t;
+typedef struct replay_t replay_t;
+
+// returns NULL if the file can't be created
+replay_recorder_t *ReplayRecorderStart(const char *path, int keyframeInterval);
+// adds the world's current state as the next frame, call it after every WorldStep
+// a frame with a different body count than the last one is always a keyframe
+void ReplayRecord(replay_recorder_t *recorder, const world_t *world);
+// writes what's still queued and closes the file, returns false if any write failed
+// recordedBytes gets the file size when it isn't NULL
+bool ReplayRecorderStop(replay_recorder_t *recorder, long long *recordedBytes);
+
+// maps a recording, a frame cut off by a crash at the end of the file is ignored
+replay_t *ReplayOpen(const char *path);
+void ReplayClose(replay_t *replay);
+long long GetReplayFrames(const replay_t *replay);
+// puts the state of frame into the world, decoding from the nearest keyframe at or before it
+// moving forward from the last seek only decodes the frames in between
+// keyframes are exact, delta frames have positions and rotations within half a quantization step and keep the
+// rest of the state from their keyframe
+bool ReplaySeek(replay_t *replay, world_t *world, long long frame);
+
+#endif
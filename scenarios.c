@@ -0,0 +1,176 @@
+#include "scenarios.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+const char *scenarioNames[SCENARIO_COUNT] = {"random_balls", "packed_pile", "rect_stacks", "mixed"};
+
+const double scenarioRandomFill = 0.3; // fraction of the map covered by scattered bodies
+const double scenarioPileHeight = 0.6; // fraction of the map height covered by the pile
+const double scenarioSpeed = 72;       // max starting speed in units/second, relative to the body size
+const double scenarioParticleSpacing = 2.2; // distance between particles of the starting block, in radii
+const double scenarioParticleGravity = 400; // units/second², the world default has none and a pile has to fall
+const double scenarioParticleRadius = 2.5;
+const double scenarioParticleRows = 64; // the map gets wider with the count, more rows than the substeps can carry the weight through boil
+
+const char *GetScenarioName(scenario_kind_t kind)
+{
+    return kind >= 0 && kind < SCENARIO_COUNT ? scenarioNames[kind] : "unknown";
+}
+
+bool GetScenarioFromName(const char *name, scenario_kind_t *kind)
+{
+    for (int i = 0; i < SCENARIO_COUNT; i++)
+    {
+        if (strcmp(name, scenarioNames[i]) == 0)
+        {
+            *kind = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// xorshift so a seed gives the same scene on every platform
+double GetRandomUnit(unsigned int *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return (*state & 0xffffff) / (double)0x1000000;
+}
+
+double GetRandomRange(unsigned int *state, double min, double max)
+{
+    return min + (max - min) * GetRandomUnit(state);
+}
+
+double GetMapArea(const world_t *world)
+{
+    return (double)(world->mapBounds.maxX - world->mapBounds.minX) * (world->mapBounds.maxY - world->mapBounds.minY);
+}
+
+// size of a body so that count of them cover fill of the map
+double GetScenarioBodySize(const world_t *world, int count, double fill)
+{
+    return sqrt(fill * GetMapArea(world) / (count > 0 ? count : 1));
+}
+
+VReal_t GetRandomVelocity(unsigned int *state, double size)
+{
+    double speed = scenarioSpeed * size;
+    return (VReal_t){GetRandomRange(state, -speed, speed), GetRandomRange(state, -speed, speed)};
+}
+
+void AddRandomBalls(world_t *world, int count, double size, unsigned int *state)
+{
+    bounds_t map = world->mapBounds;
+    for (int i = 0; i < count; i++)
+    {
+        double radius = GetRandomRange(state, 0.5, 1.5) * size / sqrt(PI);
+        VReal_t position = {GetRandomRange(state, map.minX + radius, map.maxX - radius), GetRandomRange(state, map.minY + radius, map.maxY - radius)};
+        WorldAddBall(world, (ball_t){(shape_t){position, radius * radius, 0, GetRandomVelocity(state, radius), 0, false}, radius});
+    }
+}
+
+void AddRandomRects(world_t *world, int count, double size, unsigned int *state)
+{
+    bounds_t map = world->mapBounds;
+    for (int i = 0; i < count; i++)
+    {
+        VReal_t rectSize = {GetRandomRange(state, 0.5, 1) * size, GetRandomRange(state, 0.5, 1) * size};
+        VReal_t position = {GetRandomRange(state, map.minX, map.maxX - rectSize.x), GetRandomRange(state, map.minY, map.maxY - rectSize.y)};
+        WorldAddRect(world, (rect_t){(shape_t){position, rectSize.x * rectSize.y, 0, GetRandomVelocity(state, size), 0, false}, rectSize});
+    }
+}
+
+void AddPackedPile(world_t *world, int count, unsigned int *state)
+{
+    // rows of equal balls offset by half a ball, so each one touches its neighbours
+    bounds_t map = world->mapBounds;
+    double rowHeight = sqrt(3) / 2;
+    double radius = sqrt(scenarioPileHeight * GetMapArea(world) / (4 * rowHeight * (count > 0 ? count : 1)));
+    int perRow = (int)((map.maxX - map.minX) / (2 * radius));
+    perRow = perRow > 1 ? perRow : 1;
+    for (int i = 0; i < count; i++)
+    {
+        int row = i / perRow;
+        int column = i % perRow;
+        double x = map.minX + radius + 2 * radius * column + (row % 2 == 1 ? radius : 0);
+        double y = map.maxY - radius - 2 * radius * rowHeight * row;
+        if (x > map.maxX - radius)
+        {
+            x = map.maxX - radius;
+        }
+        WorldAddBall(world, (ball_t){(shape_t){(VReal_t){x, y}, radius * radius, 0, GetRandomVelocity(state, radius * 0.05), 0, false}, radius});
+    }
+}
+
+void AddRectStacks(world_t *world, int count, unsigned int *state)
+{
+    // square columns with a gap of half a rect between them, height fills scenarioPileHeight of the map
+    bounds_t map = world->mapBounds;
+    double size = sqrt(scenarioPileHeight * GetMapArea(world) / (1.5 * (count > 0 ? count : 1)));
+    int columns = (int)((map.maxX - map.minX) / (1.5 * size));
+    columns = columns > 1 ? columns : 1;
+    for (int i = 0; i < count; i++)
+    {
+        int column = i % columns;
+        int level = i / columns;
+        VReal_t position = {map.minX + column * 1.5 * size + size / 4, map.maxY - size * (level + 1)};
+        WorldAddRect(world, (rect_t){(shape_t){position, size * size, 0, GetRandomVelocity(state, size * 0.05), 0, false}, (VReal_t){size, size}});
+    }
+}
+
+void GenerateScenario(world_t *world, scenario_kind_t kind, int bodies, unsigned int seed)
+{
+    unsigned int state = seed != 0 ? seed : 1;
+    switch (kind)
+    {
+    case SCENARIO_RANDOM_BALLS:
+        AddRandomBalls(world, bodies, GetScenarioBodySize(world, bodies, scenarioRandomFill), &state);
+        break;
+    case SCENARIO_PACKED_PILE:
+        AddPackedPile(world, bodies, &state);
+        break;
+    case SCENARIO_RECT_STACKS:
+        AddRectStacks(world, bodies, &state);
+        break;
+    case SCENARIO_MIXED:
+        AddRandomBalls(world, bodies / 2, GetScenarioBodySize(world, bodies, scenarioRandomFill), &state);
+        AddRandomRects(world, bodies - bodies / 2, GetScenarioBodySize(world, bodies, scenarioRandomFill), &state);
+        break;
+    default:
+        break;
+    }
+}
+
+particles_t *CreateParticleScenario(int count, unsigned int seed)
+{
+    unsigned int state = seed != 0 ? seed : 1;
+    double radius = scenarioParticleRadius;
+    double spacing = scenarioParticleSpacing * radius;
+    int perRow = (int)ceil((count > 0 ? count : 1) / scenarioParticleRows);
+    particles_t *particles = ParticlesCreate((float)radius);
+    if (particles == NULL)
+    {
+        return NULL;
+    }
+    particles->mapBounds = (bounds_t){0, 0, perRow * spacing, 2 * scenarioParticleRows * spacing};
+    particles->gravity = (float)scenarioParticleGravity;
+    ParticlesReserve(particles, count);
+    for (int i = 0; i < count; i++)
+    {
+        int row = i / perRow;
+        int column = i % perRow;
+        double jitter = 0.05 * radius;
+        double x = spacing * (column + 0.5) + GetRandomRange(&state, -jitter, jitter);
+        double y = particles->mapBounds.maxY - spacing * (row + 0.5) + GetRandomRange(&state, -jitter, jitter);
+        VReal_t velocity = GetRandomVelocity(&state, radius * 0.05);
+        ParticlesAdd(particles, (float)x, (float)y, (float)velocity.x, (float)velocity.y);
+    }
+    return particles;
+}
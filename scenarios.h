@@ -0,0 +1,27 @@
+#ifndef SCENARIOS_H
+#define SCENARIOS_H
+
+#include "physics.h"
+#include "particles.h"
+
+// parametric scenes for the headless and bench executables
+// the same kind, body count and seed always produce the same scene
+typedef enum scenario_kind_t
+{
+    SCENARIO_RANDOM_BALLS, // balls of mixed radius scattered over the whole map
+    SCENARIO_PACKED_PILE,  // equal balls in a touching hexagonal pile on the floor
+    SCENARIO_RECT_STACKS,  // columns of touching rects standing on the floor
+    SCENARIO_MIXED,        // half random balls, half random rects
+    SCENARIO_COUNT
+} scenario_kind_t;
+
+const char *GetScenarioName(scenario_kind_t kind);
+// returns false if the name doesn't match any scenario
+bool GetScenarioFromName(const char *name, scenario_kind_t *kind);
+// spreads the bodies over the map bounds the world has when called
+void GenerateScenario(world_t *world, scenario_kind_t kind, int bodies, unsigned int seed);
+// a loose block of count particles standing on the floor that collapses into a pile, the map bounds are set as wide as
+// the block and twice as high, NULL if out of memory
+particles_t *CreateParticleScenario(int count, unsigned int seed);
+
+#endif
@@ -0,0 +1,286 @@
+#include "scene.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SCENE_MAX_COLUMNS 48
+
+typedef struct scene_column_t
+{
+    void *data;
+    size_t size;
+} scene_column_t;
+
+size_t GetSceneAlignedSize(size_t size)
+{
+    return (size + SCENE_ALIGNMENT - 1) / SCENE_ALIGNMENT * SCENE_ALIGNMENT;
+}
+
+int GetShapesColumns(shapes_t *shapes, int count, scene_column_t *columns)
+{
+    scene_column_t shapesColumns[] = {
+        {shapes->positionX, sizeof(real_t) * count},
+        {shapes->positionY, sizeof(real_t) * count},
+        {shapes->velocityX, sizeof(real_t) * count},
+        {shapes->velocityY, sizeof(real_t) * count},
+        {shapes->mass, sizeof(real_t) * count},
+        {shapes->radian, sizeof(real_t) * count},
+        {shapes->spinningVelocity, sizeof(real_t) * count},
+        {shapes->awake, sizeof(real_t) * count},
+        {shapes->sleepTime, sizeof(real_t) * count},
+        {shapes->isGrabbed, sizeof(bool) * count},
+        {shapes->blockAwake, sizeof(unsigned char) * ((count + SLEEP_BLOCK_SIZE - 1) / SLEEP_BLOCK_SIZE)},
+        {shapes->slot, sizeof(int) * count},
+    };
+    memcpy(columns, shapesColumns, sizeof(shapesColumns));
+    return sizeof(shapesColumns) / sizeof(shapesColumns[0]);
+}
+
+// every array the header's counts describe, in file order
+// the sizes only depend on the header, the pointers are only valid once the world is big enough for it
+int GetSceneColumns(world_t *world, const scene_header_t *header, scene_column_t *columns)
+{
+    int count = GetShapesColumns(&world->balls.base, header->ballsCount, columns);
+    columns[count++] = (scene_column_t){world->balls.radius, sizeof(real_t) * header->ballsCount};
+    count += GetShapesColumns(&world->rects.base, header->rectsCount, &columns[count]);
+    columns[count++] = (scene_column_t){world->rects.sizeX, sizeof(real_t) * header->rectsCount};
+    columns[count++] = (scene_column_t){world->rects.sizeY, sizeof(real_t) * header->rectsCount};
+    columns[count++] = (scene_column_t){world->rects.cosRadian, sizeof(real_t) * header->rectsCount};
+    columns[count++] = (scene_column_t){world->rects.sinRadian, sizeof(real_t) * header->rectsCount};
+    columns[count++] = (scene_column_t){world->balls.slots.indices, sizeof(int) * header->ballSlotsCount};
+    columns[count++] = (scene_column_t){world->balls.slots.generations, sizeof(unsigned int) * header->ballSlotsCount};
+    columns[count++] = (scene_column_t){world->rects.slots.indices, sizeof(int) * header->rectSlotsCount};
+    columns[count++] = (scene_column_t){world->rects.slots.generations, sizeof(unsigned int) * header->rectSlotsCount};
+    columns[count++] = (scene_column_t){&world->mapBounds, sizeof(bounds_t)};
+    columns[count++] = (scene_column_t){&world->params, sizeof(world_params_t)};
+    // the last step's impulses, so a restored world warm starts exactly like the one it was taken from
+    columns[count++] = (scene_column_t){world->contactCache.keys, sizeof(unsigned long long) * header->contactCacheCapacity};
+    columns[count++] = (scene_column_t){world->contactCache.normalImpulses, sizeof(real_t) * header->contactCacheCapacity * MAX_CONTACT_POINTS};
+    return count;
+}
+
+size_t GetSceneSize(world_t *world, const scene_header_t *header)
+{
+    scene_column_t columns[SCENE_MAX_COLUMNS];
+    int columnsCount = GetSceneColumns(world, header, columns);
+    size_t size = GetSceneAlignedSize(sizeof(scene_header_t));
+    for (int i = 0; i < columnsCount; i++)
+    {
+        size += GetSceneAlignedSize(columns[i].size);
+    }
+    return size;
+}
+
+void WorldSnapshot(const world_t *world, world_snapshot_t *snapshot)
+{
+    // only read from, the columns just don't carry const
+    world_t *source = (world_t *)world;
+    scene_header_t header = {{0}, SCENE_FILE_VERSION, sizeof(scene_header_t), 0,
+                             world->balls.pointer, world->rects.pointer, world->contactCache.capacity, world->contactCache.count,
+                             world->balls.slots.count, world->rects.slots.count, world->balls.slots.freeSlot, world->rects.slots.freeSlot,
+                             sizeof(real_t), 0};
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.size = GetSceneSize(source, &header);
+    if (snapshot->max < header.size)
+    {
+        free(snapshot->data);
+        snapshot->data = malloc(header.size);
+        snapshot->max = header.size;
+    }
+    snapshot->size = header.size;
+    // the padding is zeroed too so equal worlds give byte equal files
+    memset(snapshot->data, 0, header.size);
+    memcpy(snapshot->data, &header, sizeof(header));
+
+    scene_column_t columns[SCENE_MAX_COLUMNS];
+    int columnsCount = GetSceneColumns(source, &header, columns);
+    size_t offset = GetSceneAlignedSize(sizeof(scene_header_t));
+    for (int i = 0; i < columnsCount; i++)
+    {
+        if (columns[i].size > 0)
+        {
+            memcpy(&snapshot->data[offset], columns[i].data, columns[i].size);
+        }
+        offset += GetSceneAlignedSize(columns[i].size);
+    }
+}
+
+// where the column copied into data starts in the snapshot, NULL if no column is
+const void *GetSnapshotColumn(const world_snapshot_t *snapshot, const scene_column_t *columns, int columnsCount, const void *data)
+{
+    size_t offset = GetSceneAlignedSize(sizeof(scene_header_t));
+    for (int i = 0; i < columnsCount; i++)
+    {
+        if (columns[i].data == data)
+        {
+            return &snapshot->data[offset];
+        }
+        offset += GetSceneAlignedSize(columns[i].size);
+    }
+    return NULL;
+}
+
+// every body names a slot that names it back, and the free chain runs through all other slots exactly once,
+// so no handle lookup or removal can leave the arrays
+bool AreSceneSlotsValid(const int *bodySlots, int count, const int *indices, int slotsCount, int freeSlot)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (bodySlots[i] < 0 || bodySlots[i] >= slotsCount || indices[bodySlots[i]] != i)
+        {
+            return false;
+        }
+    }
+    int freeCount = 0;
+    for (int slot = freeSlot; slot != -1; slot = GetFreeSlotLink(indices[slot]))
+    {
+        // a chain longer than the free slots has a cycle
+        if (slot < 0 || slot >= slotsCount || indices[slot] >= 0 || ++freeCount > slotsCount - count)
+        {
+            return false;
+        }
+    }
+    return freeCount == slotsCount - count;
+}
+
+bool WorldRestore(world_t *world, const world_snapshot_t *snapshot)
+{
+    scene_header_t header;
+    if (snapshot->size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, snapshot->data, sizeof(header));
+    bool capacityValid = header.contactCacheCapacity >= 0 && (header.contactCacheCapacity & (header.contactCacheCapacity - 1)) == 0;
+    if (memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_FILE_VERSION ||
+        header.headerSize != sizeof(scene_header_t) || header.realSize != sizeof(real_t) || header.ballsCount < 0 || header.rectsCount < 0 || !capacityValid ||
+        header.contactCacheCount < 0 || header.contactCacheCount > header.contactCacheCapacity ||
+        header.ballSlotsCount < header.ballsCount || header.rectSlotsCount < header.rectsCount ||
+        header.ballFreeSlot < -1 || header.ballFreeSlot >= header.ballSlotsCount || header.rectFreeSlot < -1 || header.rectFreeSlot >= header.rectSlotsCount ||
+        header.size != snapshot->size || header.size != GetSceneSize(world, &header))
+    {
+        return false;
+    }
+
+    if (!WorldReserve(world, header.ballsCount, header.rectsCount) || !ReserveBodySlots(&world->balls.slots, header.ballSlotsCount) ||
+        !ReserveBodySlots(&world->rects.slots, header.rectSlotsCount))
+    {
+        return false;
+    }
+    // checked where they are in the snapshot, before anything is copied
+    scene_column_t columns[SCENE_MAX_COLUMNS];
+    int columnsCount = GetSceneColumns(world, &header, columns);
+    if (!AreSceneSlotsValid(GetSnapshotColumn(snapshot, columns, columnsCount, world->balls.base.slot), header.ballsCount,
+                            GetSnapshotColumn(snapshot, columns, columnsCount, world->balls.slots.indices), header.ballSlotsCount, header.ballFreeSlot) ||
+        !AreSceneSlotsValid(GetSnapshotColumn(snapshot, columns, columnsCount, world->rects.base.slot), header.rectsCount,
+                            GetSnapshotColumn(snapshot, columns, columnsCount, world->rects.slots.indices), header.rectSlotsCount, header.rectFreeSlot))
+    {
+        return false;
+    }
+    world->balls.pointer = header.ballsCount;
+    world->rects.pointer = header.rectsCount;
+    world->balls.slots.count = header.ballSlotsCount;
+    world->rects.slots.count = header.rectSlotsCount;
+    world->balls.slots.freeSlot = header.ballFreeSlot;
+    world->rects.slots.freeSlot = header.rectFreeSlot;
+    if (header.contactCacheCapacity > 0)
+    {
+        SetContactCacheCapacity(&world->contactCache, header.contactCacheCapacity);
+    }
+    else
+    {
+        ClearContactCache(&world->contactCache);
+    }
+    ClearContactCache(&world->previousContactCache);
+
+    // again, the contact cache may have moved
+    columnsCount = GetSceneColumns(world, &header, columns);
+    size_t offset = GetSceneAlignedSize(sizeof(scene_header_t));
+    for (int i = 0; i < columnsCount; i++)
+    {
+        if (columns[i].size > 0)
+        {
+            memcpy(columns[i].data, &snapshot->data[offset], columns[i].size);
+        }
+        offset += GetSceneAlignedSize(columns[i].size);
+    }
+    world->contactCache.count = header.contactCacheCount;
+    WorldBodiesMoved(world);
+    return true;
+}
+
+void FreeSnapshot(world_snapshot_t *snapshot)
+{
+    free(snapshot->data);
+    *snapshot = (world_snapshot_t){0};
+}
+
+bool WorldSave(const world_t *world, const char *path)
+{
+    world_snapshot_t snapshot = {0};
+    WorldSnapshot(world, &snapshot);
+    FILE *file = fopen(path, "wb");
+    bool saved = file != NULL && fwrite(snapshot.data, 1, snapshot.size, file) == snapshot.size;
+    saved = file != NULL && fclose(file) == 0 && saved;
+    FreeSnapshot(&snapshot);
+    return saved;
+}
+
+// the file is mapped instead of read, so the only copy is the one into the body arrays
+bool WorldLoad(world_t *world, const char *path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(scene_header_t))
+    {
+        close(file);
+        return false;
+    }
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    posix_madvise(mapping, status.st_size, POSIX_MADV_SEQUENTIAL);
+    world_snapshot_t snapshot = {mapping, status.st_size, status.st_size};
+    bool loaded = WorldRestore(world, &snapshot);
+    munmap(mapping, status.st_size);
+    return loaded;
+}
+
+// fnv-1a over the raw bytes of the body state, equal checksums mean bit identical runs
+unsigned long long GetArrayChecksum(unsigned long long hash, const real_t *values, int count)
+{
+    const unsigned char *bytes = (const unsigned char *)values;
+    for (size_t i = 0; i < sizeof(real_t) * count; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+unsigned long long GetWorldChecksum(const world_t *world)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    const shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    for (int i = 0; i < 2; i++)
+    {
+        hash = GetArrayChecksum(hash, lists[i]->positionX, counts[i]);
+        hash = GetArrayChecksum(hash, lists[i]->positionY, counts[i]);
+        hash = GetArrayChecksum(hash, lists[i]->velocityX, counts[i]);
+        hash = GetArrayChecksum(hash, lists[i]->velocityY, counts[i]);
+        hash = GetArrayChecksum(hash, lists[i]->radian, counts[i]);
+        hash = GetArrayChecksum(hash, lists[i]->spinningVelocity, counts[i]);
+    }
+    return hash;
+}
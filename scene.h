@@ -0,0 +1,55 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "physics.h"
+
+// the complete simulation state as one flat buffer: a header, then every body array as it is in memory
+// snapshots in memory and scene files share the layout, so saving is one write and loading maps the file and copies
+// array by array, never body by body
+// files use the byte order and real_t of the build that wrote them, float32 and float64 builds can't read each other's
+
+#define SCENE_FILE_MAGIC "PHYSCENE"
+#define SCENE_FILE_VERSION 8
+#define SCENE_ALIGNMENT 64 // every array starts on a cache line
+
+typedef struct scene_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t size; // header included
+    int32_t ballsCount;
+    int32_t rectsCount;
+    int32_t contactCacheCapacity;
+    int32_t contactCacheCount;
+    int32_t ballSlotsCount; // handle slots, so handles taken before a snapshot still work after restoring it
+    int32_t rectSlotsCount;
+    int32_t ballFreeSlot;
+    int32_t rectFreeSlot;
+    uint32_t realSize; // sizeof(real_t)
+    uint32_t reserved;
+} scene_header_t;
+
+typedef struct world_snapshot_t
+{
+    unsigned char *data; // starts with scene_header_t
+    size_t size;
+    size_t max;
+} world_snapshot_t;
+
+// the buffer is kept and reused by the next snapshot into the same world_snapshot_t
+void WorldSnapshot(const world_t *world, world_snapshot_t *snapshot);
+// returns false and leaves the world alone if the data isn't a valid snapshot or the world can't grow to hold it
+bool WorldRestore(world_t *world, const world_snapshot_t *snapshot);
+void FreeSnapshot(world_snapshot_t *snapshot);
+
+bool WorldSave(const world_t *world, const char *path);
+// replaces every body in the world, returns false if the file can't be read or isn't a scene of this version
+bool WorldLoad(world_t *world, const char *path);
+
+// fnv-1a over the raw bytes of the body state, equal checksums mean bit identical runs
+unsigned long long GetWorldChecksum(const world_t *world);
+
+#endif
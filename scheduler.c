@@ -0,0 +1,188 @@
+#include "scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+const int defaultMaxSubsteps = 8;
+const int defaultMaxStepsPerFrame = 8;
+const real_t substepMotionScale = 1;      // a substep moves no body further than this share of its smallest half size
+const real_t substepContactDensity = 1.5; // every this many contacts per awake body buy one more substep
+
+void InitScheduler(scheduler_t *scheduler, real_t stepTime)
+{
+    *scheduler = (scheduler_t){0};
+    scheduler->stepTime = stepTime;
+    scheduler->maxSubsteps = defaultMaxSubsteps;
+    scheduler->maxStepsPerFrame = defaultMaxStepsPerFrame;
+}
+
+void FreeScheduler(scheduler_t *scheduler)
+{
+    free(scheduler->previousX);
+    free(scheduler->previousY);
+    free(scheduler->previousRadian);
+    *scheduler = (scheduler_t){0};
+}
+
+// the largest squared speed relative to the half size in one list, sizes are radius and radius for balls
+// spins are kept apart so no body needs a square root, their sum bounds how fast any corner moves
+void GetLargestShapesMotion(const shapes_t *shapes, const real_t *sizeX, const real_t *sizeY, real_t halfSizeScale, int count,
+                            real_t *largestMotion, real_t *largestSpin)
+{
+    for (int block = 0; block * SLEEP_BLOCK_SIZE < count; block++)
+    {
+        // sleeping shapes don't move
+        if (shapes->blockAwake[block] == 0)
+        {
+            continue;
+        }
+        int blockEnd = (block + 1) * SLEEP_BLOCK_SIZE < count ? (block + 1) * SLEEP_BLOCK_SIZE : count;
+        for (int i = block * SLEEP_BLOCK_SIZE; i < blockEnd; i++)
+        {
+            real_t halfSize = halfSizeScale * (sizeX[i] < sizeY[i] ? sizeX[i] : sizeY[i]);
+            real_t halfSizeSquared = halfSize * halfSize;
+            real_t motion = (shapes->velocityX[i] * shapes->velocityX[i] + shapes->velocityY[i] * shapes->velocityY[i]) / halfSizeSquared;
+            // a corner is half the diagonal away from the center
+            real_t cornerSquared = halfSizeScale * halfSizeScale * (sizeX[i] * sizeX[i] + sizeY[i] * sizeY[i]);
+            real_t spin = shapes->spinningVelocity[i] * shapes->spinningVelocity[i] * cornerSquared / halfSizeSquared;
+            *largestMotion = motion > *largestMotion ? motion : *largestMotion;
+            *largestSpin = spin > *largestSpin ? spin : *largestSpin;
+        }
+    }
+}
+
+int GetSchedulerSubsteps(const scheduler_t *scheduler, const world_t *world)
+{
+    real_t largestMotion = 0;
+    real_t largestSpin = 0;
+    GetLargestShapesMotion(&world->balls.base, world->balls.radius, world->balls.radius, 1, world->balls.pointer, &largestMotion, &largestSpin);
+    GetLargestShapesMotion(&world->rects.base, world->rects.sizeX, world->rects.sizeY, 0.5, world->rects.pointer, &largestMotion, &largestSpin);
+    // half sizes per second, times the step
+    real_t motion = (sqrt(largestMotion) + sqrt(largestSpin)) * scheduler->stepTime;
+    int substeps = (int)ceil(motion / substepMotionScale);
+    // piles converge much better with more steps than with more solver iterations
+    if (world->stats.awakeBodies > 0)
+    {
+        int denseSubsteps = 1 + (int)(scheduler->lastContacts / (substepContactDensity * world->stats.awakeBodies));
+        substeps = denseSubsteps > substeps ? denseSubsteps : substeps;
+    }
+    substeps = substeps < scheduler->maxSubsteps ? substeps : scheduler->maxSubsteps;
+    return substeps > 1 ? substeps : 1;
+}
+
+void EnsurePreviousSize(scheduler_t *scheduler, int count)
+{
+    if (count <= scheduler->previousMax)
+    {
+        return;
+    }
+    scheduler->previousMax = count;
+    scheduler->previousX = realloc(scheduler->previousX, sizeof(real_t) * count);
+    scheduler->previousY = realloc(scheduler->previousY, sizeof(real_t) * count);
+    scheduler->previousRadian = realloc(scheduler->previousRadian, sizeof(real_t) * count);
+}
+
+void KeepPreviousState(scheduler_t *scheduler, const world_t *world)
+{
+    int ballsCount = world->balls.pointer;
+    int rectsCount = world->rects.pointer;
+    EnsurePreviousSize(scheduler, ballsCount + rectsCount);
+    memcpy(scheduler->previousX, world->balls.base.positionX, sizeof(real_t) * ballsCount);
+    memcpy(scheduler->previousY, world->balls.base.positionY, sizeof(real_t) * ballsCount);
+    memcpy(scheduler->previousRadian, world->balls.base.radian, sizeof(real_t) * ballsCount);
+    memcpy(&scheduler->previousX[ballsCount], world->rects.base.positionX, sizeof(real_t) * rectsCount);
+    memcpy(&scheduler->previousY[ballsCount], world->rects.base.positionY, sizeof(real_t) * rectsCount);
+    memcpy(&scheduler->previousRadian[ballsCount], world->rects.base.radian, sizeof(real_t) * rectsCount);
+    scheduler->previousBalls = ballsCount;
+    scheduler->previousRects = rectsCount;
+}
+
+int SchedulerStep(scheduler_t *scheduler, world_t *world, scheduler_step_t beforeStep, void *context)
+{
+    if (beforeStep != NULL)
+    {
+        beforeStep(context, world, scheduler->stepTime);
+    }
+    int substeps = GetSchedulerSubsteps(scheduler, world);
+    for (int substep = 0; substep < substeps; substep++)
+    {
+        long long contacts = world->stats.collisions;
+        WorldStep(world, scheduler->stepTime / substeps);
+        scheduler->lastContacts = world->stats.collisions - contacts;
+    }
+    scheduler->lastSubsteps = substeps;
+    return substeps;
+}
+
+int SchedulerAdvance(scheduler_t *scheduler, world_t *world, double frameTime, scheduler_step_t beforeStep, void *context)
+{
+    scheduler->accumulator += frameTime;
+    int steps = (int)(scheduler->accumulator / scheduler->stepTime);
+    if (steps > scheduler->maxStepsPerFrame)
+    {
+        steps = scheduler->maxStepsPerFrame;
+        scheduler->accumulator = steps * (double)scheduler->stepTime;
+    }
+    for (int step = 0; step < steps; step++)
+    {
+        // only the last step is blended from, the ones before it are never drawn
+        if (step == steps - 1)
+        {
+            KeepPreviousState(scheduler, world);
+        }
+        SchedulerStep(scheduler, world, beforeStep, context);
+        scheduler->accumulator -= scheduler->stepTime;
+    }
+    scheduler->lastSteps = steps;
+    return steps;
+}
+
+void ResetSchedulerInterpolation(scheduler_t *scheduler)
+{
+    scheduler->previousBalls = 0;
+    scheduler->previousRects = 0;
+}
+
+real_t GetSchedulerAlpha(const scheduler_t *scheduler)
+{
+    real_t alpha = (real_t)(scheduler->accumulator / scheduler->stepTime);
+    return alpha < 1 ? alpha : 1;
+}
+
+real_t GetInterpolated(real_t previous, real_t current, real_t alpha)
+{
+    return previous + (current - previous) * alpha;
+}
+
+VReal_t GetInterpolatedBallPosition(const scheduler_t *scheduler, const world_t *world, int index)
+{
+    VReal_t position = {world->balls.base.positionX[index], world->balls.base.positionY[index]};
+    if (index >= scheduler->previousBalls)
+    {
+        return position;
+    }
+    real_t alpha = GetSchedulerAlpha(scheduler);
+    return (VReal_t){GetInterpolated(scheduler->previousX[index], position.x, alpha), GetInterpolated(scheduler->previousY[index], position.y, alpha)};
+}
+
+VReal_t GetInterpolatedRectPosition(const scheduler_t *scheduler, const world_t *world, int index)
+{
+    VReal_t position = {world->rects.base.positionX[index], world->rects.base.positionY[index]};
+    if (index >= scheduler->previousRects)
+    {
+        return position;
+    }
+    real_t alpha = GetSchedulerAlpha(scheduler);
+    int previous = scheduler->previousBalls + index;
+    return (VReal_t){GetInterpolated(scheduler->previousX[previous], position.x, alpha), GetInterpolated(scheduler->previousY[previous], position.y, alpha)};
+}
+
+real_t GetInterpolatedRectRadian(const scheduler_t *scheduler, const world_t *world, int index)
+{
+    real_t radian = world->rects.base.radian[index];
+    if (index >= scheduler->previousRects)
+    {
+        return radian;
+    }
+    return GetInterpolated(scheduler->previousRadian[scheduler->previousBalls + index], radian, GetSchedulerAlpha(scheduler));
+}
@@ -0,0 +1,50 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "physics.h"
+
+// runs a world at its own fixed rate whatever the frame rate: every frame hands in how much time passed and as many
+// fixed steps as fit into it are taken, the rest is carried over to the next frame
+// a fixed step is split into substeps only while fast bodies or dense contacts need them, so quiet scenes pay for one
+// the time carried over is how far the drawn frame is between the last two steps, drawing blends between them
+
+// runs before every fixed step with its length, e.g. to turn input into velocities
+typedef void (*scheduler_step_t)(void *context, world_t *world, real_t deltaTime);
+
+typedef struct scheduler_t
+{
+    real_t stepTime;      // seconds per fixed step
+    int maxSubsteps;      // past this fast bodies are left to the continuous collision
+    int maxStepsPerFrame; // a frame that fell further behind drops the rest of its time instead of catching up
+    double accumulator;   // seconds not simulated yet, less than stepTime after every advance
+    int lastSteps;        // fixed steps taken by the last advance
+    int lastSubsteps;     // of the last fixed step
+    long long lastContacts; // solved by the last substep, how dense the scene is
+    // positions and rotations from before the last fixed step, balls first and rects after them
+    real_t *previousX;
+    real_t *previousY;
+    real_t *previousRadian;
+    int previousBalls; // 0 after a reset, bodies past these counts are drawn where they are
+    int previousRects;
+    int previousMax;
+} scheduler_t;
+
+void InitScheduler(scheduler_t *scheduler, real_t stepTime);
+void FreeScheduler(scheduler_t *scheduler);
+// substeps the next fixed step of the world would be split into
+int GetSchedulerSubsteps(const scheduler_t *scheduler, const world_t *world);
+// one fixed step split into its substeps, returns how many it took
+int SchedulerStep(scheduler_t *scheduler, world_t *world, scheduler_step_t beforeStep, void *context);
+// simulates frameTime more seconds, returns the fixed steps taken, beforeStep may be NULL
+int SchedulerAdvance(scheduler_t *scheduler, world_t *world, double frameTime, scheduler_step_t beforeStep, void *context);
+// forgets the positions before the last step, for whenever bodies were removed or moved outside of a step
+void ResetSchedulerInterpolation(scheduler_t *scheduler);
+
+// share of a step the time carried over makes up, in [0, 1)
+real_t GetSchedulerAlpha(const scheduler_t *scheduler);
+// where to draw a body, between its place before and after the last fixed step
+VReal_t GetInterpolatedBallPosition(const scheduler_t *scheduler, const world_t *world, int index);
+VReal_t GetInterpolatedRectPosition(const scheduler_t *scheduler, const world_t *world, int index);
+real_t GetInterpolatedRectRadian(const scheduler_t *scheduler, const world_t *world, int index);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "real.h"
+
+// thin wrappers over the widest vector of real_t the compiler targets
+// kernels run the vector loop for full lanes and finish the tail (or everything, without SIMD) with scalar code
+// SIMD_DISABLED leaves only the scalar code whatever the compiler targets
+
+#if defined(SIMD_DISABLED)
+#define SIMD_NAME "scalar"
+#define SIMD_WIDTH 1
+
+#elif defined(__AVX__) && defined(PHYSICS_FLOAT32)
+#include <immintrin.h>
+#define SIMD_NAME "avx"
+#define SIMD_WIDTH 8
+
+typedef __m256 simd_t;
+
+static inline simd_t SimdLoad(const real_t *values) { return _mm256_loadu_ps(values); }
+static inline void SimdStore(real_t *values, simd_t vector) { _mm256_storeu_ps(values, vector); }
+static inline simd_t SimdSet(real_t value) { return _mm256_set1_ps(value); }
+static inline simd_t SimdAdd(simd_t a, simd_t b) { return _mm256_add_ps(a, b); }
+static inline simd_t SimdSub(simd_t a, simd_t b) { return _mm256_sub_ps(a, b); }
+static inline simd_t SimdMul(simd_t a, simd_t b) { return _mm256_mul_ps(a, b); }
+static inline simd_t SimdMax(simd_t a, simd_t b) { return _mm256_max_ps(a, b); }
+static inline simd_t SimdMin(simd_t a, simd_t b) { return _mm256_min_ps(a, b); }
+static inline simd_t SimdLess(simd_t a, simd_t b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline simd_t SimdAndNot(simd_t mask, simd_t a) { return _mm256_andnot_ps(mask, a); }
+static inline simd_t SimdOr(simd_t a, simd_t b) { return _mm256_or_ps(a, b); }
+// mask ? b : a
+static inline simd_t SimdSelect(simd_t mask, simd_t a, simd_t b) { return _mm256_blendv_ps(a, b, mask); }
+static inline int SimdAny(simd_t mask) { return _mm256_movemask_ps(mask) != 0; }
+
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_NAME "avx"
+#define SIMD_WIDTH 4
+
+typedef __m256d simd_t;
+
+static inline simd_t SimdLoad(const real_t *values) { return _mm256_loadu_pd(values); }
+static inline void SimdStore(real_t *values, simd_t vector) { _mm256_storeu_pd(values, vector); }
+static inline simd_t SimdSet(real_t value) { return _mm256_set1_pd(value); }
+static inline simd_t SimdAdd(simd_t a, simd_t b) { return _mm256_add_pd(a, b); }
+static inline simd_t SimdSub(simd_t a, simd_t b) { return _mm256_sub_pd(a, b); }
+static inline simd_t SimdMul(simd_t a, simd_t b) { return _mm256_mul_pd(a, b); }
+static inline simd_t SimdMax(simd_t a, simd_t b) { return _mm256_max_pd(a, b); }
+static inline simd_t SimdMin(simd_t a, simd_t b) { return _mm256_min_pd(a, b); }
+static inline simd_t SimdLess(simd_t a, simd_t b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline simd_t SimdAndNot(simd_t mask, simd_t a) { return _mm256_andnot_pd(mask, a); }
+static inline simd_t SimdOr(simd_t a, simd_t b) { return _mm256_or_pd(a, b); }
+// mask ? b : a
+static inline simd_t SimdSelect(simd_t mask, simd_t a, simd_t b) { return _mm256_blendv_pd(a, b, mask); }
+static inline int SimdAny(simd_t mask) { return _mm256_movemask_pd(mask) != 0; }
+
+#elif defined(__SSE2__) && defined(PHYSICS_FLOAT32)
+#include <emmintrin.h>
+#define SIMD_NAME "sse2"
+#define SIMD_WIDTH 4
+
+typedef __m128 simd_t;
+
+static inline simd_t SimdLoad(const real_t *values) { return _mm_loadu_ps(values); }
+static inline void SimdStore(real_t *values, simd_t vector) { _mm_storeu_ps(values, vector); }
+static inline simd_t SimdSet(real_t value) { return _mm_set1_ps(value); }
+static inline simd_t SimdAdd(simd_t a, simd_t b) { return _mm_add_ps(a, b); }
+static inline simd_t SimdSub(simd_t a, simd_t b) { return _mm_sub_ps(a, b); }
+static inline simd_t SimdMul(simd_t a, simd_t b) { return _mm_mul_ps(a, b); }
+static inline simd_t SimdMax(simd_t a, simd_t b) { return _mm_max_ps(a, b); }
+static inline simd_t SimdMin(simd_t a, simd_t b) { return _mm_min_ps(a, b); }
+static inline simd_t SimdLess(simd_t a, simd_t b) { return _mm_cmplt_ps(a, b); }
+static inline simd_t SimdAndNot(simd_t mask, simd_t a) { return _mm_andnot_ps(mask, a); }
+static inline simd_t SimdOr(simd_t a, simd_t b) { return _mm_or_ps(a, b); }
+// mask ? b : a, SSE2 has no blend so it's done with bit masks
+static inline simd_t SimdSelect(simd_t mask, simd_t a, simd_t b) { return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a)); }
+static inline int SimdAny(simd_t mask) { return _mm_movemask_ps(mask) != 0; }
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_NAME "sse2"
+#define SIMD_WIDTH 2
+
+typedef __m128d simd_t;
+
+static inline simd_t SimdLoad(const real_t *values) { return _mm_loadu_pd(values); }
+static inline void SimdStore(real_t *values, simd_t vector) { _mm_storeu_pd(values, vector); }
+static inline simd_t SimdSet(real_t value) { return _mm_set1_pd(value); }
+static inline simd_t SimdAdd(simd_t a, simd_t b) { return _mm_add_pd(a, b); }
+static inline simd_t SimdSub(simd_t a, simd_t b) { return _mm_sub_pd(a, b); }
+static inline simd_t SimdMul(simd_t a, simd_t b) { return _mm_mul_pd(a, b); }
+static inline simd_t SimdMax(simd_t a, simd_t b) { return _mm_max_pd(a, b); }
+static inline simd_t SimdMin(simd_t a, simd_t b) { return _mm_min_pd(a, b); }
+static inline simd_t SimdLess(simd_t a, simd_t b) { return _mm_cmplt_pd(a, b); }
+static inline simd_t SimdAndNot(simd_t mask, simd_t a) { return _mm_andnot_pd(mask, a); }
+static inline simd_t SimdOr(simd_t a, simd_t b) { return _mm_or_pd(a, b); }
+// mask ? b : a, SSE2 has no blend so it's done with bit masks
+static inline simd_t SimdSelect(simd_t mask, simd_t a, simd_t b) { return _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a)); }
+static inline int SimdAny(simd_t mask) { return _mm_movemask_pd(mask) != 0; }
+
+#else
+#define SIMD_NAME "scalar"
+#define SIMD_WIDTH 1 // scalar fallback, kernels only run their tail loops
+#endif
+
+#endif
@@ -0,0 +1,349 @@
+#include "physics.h"
+#include "scenarios.h"
+#include "scene.h"
+#include "threadpool.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// runs one small world per combination of parameters, all of them in this process, and writes one row per world
+// a range is MIN:MAX:COUNT (COUNT evenly spaced values) or a single value, every combination of the ranges is run
+// once per seed
+// usage: sweep [--scenario NAME] [--bodies N] [--steps N] [--dt SECONDS] [--seed N] [--seeds N] [--threads N]
+//              [--gravity RANGE] [--ball-wall-bounce RANGE] [--rect-wall-bounce RANGE] [--ball-restitution RANGE] [--rect-restitution RANGE]
+//              [--format csv|json] [--output FILE]
+
+#define SWEEP_PARAMS 5
+
+typedef struct sweep_range_t
+{
+    double min;
+    double max;
+    int count;
+} sweep_range_t;
+
+typedef struct sweep_options_t
+{
+    scenario_kind_t scenario;
+    int bodies;
+    int steps;
+    double deltaTime;
+    unsigned int seed;
+    int seeds;
+    int threads;
+    sweep_range_t ranges[SWEEP_PARAMS]; // in world_params_t order
+    bool csv;
+    const char *outputPath;
+} sweep_options_t;
+
+typedef struct sweep_result_t
+{
+    double kineticEnergy;
+    double meanHeight; // of the body centers above the bottom of the map
+    int awakeBodies;
+    long long collisions;
+    unsigned long long checksum;
+} sweep_result_t;
+
+typedef struct sweep_t
+{
+    const sweep_options_t *options;
+    world_t **worlds;
+    sweep_result_t *results;
+    int count;
+} sweep_t;
+
+const char *sweepParamNames[SWEEP_PARAMS] = {"gravity", "ball-wall-bounce", "rect-wall-bounce", "ball-restitution", "rect-restitution"};
+// arena room per body and per world, generous since untouched arena pages cost nothing
+const size_t sweepArenaBodyBytes = 1024;
+const size_t sweepArenaWorldBytes = 64 << 10;
+
+double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool ParseRange(const char *text, sweep_range_t *range)
+{
+    char *end;
+    range->min = strtod(text, &end);
+    range->max = range->min;
+    range->count = 1;
+    if (end == text)
+    {
+        return false;
+    }
+    if (*end == '\0')
+    {
+        return true;
+    }
+    const char *maxText = end + 1;
+    range->max = strtod(maxText, &end);
+    if (end == maxText || *end != ':')
+    {
+        return false;
+    }
+    range->count = atoi(end + 1);
+    return range->count > 0;
+}
+
+double GetRangeValue(sweep_range_t range, int index)
+{
+    return range.count > 1 ? range.min + (range.max - range.min) * index / (range.count - 1) : range.min;
+}
+
+bool ParseSweepOptions(int argc, char **argv, sweep_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        int param = -1;
+        for (int j = 0; j < SWEEP_PARAMS; j++)
+        {
+            param = strncmp(argv[i], "--", 2) == 0 && strcmp(argv[i] + 2, sweepParamNames[j]) == 0 ? j : param;
+        }
+        if (param >= 0)
+        {
+            if (!ParseRange(argv[++i], &options->ranges[param]))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--scenario") == 0)
+        {
+            if (!GetScenarioFromName(argv[++i], &options->scenario))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--bodies") == 0)
+        {
+            options->bodies = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--steps") == 0)
+        {
+            options->steps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dt") == 0)
+        {
+            options->deltaTime = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            options->seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seeds") == 0)
+        {
+            options->seeds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            options->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--format") == 0)
+        {
+            const char *format = argv[++i];
+            if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0)
+            {
+                return false;
+            }
+            options->csv = strcmp(format, "csv") == 0;
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            options->outputPath = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options->bodies > 0 && options->steps >= 0 && options->deltaTime > 0 && options->seeds > 0 && options->threads > 0;
+}
+
+int GetSweepCount(const sweep_options_t *options)
+{
+    long long count = options->seeds;
+    for (int i = 0; i < SWEEP_PARAMS; i++)
+    {
+        count *= options->ranges[i].count;
+    }
+    return count < 1 << 30 ? (int)count : -1;
+}
+
+// world index runs over the seeds first, then the ranges with the first one changing slowest
+world_params_t GetSweepParams(const sweep_options_t *options, int index, unsigned int *seed)
+{
+    *seed = options->seed + index % options->seeds;
+    index /= options->seeds;
+    real_t values[SWEEP_PARAMS];
+    for (int i = SWEEP_PARAMS - 1; i >= 0; i--)
+    {
+        values[i] = GetRangeValue(options->ranges[i], index % options->ranges[i].count);
+        index /= options->ranges[i].count;
+    }
+    return (world_params_t){values[0], values[1], values[2], values[3], values[4]};
+}
+
+sweep_result_t GetSweepResult(const world_t *world)
+{
+    sweep_result_t result = {0};
+    const shapes_t *lists[2] = {&world->balls.base, &world->rects.base};
+    int counts[2] = {world->balls.pointer, world->rects.pointer};
+    for (int list = 0; list < 2; list++)
+    {
+        for (int i = 0; i < counts[list]; i++)
+        {
+            const shapes_t *shapes = lists[list];
+            result.kineticEnergy += 0.5 * shapes->mass[i] * (shapes->velocityX[i] * shapes->velocityX[i] + shapes->velocityY[i] * shapes->velocityY[i]);
+            result.meanHeight += world->mapBounds.maxY - shapes->positionY[i];
+        }
+    }
+    int bodies = counts[0] + counts[1];
+    result.meanHeight /= bodies > 0 ? bodies : 1;
+    result.awakeBodies = world->stats.awakeBodies;
+    result.collisions = world->stats.collisions;
+    result.checksum = GetWorldChecksum(world);
+    return result;
+}
+
+// every world runs all its steps on one thread, so a small world stays in that core's cache from start to end
+void RunSweepTask(void *context, int begin, int end)
+{
+    sweep_t *sweep = context;
+    for (int i = begin; i < end; i++)
+    {
+        for (int step = 0; step < sweep->options->steps; step++)
+        {
+            WorldStep(sweep->worlds[i], sweep->options->deltaTime);
+        }
+        sweep->results[i] = GetSweepResult(sweep->worlds[i]);
+    }
+}
+
+void WriteSweepResult(FILE *output, const sweep_options_t *options, int index, sweep_result_t result)
+{
+    unsigned int seed;
+    world_params_t params = GetSweepParams(options, index, &seed);
+    if (options->csv)
+    {
+        fprintf(output, "%d,%u,%g,%g,%g,%g,%g,%.6g,%.6g,%d,%lld,%016llx\n", index, seed,
+                (double)params.gravity, (double)params.ballWallBounce, (double)params.rectWallBounce, (double)params.ballRestitution, (double)params.rectRestitution,
+                result.kineticEnergy, result.meanHeight, result.awakeBodies, result.collisions, result.checksum);
+        return;
+    }
+    fprintf(output, "%s    {\"world\": %d, \"seed\": %u, \"gravity\": %g, \"ball_wall_bounce\": %g, \"rect_wall_bounce\": %g, "
+                    "\"ball_restitution\": %g, \"rect_restitution\": %g, "
+                    "\"kinetic_energy\": %.6g, \"mean_height\": %.6g, \"awake_bodies\": %d, \"collisions\": %lld, \"checksum\": \"%016llx\"}",
+            index == 0 ? "" : ",\n", index, seed,
+            (double)params.gravity, (double)params.ballWallBounce, (double)params.rectWallBounce, (double)params.ballRestitution, (double)params.rectRestitution,
+            result.kineticEnergy, result.meanHeight, result.awakeBodies, result.collisions, result.checksum);
+}
+
+int main(int argc, char **argv)
+{
+    sweep_options_t options = {0};
+    options.scenario = SCENARIO_MIXED;
+    options.bodies = 50;
+    options.steps = 600;
+    options.deltaTime = 1 / 360.0;
+    options.seed = 1;
+    options.seeds = 1;
+    options.threads = 1;
+    options.csv = true;
+    world_params_t defaults = GetDefaultWorldParams();
+    real_t defaultValues[SWEEP_PARAMS] = {defaults.gravity, defaults.ballWallBounce, defaults.rectWallBounce, defaults.ballRestitution, defaults.rectRestitution};
+    for (int i = 0; i < SWEEP_PARAMS; i++)
+    {
+        options.ranges[i] = (sweep_range_t){defaultValues[i], defaultValues[i], 1};
+    }
+    int count = -1;
+    if (!ParseSweepOptions(argc, argv, &options) || (count = GetSweepCount(&options)) < 0)
+    {
+        fprintf(stderr, "usage: %s [--scenario NAME] [--bodies N] [--steps N] [--dt SECONDS] [--seed N] [--seeds N] [--threads N] "
+                        "[--gravity RANGE] [--ball-wall-bounce RANGE] [--rect-wall-bounce RANGE] [--ball-restitution RANGE] [--rect-restitution RANGE] "
+                        "[--format csv|json] [--output FILE]\n"
+                        "a RANGE is MIN:MAX:COUNT or a single value\n",
+                argv[0]);
+        return 1;
+    }
+    FILE *output = options.outputPath != NULL ? fopen(options.outputPath, "w") : stdout;
+    if (output == NULL)
+    {
+        perror(options.outputPath);
+        return 1;
+    }
+
+    // the worlds are made one after the other out of one arena, so each one's bodies are in one piece
+    // and neighbouring worlds are neighbours in memory
+    double setupStart = GetSeconds();
+    pool_arena_t arena;
+    if (!InitPoolArena(&arena, (size_t)count * (options.bodies * sweepArenaBodyBytes + sweepArenaWorldBytes)))
+    {
+        fprintf(stderr, "can't reserve the worlds' memory\n");
+        return 1;
+    }
+    sweep_t sweep = {&options, malloc(sizeof(world_t *) * count), calloc(count, sizeof(sweep_result_t)), count};
+    PoolSetArena(&arena);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int seed;
+        sweep.worlds[i] = WorldCreate();
+        sweep.worlds[i]->params = GetSweepParams(&options, i, &seed);
+        GenerateScenario(sweep.worlds[i], options.scenario, options.bodies, seed);
+    }
+    PoolSetArena(NULL);
+    double setupSeconds = GetSeconds() - setupStart;
+
+    thread_pool_t *pool = ThreadPoolCreate(options.threads);
+    double start = GetSeconds();
+    ParallelFor(pool, count, 1, RunSweepTask, &sweep);
+    double seconds = GetSeconds() - start;
+    ThreadPoolDestroy(pool);
+
+    if (options.csv)
+    {
+        fprintf(output, "world,seed,gravity,ball_wall_bounce,rect_wall_bounce,ball_restitution,rect_restitution,"
+                        "kinetic_energy,mean_height,awake_bodies,collisions,checksum\n");
+    }
+    else
+    {
+        fprintf(output, "{\"scenario\": \"%s\", \"precision\": \"%s\", \"bodies\": %d, \"steps\": %d, \"dt\": %g, \"worlds\": [\n",
+                GetScenarioName(options.scenario), REAL_NAME, options.bodies, options.steps, options.deltaTime);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        WriteSweepResult(output, &options, i, sweep.results[i]);
+    }
+    if (!options.csv)
+    {
+        fprintf(output, "\n]}\n");
+    }
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+    // the summary goes to stderr when the rows go to stdout
+    fprintf(output != stdout ? stdout : stderr,
+            "worlds: %d\n"
+            "setup seconds: %.3f\n"
+            "seconds: %.3f\n"
+            "world steps/sec: %.1f\n",
+            count, setupSeconds, seconds, seconds > 0 ? (double)count * options.steps / seconds : 0);
+
+    for (int i = 0; i < count; i++)
+    {
+        WorldDestroy(sweep.worlds[i]);
+    }
+    FreePoolArena(&arena);
+    free(sweep.worlds);
+    free(sweep.results);
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "threadpool.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+struct thread_pool_t
+{
+    pthread_t *workers;
+    int workersCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+    // the job currently being run, only changed while no worker is busy
+    parallel_task_t task;
+    void *context;
+    int count;
+    int grain;
+    atomic_int next; // first item of the next unclaimed range
+    int busyWorkers;
+    unsigned long long generation; // bumped for every job so sleeping workers know there's new work
+    bool quit;
+};
+
+void RunParallelRanges(thread_pool_t *pool, parallel_task_t task, void *context, int count, int grain)
+{
+    while (true)
+    {
+        int begin = atomic_fetch_add(&pool->next, grain);
+        if (begin >= count)
+        {
+            return;
+        }
+        int end = begin + grain < count ? begin + grain : count;
+        task(context, begin, end);
+    }
+}
+
+void *RunThreadPoolWorker(void *argument)
+{
+    thread_pool_t *pool = argument;
+    unsigned long long seenGeneration = 0;
+    pthread_mutex_lock(&pool->mutex);
+    while (true)
+    {
+        while (!pool->quit && pool->generation == seenGeneration)
+        {
+            pthread_cond_wait(&pool->workReady, &pool->mutex);
+        }
+        if (pool->quit)
+        {
+            break;
+        }
+        seenGeneration = pool->generation;
+        parallel_task_t task = pool->task;
+        void *context = pool->context;
+        int count = pool->count;
+        int grain = pool->grain;
+        pthread_mutex_unlock(&pool->mutex);
+
+        RunParallelRanges(pool, task, context, count, grain);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->busyWorkers--;
+        if (pool->busyWorkers == 0)
+        {
+            pthread_cond_signal(&pool->workDone);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+thread_pool_t *ThreadPoolCreate(int threads)
+{
+    thread_pool_t *pool = calloc(1, sizeof(thread_pool_t));
+    pool->workersCount = threads > 1 ? threads - 1 : 0;
+    pool->workers = malloc(sizeof(pthread_t) * (pool->workersCount > 0 ? pool->workersCount : 1));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->workReady, NULL);
+    pthread_cond_init(&pool->workDone, NULL);
+    atomic_init(&pool->next, 0);
+    for (int i = 0; i < pool->workersCount; i++)
+    {
+        if (pthread_create(&pool->workers[i], NULL, RunThreadPoolWorker, pool) != 0)
+        {
+            // run with however many workers we got
+            pool->workersCount = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void ThreadPoolDestroy(thread_pool_t *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->workersCount; i++)
+    {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->workReady);
+    pthread_cond_destroy(&pool->workDone);
+    free(pool->workers);
+    free(pool);
+}
+
+int GetThreadPoolThreads(const thread_pool_t *pool)
+{
+    return pool != NULL ? pool->workersCount + 1 : 1;
+}
+
+void ParallelFor(thread_pool_t *pool, int count, int grain, parallel_task_t task, void *context)
+{
+    grain = grain > 0 ? grain : 1;
+    if (count <= 0)
+    {
+        return;
+    }
+    // not worth waking anyone for a single range
+    if (pool == NULL || pool->workersCount == 0 || count <= grain)
+    {
+        for (int begin = 0; begin < count; begin += grain)
+        {
+            task(context, begin, begin + grain < count ? begin + grain : count);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    pool->grain = grain;
+    atomic_store(&pool->next, 0);
+    pool->busyWorkers = pool->workersCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->mutex);
+
+    RunParallelRanges(pool, task, context, count, grain);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busyWorkers > 0)
+    {
+        pthread_cond_wait(&pool->workDone, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,20 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdbool.h>
+
+// runs task(context, begin, end) over [0, count) in ranges of at most grain items
+typedef void (*parallel_task_t)(void *context, int begin, int end);
+
+typedef struct thread_pool_t thread_pool_t;
+
+// threads counts the calling thread too, so 1 gives a pool without workers
+thread_pool_t *ThreadPoolCreate(int threads);
+void ThreadPoolDestroy(thread_pool_t *pool);
+int GetThreadPoolThreads(const thread_pool_t *pool);
+
+// idle threads claim the next range until the work runs out, the caller works too and returns once every range is done
+// a NULL pool runs everything on the calling thread, in range order
+void ParallelFor(thread_pool_t *pool, int count, int grain, parallel_task_t task, void *context);
+
+#endif
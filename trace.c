@@ -0,0 +1,226 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define TRACE_MAX_THREADS 64
+#define TRACE_RING_SIZE 8192 // records per thread, a power of 2
+
+// single producer (the owning thread) and single consumer (the writer), so two counters are all the syncing needed
+typedef struct trace_ring_t
+{
+    trace_record_t records[TRACE_RING_SIZE];
+    atomic_ulong head; // next record the owner writes
+    atomic_ulong tail; // next record the writer reads
+    atomic_ulong dropped;
+    int thread;
+} trace_ring_t;
+
+const char *traceEventNames[TRACE_EVENT_COUNT] = {"step", "contact", "sleep", "mouse_drag", "dropped", "impact"};
+const char *traceCategoryNames[] = {"step", "contacts", "sleep", "input"};
+const int traceCategoriesCount = sizeof(traceCategoryNames) / sizeof(traceCategoryNames[0]);
+const long traceWriterSleepNs = 5000000;
+
+atomic_uint traceMask = 0;
+
+_Atomic(trace_ring_t *) traceRings[TRACE_MAX_THREADS];
+atomic_int traceRingsCount = 0;
+_Thread_local trace_ring_t *threadRing = NULL;
+_Thread_local bool threadRingFailed = false;
+
+uint64_t traceStartTime = 0;
+FILE *traceFile = NULL;
+pthread_t traceWriter;
+atomic_bool traceWriterQuit = false;
+
+uint64_t GetTraceTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// the ring of the calling thread, made on its first record
+trace_ring_t *GetThreadRing(void)
+{
+    if (threadRing != NULL || threadRingFailed)
+    {
+        return threadRing;
+    }
+    int thread = atomic_fetch_add(&traceRingsCount, 1);
+    if (thread >= TRACE_MAX_THREADS)
+    {
+        threadRingFailed = true;
+        return NULL;
+    }
+    trace_ring_t *ring = calloc(1, sizeof(trace_ring_t));
+    if (ring == NULL)
+    {
+        threadRingFailed = true;
+        return NULL;
+    }
+    ring->thread = thread;
+    atomic_store_explicit(&traceRings[thread], ring, memory_order_release);
+    threadRing = ring;
+    return ring;
+}
+
+void TraceWrite(trace_category_t category, trace_event_t event, int subject1, int subject2, float value1, float value2, float value3)
+{
+    trace_ring_t *ring = GetThreadRing();
+    if (ring == NULL)
+    {
+        return;
+    }
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    // never wait for the writer, a full ring loses the record
+    if (head - tail >= TRACE_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->records[head & (TRACE_RING_SIZE - 1)] = (trace_record_t){GetTraceTime() - traceStartTime, (uint16_t)event, (uint8_t)category, (uint8_t)ring->thread,
+                                                                    {subject1, subject2}, {value1, value2, value3}};
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// writes everything the rings hold so far, with discard the records are thrown away instead
+void DrainTraceRings(FILE *file, bool discard)
+{
+    int ringsCount = atomic_load(&traceRingsCount);
+    ringsCount = ringsCount < TRACE_MAX_THREADS ? ringsCount : TRACE_MAX_THREADS;
+    for (int i = 0; i < ringsCount; i++)
+    {
+        trace_ring_t *ring = atomic_load_explicit(&traceRings[i], memory_order_acquire);
+        if (ring == NULL)
+        {
+            continue; // counted but not published yet
+        }
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        while (!discard && tail != head)
+        {
+            // up to the end of the buffer, the rest wraps around to the start
+            unsigned long first = tail & (TRACE_RING_SIZE - 1);
+            unsigned long count = head - tail < TRACE_RING_SIZE - first ? head - tail : TRACE_RING_SIZE - first;
+            fwrite(&ring->records[first], sizeof(trace_record_t), count, file);
+            tail += count;
+        }
+        atomic_store_explicit(&ring->tail, head, memory_order_release);
+    }
+}
+
+void *RunTraceWriter(void *argument)
+{
+    (void)argument;
+    struct timespec sleepTime = {0, traceWriterSleepNs};
+    while (!atomic_load(&traceWriterQuit))
+    {
+        DrainTraceRings(traceFile, false);
+        nanosleep(&sleepTime, NULL);
+    }
+    return NULL;
+}
+
+bool TraceStart(const char *path, unsigned int mask)
+{
+    if (traceFile != NULL)
+    {
+        TraceStop();
+    }
+    traceFile = fopen(path, "wb");
+    if (traceFile == NULL)
+    {
+        return false;
+    }
+    trace_file_header_t header = {{0}, TRACE_FILE_VERSION, sizeof(trace_record_t)};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, traceFile);
+
+    // whatever an earlier trace left behind doesn't belong in this file
+    DrainTraceRings(traceFile, true);
+    traceStartTime = GetTraceTime();
+    atomic_store(&traceWriterQuit, false);
+    if (pthread_create(&traceWriter, NULL, RunTraceWriter, NULL) != 0)
+    {
+        fclose(traceFile);
+        traceFile = NULL;
+        return false;
+    }
+    atomic_store(&traceMask, mask);
+    return true;
+}
+
+void TraceStop(void)
+{
+    if (traceFile == NULL)
+    {
+        return;
+    }
+    atomic_store(&traceMask, 0);
+    atomic_store(&traceWriterQuit, true);
+    pthread_join(traceWriter, NULL);
+    DrainTraceRings(traceFile, false);
+
+    // one record per ring that lost anything, so the decoder can tell the trace is incomplete
+    int ringsCount = atomic_load(&traceRingsCount);
+    ringsCount = ringsCount < TRACE_MAX_THREADS ? ringsCount : TRACE_MAX_THREADS;
+    for (int i = 0; i < ringsCount; i++)
+    {
+        trace_ring_t *ring = atomic_load(&traceRings[i]);
+        unsigned long dropped = ring != NULL ? atomic_exchange(&ring->dropped, 0) : 0;
+        if (dropped > 0)
+        {
+            trace_record_t record = {GetTraceTime() - traceStartTime, TRACE_EVENT_DROPPED, 0, (uint8_t)i, {i, (int32_t)dropped}, {0, 0, 0}};
+            fwrite(&record, sizeof(record), 1, traceFile);
+        }
+    }
+    fclose(traceFile);
+    traceFile = NULL;
+}
+
+const char *GetTraceEventName(int event)
+{
+    return event >= 0 && event < TRACE_EVENT_COUNT ? traceEventNames[event] : "unknown";
+}
+
+const char *GetTraceCategoryName(int category)
+{
+    for (int i = 0; i < traceCategoriesCount; i++)
+    {
+        if (category == 1 << i)
+        {
+            return traceCategoryNames[i];
+        }
+    }
+    return "none";
+}
+
+bool GetTraceMaskFromNames(const char *names, unsigned int *mask)
+{
+    *mask = 0;
+    while (*names != '\0')
+    {
+        const char *end = strchr(names, ',');
+        size_t length = end != NULL ? (size_t)(end - names) : strlen(names);
+        bool found = length == 3 && strncmp(names, "all", 3) == 0;
+        *mask |= found ? TRACE_ALL : 0;
+        for (int i = 0; i < traceCategoriesCount && !found; i++)
+        {
+            if (strlen(traceCategoryNames[i]) == length && strncmp(names, traceCategoryNames[i], length) == 0)
+            {
+                *mask |= 1u << i;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+        names += end != NULL ? length + 1 : length;
+    }
+    return *mask != 0;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// binary event tracing for the hot paths, cheap enough to leave in release builds
+// every thread writes fixed size records into its own lock-free ring, a writer thread drains the rings into a file
+// and tracedump turns that file back into text
+
+typedef enum trace_category_t
+{
+    TRACE_STEP = 1 << 0,     // one summary record per world step
+    TRACE_CONTACTS = 1 << 1, // every solved contact, by far the loudest
+    TRACE_SLEEP = 1 << 2,    // islands falling asleep and waking up
+    TRACE_INPUT = 1 << 3,    // mouse drags from the frontend
+    TRACE_ALL = 0xffff,
+} trace_category_t;
+
+// categories left out here compile to nothing, e.g. -DTRACE_COMPILED_CATEGORIES=TRACE_STEP
+#ifndef TRACE_COMPILED_CATEGORIES
+#define TRACE_COMPILED_CATEGORIES TRACE_ALL
+#endif
+
+typedef enum trace_event_t
+{
+    TRACE_EVENT_STEP,       // subjects: step, awake bodies - values: candidate pairs, contacts, warm started contacts
+    TRACE_EVENT_CONTACT,    // subjects: both bodies - values: deepest penetration, normal x, normal y
+    TRACE_EVENT_SLEEP,      // subjects: bodies put to sleep, bodies woken up
+    TRACE_EVENT_MOUSE_DRAG, // subjects: shape index - values: target x, target y
+    TRACE_EVENT_DROPPED,    // subjects: thread, records lost because its ring was full
+    TRACE_EVENT_IMPACT,     // subjects: swept body - values: share of the step it moved before its first hit, velocity x, velocity y
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+// 32 bytes, written to the file as is
+typedef struct trace_record_t
+{
+    uint64_t time; // nanoseconds since the trace started
+    uint16_t event;
+    uint8_t category;
+    uint8_t thread;
+    int32_t subjects[2];
+    float values[3];
+} trace_record_t;
+
+// categories recorded at runtime, 0 until a trace is started
+extern atomic_uint traceMask;
+
+#define TRACE(category, event, subject1, subject2, value1, value2, value3)                                    \
+    do                                                                                                         \
+    {                                                                                                          \
+        if (((category) & TRACE_COMPILED_CATEGORIES) &&                                                        \
+            (atomic_load_explicit(&traceMask, memory_order_relaxed) & (category)))                             \
+        {                                                                                                      \
+            TraceWrite((category), (event), (subject1), (subject2), (float)(value1), (float)(value2), (float)(value3)); \
+        }                                                                                                      \
+    } while (0)
+
+void TraceWrite(trace_category_t category, trace_event_t event, int subject1, int subject2, float value1, float value2, float value3);
+
+// starts a background thread that drains every ring into path, returns false if the file can't be opened
+bool TraceStart(const char *path, unsigned int mask);
+// stops recording, drains what's left and closes the file
+void TraceStop(void);
+
+const char *GetTraceEventName(int event);
+const char *GetTraceCategoryName(int category);
+// comma separated category names or "all", returns false on an unknown name
+bool GetTraceMaskFromNames(const char *names, unsigned int *mask);
+
+// file layout: the header, then trace_record_t until the end of the file
+#define TRACE_FILE_MAGIC "PHYTRACE"
+#define TRACE_FILE_VERSION 1
+
+typedef struct trace_file_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+} trace_file_header_t;
+
+#endif
@@ -0,0 +1,51 @@
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+
+// prints a binary trace as one line per record, usable with grep and sort
+// usage: tracedump FILE
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s FILE\n", argv[0]);
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        fprintf(stderr, "%s: not a trace file\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    if (header.version != TRACE_FILE_VERSION || header.recordSize != sizeof(trace_record_t))
+    {
+        fprintf(stderr, "%s: trace version %u with %u byte records, expected version %d with %zu\n",
+                argv[1], header.version, header.recordSize, TRACE_FILE_VERSION, sizeof(trace_record_t));
+        fclose(file);
+        return 1;
+    }
+
+    // records come out grouped per thread, sort on the first column to interleave them
+    trace_record_t record;
+    long long records = 0;
+    long long dropped = 0;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        printf("%12.3f us  thread %2u  %-8s %-10s %d %d  %g %g %g\n",
+               record.time / 1000.0, record.thread, GetTraceCategoryName(record.category), GetTraceEventName(record.event),
+               record.subjects[0], record.subjects[1], record.values[0], record.values[1], record.values[2]);
+        dropped += record.event == TRACE_EVENT_DROPPED ? record.subjects[1] : 0;
+        records++;
+    }
+    fclose(file);
+    fprintf(stderr, "%lld records, %lld dropped\n", records, dropped);
+    return 0;
+}